@@ -0,0 +1,530 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "types.h"
+#include "carrier.h"
+#include "analysis.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define ANALYSIS_BLOCK_GROUPS 16384 // Groups read per block, a multiple of the RS group size
+#define RS_GROUP 4                  // Samples per RS group
+#define CHI_MIN_PAIR 10             // Smallest pair count used by the chi-square test
+#define RS_FLUSH_ROUNDS 128         // Vector rounds between flushes of the 16-bit RS counters
+
+/* Running state of one file */
+typedef struct _AnalysisState
+{
+    unsigned long long hist[4][256];    // Value histograms, split to break dependency chains
+    unsigned long long rs[8];           // RS counters: R_M, S_M, R_-M, S_-M, then the same on the flipped image
+    unsigned long long rs_groups;       // Number of RS groups
+} AnalysisState;
+
+// Function to compute the lower regularized incomplete gamma function P(a, x)
+static double gamma_p(double a, double x)
+{
+    if (x <= 0.0)
+    {
+        return 0.0;
+    }
+    double log_prefix = -x + a * log(x) - lgamma(a);
+
+    // Series expansion converges quickly below a + 1
+    if (x < a + 1.0)
+    {
+        double ap = a, sum = 1.0 / a, del = sum;
+        for (int i = 0; i < 1000 && fabs(del) > fabs(sum) * 1e-12; i++)
+        {
+            ap += 1.0;
+            del *= x / ap;
+            sum += del;
+        }
+        return sum * exp(log_prefix);
+    }
+
+    // Continued fraction (modified Lentz) for the upper tail
+    double tiny = 1e-300;
+    double b = x + 1.0 - a, c = 1.0 / tiny, d = 1.0 / b, h = d;
+    for (int i = 1; i < 1000; i++)
+    {
+        double an = -i * (i - a);
+        b += 2.0;
+        d = an * d + b;
+        d = (fabs(d) < tiny) ? tiny : d;
+        c = b + an / c;
+        c = (fabs(c) < tiny) ? tiny : c;
+        d = 1.0 / d;
+        h *= d * c;
+        if (fabs(d * c - 1.0) < 1e-12)
+        {
+            break;
+        }
+    }
+    return 1.0 - exp(log_prefix) * h;
+}
+
+// Function to compute the chi-square embedding probability of a histogram
+static double chi_square_probability(const AnalysisState *state)
+{
+    double chi = 0.0;
+    int categories = 0;
+
+    // Sequential LSB replacement equalises the pairs (2k, 2k+1)
+    for (int k = 0; k < 128; k++)
+    {
+        unsigned long long even = 0, odd = 0;
+        for (int j = 0; j < 4; j++)
+        {
+            even += state->hist[j][2 * k];
+            odd += state->hist[j][2 * k + 1];
+        }
+        if (even + odd < CHI_MIN_PAIR)
+        {
+            continue;
+        }
+        double expected = (even + odd) / 2.0;
+        chi += (even - expected) * (even - expected) / expected;
+        categories++;
+    }
+    if (categories < 2)
+    {
+        return 0.0;
+    }
+
+    // Probability that the pairs are as equal as an embedded image's
+    return 1.0 - gamma_p((categories - 1) / 2.0, chi / 2.0);
+}
+
+// Function to add a run of samples to the histograms
+static void histogram_samples(AnalysisState *state, const unsigned char *samples, uint count)
+{
+    uint i = 0;
+
+    // SSE2 and AVX2 have no scatter store, so a vector histogram would update
+    // the bins one lane at a time anyway. Four independent histograms instead
+    // keep the increments from waiting on each other.
+    for (; i + 4 <= count; i += 4)
+    {
+        state->hist[0][samples[i]]++;
+        state->hist[1][samples[i + 1]]++;
+        state->hist[2][samples[i + 2]]++;
+        state->hist[3][samples[i + 3]]++;
+    }
+    for (; i < count; i++)
+    {
+        state->hist[0][samples[i]]++;
+    }
+}
+
+// Function to compute the RS discrimination function of a group
+static int rs_smoothness(const int *x)
+{
+    return abs(x[1] - x[0]) + abs(x[2] - x[1]) + abs(x[3] - x[2]);
+}
+
+// Function to classify one group as regular / singular under both masks
+static void rs_classify(const int *x, unsigned long long *counters)
+{
+    int pos[RS_GROUP], neg[RS_GROUP];
+    int f = rs_smoothness(x);
+
+    // Mask [0 1 1 0]: F1 flips 2k <-> 2k+1, F-1 flips 2k-1 <-> 2k
+    for (int i = 0; i < RS_GROUP; i++)
+    {
+        int masked = (i == 1 || i == 2);
+        pos[i] = masked ? (x[i] ^ 1) : x[i];
+        neg[i] = masked ? (((x[i] + 1) ^ 1) - 1) : x[i];
+    }
+    int fp = rs_smoothness(pos);
+    int fn = rs_smoothness(neg);
+    counters[0] += fp > f;
+    counters[1] += fp < f;
+    counters[2] += fn > f;
+    counters[3] += fn < f;
+}
+
+// Function to count the RS classes of one channel, one group at a time
+static void rs_count_scalar(const unsigned char *samples, uint count, uint stride, unsigned long long *counters)
+{
+    int x[RS_GROUP], flipped[RS_GROUP];
+
+    for (uint g = 0; g + RS_GROUP <= count; g += RS_GROUP)
+    {
+        for (int i = 0; i < RS_GROUP; i++)
+        {
+            x[i] = samples[(g + i) * stride];
+            flipped[i] = x[i] ^ 1;
+        }
+        rs_classify(x, counters);
+        rs_classify(flipped, counters + 4);
+    }
+}
+
+#ifdef __SSE2__
+// Function to compute the RS discrimination function of eight groups
+static inline __m128i rs_smoothness_sse2(__m128i x0, __m128i x1, __m128i x2, __m128i x3)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i d0 = _mm_sub_epi16(x1, x0), d1 = _mm_sub_epi16(x2, x1), d2 = _mm_sub_epi16(x3, x2);
+    d0 = _mm_max_epi16(d0, _mm_sub_epi16(zero, d0));
+    d1 = _mm_max_epi16(d1, _mm_sub_epi16(zero, d1));
+    d2 = _mm_max_epi16(d2, _mm_sub_epi16(zero, d2));
+    return _mm_add_epi16(_mm_add_epi16(d0, d1), d2);
+}
+
+// Function to classify eight groups at once, counting in 16-bit lanes
+static inline void rs_classify_sse2(__m128i x0, __m128i x1, __m128i x2, __m128i x3, __m128i *acc)
+{
+    const __m128i one = _mm_set1_epi16(1);
+    __m128i f = rs_smoothness_sse2(x0, x1, x2, x3);
+
+    // Mask [0 1 1 0] under F1 and F-1, as in rs_classify
+    __m128i fp = rs_smoothness_sse2(x0, _mm_xor_si128(x1, one), _mm_xor_si128(x2, one), x3);
+    __m128i n1 = _mm_sub_epi16(_mm_xor_si128(_mm_add_epi16(x1, one), one), one);
+    __m128i n2 = _mm_sub_epi16(_mm_xor_si128(_mm_add_epi16(x2, one), one), one);
+    __m128i fn = rs_smoothness_sse2(x0, n1, n2, x3);
+
+    // A true compare is -1, so subtracting it counts
+    acc[0] = _mm_sub_epi16(acc[0], _mm_cmpgt_epi16(fp, f));
+    acc[1] = _mm_sub_epi16(acc[1], _mm_cmpgt_epi16(f, fp));
+    acc[2] = _mm_sub_epi16(acc[2], _mm_cmpgt_epi16(fn, f));
+    acc[3] = _mm_sub_epi16(acc[3], _mm_cmpgt_epi16(f, fn));
+}
+
+// Function to count the RS classes of one channel, eight groups at a time with SSE2
+static void rs_count_sse2(const unsigned char *samples, uint count, uint stride, unsigned long long *counters)
+{
+    const __m128i one = _mm_set1_epi16(1);
+    uint16_t x[RS_GROUP][8];
+    __m128i acc[8];
+
+    // Eight groups of four samples per round
+    uint rounds = count / (8 * RS_GROUP);
+    uint done = 0;
+    while (done < rounds)
+    {
+        uint chunk = (rounds - done < RS_FLUSH_ROUNDS) ? rounds - done : RS_FLUSH_ROUNDS;
+        for (int c = 0; c < 8; c++)
+        {
+            acc[c] = _mm_setzero_si128();
+        }
+
+        for (uint r = done; r < done + chunk; r++)
+        {
+            // Gather the strided samples, sample i of group j into x[i][j]
+            const unsigned char *p = samples + (size_t)r * 8 * RS_GROUP * stride;
+            for (int j = 0; j < 8; j++)
+            {
+                for (int i = 0; i < RS_GROUP; i++)
+                {
+                    x[i][j] = p[(j * RS_GROUP + i) * stride];
+                }
+            }
+            __m128i x0 = _mm_loadu_si128((const __m128i *)x[0]);
+            __m128i x1 = _mm_loadu_si128((const __m128i *)x[1]);
+            __m128i x2 = _mm_loadu_si128((const __m128i *)x[2]);
+            __m128i x3 = _mm_loadu_si128((const __m128i *)x[3]);
+            rs_classify_sse2(x0, x1, x2, x3, acc);
+            rs_classify_sse2(_mm_xor_si128(x0, one), _mm_xor_si128(x1, one), _mm_xor_si128(x2, one),
+                             _mm_xor_si128(x3, one), acc + 4);
+        }
+
+        for (int c = 0; c < 8; c++)
+        {
+            uint16_t lanes[8];
+            _mm_storeu_si128((__m128i *)lanes, acc[c]);
+            for (int j = 0; j < 8; j++)
+            {
+                counters[c] += lanes[j];
+            }
+        }
+        done += chunk;
+    }
+
+    // Groups left over after the last whole round
+    uint offset = rounds * 8 * RS_GROUP;
+    rs_count_scalar(samples + (size_t)offset * stride, count - offset, stride, counters);
+}
+#endif
+
+/* Registered variants; the first is the reference */
+const RsAnalysisKernel rs_analysis_kernels[] =
+{
+    { "scalar", rs_count_scalar },
+#ifdef __SSE2__
+    { "sse2", rs_count_sse2 },
+#endif
+};
+
+const uint rs_analysis_kernel_count = sizeof(rs_analysis_kernels) / sizeof(rs_analysis_kernels[0]);
+
+// Function to run RS analysis on one channel of a block
+static void rs_samples(AnalysisState *state, const unsigned char *samples, uint groups, uint stride)
+{
+#ifdef __SSE2__
+    rs_count_sse2(samples, groups, stride, state->rs);
+#else
+    rs_count_scalar(samples, groups, stride, state->rs);
+#endif
+    state->rs_groups += groups / RS_GROUP;
+}
+
+// Function to estimate the embedded fraction from the RS counters
+static double rs_estimate(const AnalysisState *state)
+{
+    if (state->rs_groups == 0)
+    {
+        return 0.0;
+    }
+    double n = state->rs_groups;
+    double d0 = (state->rs[0] - (double)state->rs[1]) / n;     // R_M - S_M
+    double dn0 = (state->rs[2] - (double)state->rs[3]) / n;    // R_-M - S_-M
+    double d1 = (state->rs[4] - (double)state->rs[5]) / n;     // Same on the flipped image
+    double dn1 = (state->rs[6] - (double)state->rs[7]) / n;
+
+    // 2(d1 + d0) z^2 + (d-0 - d-1 - d1 - 3 d0) z + d0 - d-0 = 0
+    double a = 2.0 * (d1 + d0);
+    double b = dn0 - dn1 - d1 - 3.0 * d0;
+    double c = d0 - dn0;
+    double z;
+    if (fabs(a) < 1e-12)
+    {
+        z = (fabs(b) < 1e-12) ? 0.0 : -c / b;
+    }
+    else
+    {
+        double disc = b * b - 4.0 * a * c;
+        if (disc < 0.0)
+        {
+            disc = 0.0;
+        }
+        double z1 = (-b + sqrt(disc)) / (2.0 * a);
+        double z2 = (-b - sqrt(disc)) / (2.0 * a);
+        z = (fabs(z1) < fabs(z2)) ? z1 : z2;
+    }
+    if (fabs(z - 0.5) < 1e-12)
+    {
+        return 1.0;
+    }
+    return z / (z - 0.5);
+}
+
+// Function to analyse one carrier
+Status analyse_carrier(const char *fname, AnalysisResult *result)
+{
+    static __thread unsigned char samples[ANALYSIS_BLOCK_GROUPS * MAX_CARRIER_GROUP];
+    CarrierInfo carrier;
+    AnalysisState *state;
+
+    memset(result, 0, sizeof(AnalysisResult));
+    result->fname = fname;
+    result->status = e_failure;
+
+    FILE *fptr = fopen(fname, "r");
+    if (fptr == NULL)
+    {
+        perror("fopen");
+        return e_failure;
+    }
+    if (carrier_open(fptr, &carrier) == e_failure || carrier.capacity < CHI_PREFIXES)
+    {
+        fclose(fptr);
+        return e_failure;
+    }
+    carrier_skip_padding(&carrier); // Row padding belongs to no channel
+    state = calloc(1, sizeof(AnalysisState));
+    if (state == NULL)
+    {
+        fclose(fptr);
+        return e_failure;
+    }
+
+    // Stream the samples; the histogram is checked at every prefix boundary
+    unsigned long long seen = 0;
+    int prefix = 0;
+    uint groups_left = carrier.capacity / carrier.lanes;
+    while (groups_left > 0)
+    {
+        uint want = (groups_left < ANALYSIS_BLOCK_GROUPS) ? groups_left : ANALYSIS_BLOCK_GROUPS;
+        uint got = carrier_read_block(&carrier, fptr, samples, want);
+        if (got == 0)
+        {
+            break;
+        }
+        uint count = got * carrier.lanes;
+        uint done = 0;
+        while (done < count)
+        {
+            unsigned long long boundary = (unsigned long long)carrier.capacity * (prefix + 1) / CHI_PREFIXES;
+            uint run = count - done;
+            if (seen + run > boundary)
+            {
+                run = boundary - seen;
+            }
+            histogram_samples(state, samples + done, run);
+            done += run;
+            seen += run;
+            if (seen == boundary && prefix < CHI_PREFIXES)
+            {
+                result->chi_p[prefix++] = chi_square_probability(state);
+            }
+        }
+
+        // RS works on neighbouring samples of the same channel
+        for (uint ch = 0; ch < carrier.lanes; ch++)
+        {
+            rs_samples(state, samples + ch, got, carrier.lanes);
+        }
+        groups_left -= got;
+    }
+    fclose(fptr);
+
+    // Fill in prefixes the data never reached (truncated file)
+    for (; prefix < CHI_PREFIXES; prefix++)
+    {
+        result->chi_p[prefix] = chi_square_probability(state);
+    }
+
+    // Extent of the run of embedded-looking prefixes from the start
+    int run = 0;
+    while (run < CHI_PREFIXES && result->chi_p[run] > 0.5)
+    {
+        run++;
+    }
+    result->chi_extent = (double)run / CHI_PREFIXES;
+    result->rs_rate = rs_estimate(state);
+
+    // Either detector alone is enough to flag the file
+    double rs = result->rs_rate < 0.0 ? 0.0 : (result->rs_rate > 1.0 ? 1.0 : result->rs_rate);
+    result->likelihood = (result->chi_p[0] > rs) ? result->chi_p[0] : rs;
+    result->status = e_success;
+
+    free(state);
+    return e_success;
+}
+
+/* Shared work list of the thread pool */
+typedef struct _AnalysisPool
+{
+    char **fnames;
+    AnalysisResult *results;
+    uint count;
+    uint next;
+    pthread_mutex_t lock;
+} AnalysisPool;
+
+// Function run by every analysis thread
+static void *analysis_worker(void *arg)
+{
+    AnalysisPool *pool = arg;
+
+    for (;;)
+    {
+        // Claim the next file
+        pthread_mutex_lock(&pool->lock);
+        uint index = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+        if (index >= pool->count)
+        {
+            return NULL;
+        }
+        analyse_carrier(pool->fnames[index], &pool->results[index]);
+    }
+}
+
+// Function to analyse many carriers in parallel
+Status analyse_carriers(char **fnames, uint count, AnalysisResult *results, uint threads)
+{
+    pthread_t tids[MAX_ANALYSIS_THREADS];
+    AnalysisPool pool = { fnames, results, count, 0, PTHREAD_MUTEX_INITIALIZER };
+
+    if (threads == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (cpus > 0) ? cpus : 1;
+    }
+    if (threads > MAX_ANALYSIS_THREADS)
+    {
+        threads = MAX_ANALYSIS_THREADS;
+    }
+    if (threads > count)
+    {
+        threads = count;
+    }
+
+    uint started = 0;
+    for (; started < threads; started++)
+    {
+        if (pthread_create(&tids[started], NULL, analysis_worker, &pool))
+        {
+            break;
+        }
+    }
+    if (started == 0)
+    {
+        // No threads available, do the work here
+        analysis_worker(&pool);
+    }
+    for (uint i = 0; i < started; i++)
+    {
+        pthread_join(tids[i], NULL);
+    }
+
+    Status status = e_success;
+    for (uint i = 0; i < count; i++)
+    {
+        if (results[i].status == e_failure)
+        {
+            status = e_failure;
+        }
+    }
+    return status;
+}
+
+// Function to handle the -s operation
+Status do_analysis(int argc, char *argv[])
+{
+    uint threads = 0;
+    int first = 2;
+
+    // Optional thread count
+    if (argc > 3 && strcmp(argv[2], "--threads") == 0)
+    {
+        threads = atoi(argv[3]);
+        first = 4;
+    }
+    if (first >= argc)
+    {
+        printf("INFO: No files to analyse.\n");
+        return e_failure;
+    }
+
+    uint count = argc - first;
+    AnalysisResult *results = calloc(count, sizeof(AnalysisResult));
+    if (results == NULL)
+    {
+        return e_failure;
+    }
+
+    Status status = analyse_carriers(argv + first, count, results, threads);
+
+    printf("%-32s %10s %10s %10s %10s\n", "file", "chi p(1%)", "chi extent", "RS rate", "likelihood");
+    for (uint i = 0; i < count; i++)
+    {
+        if (results[i].status == e_failure)
+        {
+            printf("%-32s %10s\n", argv[first + i], "error");
+            continue;
+        }
+        printf("%-32s %10.4f %9.0f%% %10.4f %10.4f\n", results[i].fname, results[i].chi_p[0],
+               results[i].chi_extent * 100.0, results[i].rs_rate, results[i].likelihood);
+    }
+
+    free(results);
+    return status;
+}
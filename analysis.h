@@ -0,0 +1,85 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include "types.h" // Contains user defined types
+
+/*
+ * This header file defines the steganalysis scanner used to audit covers
+ * and stego images for detectable sequential LSB embedding.
+ *
+ * Two classic detectors run in one streaming pass over the samples:
+ *  - chi-square pairs-of-values (Westfeld & Pfitzmann) on growing
+ *    prefixes, which catches sequential embedding from the start;
+ *  - RS analysis (Fridrich), which estimates the embedded fraction.
+ *
+ * RS groups are classified with SSE2 when the build has it; every variant
+ * is listed in rs_analysis_kernels[] so the benchmark (-b) can check it
+ * against the scalar reference.
+ */
+
+#define CHI_PREFIXES 100        // Prefixes tested: 1%, 2%, ... 100% of the samples
+#define MAX_ANALYSIS_THREADS 64 // Upper bound for --threads
+
+/*
+ * Structure: AnalysisResult
+ * Purpose: Detection statistics of one file.
+ */
+typedef struct _AnalysisResult
+{
+    const char *fname;          // Analysed file
+    Status status;              // e_failure when the file could not be analysed
+    double chi_p[CHI_PREFIXES]; // Chi-square embedding probability of each prefix
+    double chi_extent;          // Fraction of the samples that look embedded from the start
+    double rs_rate;             // RS estimate of the fraction of samples carrying payload
+    double likelihood;          // Combined detection likelihood, 0 (clean) to 1 (detected)
+} AnalysisResult;
+
+/*
+ * Structure: RsAnalysisKernel
+ * Purpose: One implementation of the RS group classification.
+ */
+typedef struct _RsAnalysisKernel
+{
+    const char *name;   // Variant name for reports
+    void (*count)(const unsigned char *samples, uint count, uint stride,
+                  unsigned long long *counters);    // count samples, stride apart, added to the 8 RS counters
+} RsAnalysisKernel;
+
+/* Every compiled variant; the first one is the reference */
+extern const RsAnalysisKernel rs_analysis_kernels[];
+extern const uint rs_analysis_kernel_count;
+
+/*
+ * Function: analyse_carrier
+ * Purpose: Runs chi-square and RS analysis on one carrier file.
+ * Inputs:
+ *  - fname: File to analyse.
+ *  - result: Pointer to the result to fill.
+ * Outputs:
+ *  - Returns e_success if the file was analysed, otherwise e_failure.
+ */
+Status analyse_carrier(const char *fname, AnalysisResult *result);
+
+/*
+ * Function: analyse_carriers
+ * Purpose: Analyses many files on a pool of threads.
+ * Inputs:
+ *  - fnames, count: Files to analyse.
+ *  - results: Array of count results to fill, in the order of fnames.
+ *  - threads: Number of worker threads (0 = one per online CPU).
+ * Outputs:
+ *  - Returns e_success if every file was analysed, otherwise e_failure.
+ */
+Status analyse_carriers(char **fnames, uint count, AnalysisResult *results, uint threads);
+
+/*
+ * Function: do_analysis
+ * Purpose: Handles "-s [--threads N] <file> [file ...]" and prints one line per file.
+ * Inputs:
+ *  - argc, argv: Command-line arguments.
+ * Outputs:
+ *  - Returns e_success if every file was analysed, otherwise e_failure.
+ */
+Status do_analysis(int argc, char *argv[]);
+
+#endif
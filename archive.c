@@ -0,0 +1,413 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "encode.h"
+#include "types.h"
+#include "common.h"
+#include "journal.h"
+#include "archive.h"
+
+// Function to read and validate archive arguments
+Status read_and_validate_archive_args(int argc, char *argv[], ArchiveInfo *arcInfo)
+{
+    memset(arcInfo, 0, sizeof(ArchiveInfo));
+
+    // The cover must be a supported carrier and the output of the same format
+    char *src_extn = strrchr(argv[2], '.');
+    char *out_extn = strrchr(argv[3], '.');
+    if (carrier_known_extn(src_extn) == e_failure || out_extn == NULL || strcmp(out_extn, src_extn))
+    {
+        printf("INFO: Validation Error. Cover and output should be carriers of the same format.\n");
+        return e_failure;
+    }
+    arcInfo->src_image_fname = argv[2];
+    arcInfo->stego_image_fname = argv[3];
+
+    // Every remaining argument is a file to embed
+    if (argc - 4 > MAX_ARCHIVE_FILES)
+    {
+        printf("INFO: Validation Error. At most %d files can be archived.\n", MAX_ARCHIVE_FILES);
+        return e_failure;
+    }
+    for (int i = 4; i < argc; i++)
+    {
+        // Only the base name is stored in the table of contents
+        char *name = strrchr(argv[i], '/');
+        name = (name == NULL) ? argv[i] : name + 1;
+        if (strlen(name) == 0 || strlen(name) >= MAX_ARCHIVE_NAME)
+        {
+            printf("INFO: Validation Error. Invalid archive member name %s.\n", argv[i]);
+            return e_failure;
+        }
+
+        // Member names must be unique so that --extract is unambiguous
+        for (uint j = 0; j < arcInfo->file_count; j++)
+        {
+            if (strcmp(arcInfo->toc[j].name, name) == 0)
+            {
+                printf("INFO: Validation Error. Duplicate archive member %s.\n", name);
+                return e_failure;
+            }
+        }
+
+        arcInfo->file_names[arcInfo->file_count] = argv[i];
+        strcpy(arcInfo->toc[arcInfo->file_count].name, name);
+        arcInfo->file_count++;
+    }
+    return e_success;
+}
+
+// Function to compute the carrier sample where the data region starts
+long archive_data_start(const ArchiveEntry *toc, uint count)
+{
+    // Magic string and file count
+    long header = strlen(ARCHIVE_MAGIC) + 4;
+
+    // Name length, name, offset and length of every entry
+    for (uint i = 0; i < count; i++)
+    {
+        header += 4 + strlen(toc[i].name) + 4 + 4;
+    }
+    return header * 8;
+}
+
+// Function to encode a 32-bit value into the stego image
+static Status encode_archive_int(uint value, ArchiveInfo *arcInfo)
+{
+    return encode_int_to_image(value, &arcInfo->carrier, arcInfo->fptr_src_image, arcInfo->fptr_stego_image);
+}
+
+// Function to open the cover, the output and measure every member
+static Status open_archive_files(ArchiveInfo *arcInfo)
+{
+    printf("INFO: Opening required files.\n");
+
+    arcInfo->fptr_src_image = fopen(arcInfo->src_image_fname, "r");
+    if (arcInfo->fptr_src_image == NULL)
+    {
+        perror("fopen");
+        fprintf(stderr, "ERROR: can't open file %s\n", arcInfo->src_image_fname);
+        return e_failure;
+    }
+
+    // Lay the members out back to back in the data region
+    uint offset = 0;
+    for (uint i = 0; i < arcInfo->file_count; i++)
+    {
+        FILE *fptr = fopen(arcInfo->file_names[i], "r");
+        if (fptr == NULL)
+        {
+            perror("fopen");
+            fprintf(stderr, "ERROR: can't open file %s\n", arcInfo->file_names[i]);
+            return e_failure;
+        }
+        arcInfo->toc[i].offset = offset;
+        arcInfo->toc[i].length = get_file_size(fptr);
+        offset += arcInfo->toc[i].length;
+        fclose(fptr);
+        printf("INFO: %s : %u bytes at offset %u\n", arcInfo->toc[i].name, arcInfo->toc[i].length, arcInfo->toc[i].offset);
+    }
+
+    // The output is written under a temporary name and renamed once complete, like -e does
+    if ((size_t)snprintf(arcInfo->part_fname, sizeof(arcInfo->part_fname), "%s%s", arcInfo->stego_image_fname,
+                         PART_SUFFIX) >= sizeof(arcInfo->part_fname))
+    {
+        printf("INFO: Output file name is too long.\n");
+        return e_failure;
+    }
+    arcInfo->fptr_stego_image = fopen(arcInfo->part_fname, "w");
+    if (arcInfo->fptr_stego_image == NULL)
+    {
+        perror("fopen");
+        fprintf(stderr, "ERROR: can't open file %s\n", arcInfo->part_fname);
+        return e_failure;
+    }
+    printf("INFO: Done\n");
+    return e_success;
+}
+
+// Function to close the cover and the output; returns e_failure if the output could not be written
+static Status close_archive_files(ArchiveInfo *arcInfo)
+{
+    Status status = e_success;
+
+    if (arcInfo->fptr_src_image != NULL)
+    {
+        fclose(arcInfo->fptr_src_image);
+        arcInfo->fptr_src_image = NULL;
+    }
+    if (arcInfo->fptr_stego_image != NULL)
+    {
+        status = fclose(arcInfo->fptr_stego_image) ? e_failure : e_success;
+        arcInfo->fptr_stego_image = NULL;
+    }
+    return status;
+}
+
+// Function to embed one member file byte by byte
+static Status encode_archive_member(const char *fname, ArchiveInfo *arcInfo)
+{
+    CarrierWindow window;
+    int ch;
+
+    FILE *fptr = fopen(fname, "r");
+    if (fptr == NULL)
+    {
+        perror("fopen");
+        return e_failure;
+    }
+    while ((ch = getc(fptr)) != EOF)
+    {
+        if (carrier_read_window(&arcInfo->carrier, arcInfo->fptr_src_image, &window, 8) == e_failure)
+        {
+            fclose(fptr);
+            return e_failure;
+        }
+        encode_byte_to_lsb(ch, window.samples);
+        if (carrier_write_window(&window, arcInfo->fptr_stego_image) == e_failure)
+        {
+            fclose(fptr);
+            return e_failure;
+        }
+    }
+    Status status = ferror(fptr) ? e_failure : e_success;
+    fclose(fptr);
+    return status;
+}
+
+// Function to embed the table of contents and every member into the open part file
+static Status encode_archive_to_part_file(ArchiveInfo *arcInfo)
+{
+    uint count = arcInfo->file_count;
+
+    // Copy the carrier header from source image to the stego image
+    if (carrier_copy_header(&arcInfo->carrier, arcInfo->fptr_src_image, arcInfo->fptr_stego_image) == e_failure)
+    {
+        printf("INFO: Error copying the carrier header.\n");
+        return e_failure;
+    }
+
+    // Magic string and table of contents
+    printf("INFO: Encoding table of contents.\n");
+    if (encode_data_to_image(ARCHIVE_MAGIC, &arcInfo->carrier, arcInfo->fptr_src_image, arcInfo->fptr_stego_image) == e_failure ||
+        encode_archive_int(count, arcInfo) == e_failure)
+    {
+        return e_failure;
+    }
+    for (uint i = 0; i < count; i++)
+    {
+        if (encode_archive_int(strlen(arcInfo->toc[i].name), arcInfo) == e_failure ||
+            encode_data_to_image(arcInfo->toc[i].name, &arcInfo->carrier, arcInfo->fptr_src_image, arcInfo->fptr_stego_image) == e_failure ||
+            encode_archive_int(arcInfo->toc[i].offset, arcInfo) == e_failure ||
+            encode_archive_int(arcInfo->toc[i].length, arcInfo) == e_failure)
+        {
+            printf("INFO: Error encoding the table of contents.\n");
+            return e_failure;
+        }
+    }
+    printf("INFO: Done\n");
+
+    // Member data, in table order
+    for (uint i = 0; i < count; i++)
+    {
+        printf("INFO: Encoding %s data.\n", arcInfo->toc[i].name);
+        if (encode_archive_member(arcInfo->file_names[i], arcInfo) == e_failure)
+        {
+            printf("INFO: Error encoding %s.\n", arcInfo->toc[i].name);
+            return e_failure;
+        }
+    }
+
+    // Copy any remaining image data from the source image to the stego image
+    if (copy_remaining_img_data(arcInfo->fptr_src_image, arcInfo->fptr_stego_image) == e_failure)
+    {
+        printf("INFO: Error copying the remaining data to output image.\n");
+        return e_failure;
+    }
+
+    // Make the output durable before it is published under its real name
+    if (fflush(arcInfo->fptr_stego_image) || fsync(fileno(arcInfo->fptr_stego_image)))
+    {
+        perror("fsync");
+        return e_failure;
+    }
+    return e_success;
+}
+
+// Function to embed every file of the archive
+Status do_archive_encoding(ArchiveInfo *arcInfo)
+{
+    if (open_archive_files(arcInfo) == e_failure)
+    {
+        printf("INFO: Files are not opened.\n");
+        close_archive_files(arcInfo);
+        return e_failure;
+    }
+
+    printf("INFO: ## Archive Encoding Procedure Started. ##\n");
+
+    // Check the capacity for the table of contents and all members
+    uint count = arcInfo->file_count;
+    ArchiveEntry *last = &arcInfo->toc[count - 1];
+    long req_size = archive_data_start(arcInfo->toc, count) + ((long)last->offset + last->length) * 8;
+    Status status = carrier_open(arcInfo->fptr_src_image, &arcInfo->carrier);
+    arcInfo->image_capacity = arcInfo->carrier.capacity;
+    if (status == e_success && arcInfo->image_capacity < req_size)
+    {
+        printf("INFO: There is not enough space.\n");
+        status = e_failure;
+    }
+
+    // A failed archive leaves no output behind
+    if (status == e_success)
+    {
+        status = encode_archive_to_part_file(arcInfo);
+    }
+    if (close_archive_files(arcInfo) == e_failure)
+    {
+        perror("fclose");
+        status = e_failure;
+    }
+    if (status == e_success && rename(arcInfo->part_fname, arcInfo->stego_image_fname))
+    {
+        perror("rename");
+        status = e_failure;
+    }
+    if (status == e_failure)
+    {
+        unlink(arcInfo->part_fname);
+        return e_failure;
+    }
+    printf("INFO: ## Archive Encoding Done successfully. ##\n");
+    return e_success;
+}
+
+// Function to read the archive magic string and table of contents
+Status read_archive_toc(CarrierInfo *carrier, FILE *fptr, ArchiveEntry *toc, uint *count)
+{
+    char magic[sizeof(ARCHIVE_MAGIC)];
+
+    skip_header(fptr, carrier);
+
+    // Magic string
+    for (size_t i = 0; i < strlen(ARCHIVE_MAGIC); i++)
+    {
+        decode_byte_from_image(carrier, fptr, &magic[i]);
+    }
+    magic[strlen(ARCHIVE_MAGIC)] = '\0';
+    if (strcmp(magic, ARCHIVE_MAGIC))
+    {
+        printf("INFO: Image does not hold an archive.\n");
+        return e_failure;
+    }
+
+    // File count
+    if (decode_int_from_image(carrier, fptr, count) == e_failure || *count == 0 || *count > MAX_ARCHIVE_FILES)
+    {
+        printf("INFO: Corrupted table of contents.\n");
+        return e_failure;
+    }
+
+    // Entries
+    for (uint i = 0; i < *count; i++)
+    {
+        uint name_length = 0;
+        decode_int_from_image(carrier, fptr, &name_length);
+        if (name_length == 0 || name_length >= MAX_ARCHIVE_NAME)
+        {
+            printf("INFO: Corrupted table of contents.\n");
+            return e_failure;
+        }
+        for (uint j = 0; j < name_length; j++)
+        {
+            decode_byte_from_image(carrier, fptr, &toc[i].name[j]);
+        }
+        toc[i].name[name_length] = '\0';
+
+        decode_int_from_image(carrier, fptr, &toc[i].offset);
+        if (decode_int_from_image(carrier, fptr, &toc[i].length) == e_failure)
+        {
+            printf("INFO: Corrupted table of contents.\n");
+            return e_failure;
+        }
+    }
+    return e_success;
+}
+
+// Function to extract one file of the archive
+Status extract_archive_file(DecodeInfo *decInfo)
+{
+    ArchiveEntry toc[MAX_ARCHIVE_FILES];
+    uint count;
+
+    if (open_stego_file(decInfo) == e_failure)
+    {
+        printf("Error opening files.\n");
+        return e_failure;
+    }
+
+    printf("INFO: Reading table of contents.\n");
+    if (read_archive_toc(&decInfo->carrier, decInfo->fptr_stego, toc, &count) == e_failure)
+    {
+        return e_failure;
+    }
+
+    // Look the requested member up
+    ArchiveEntry *entry = NULL;
+    for (uint i = 0; i < count; i++)
+    {
+        if (strcmp(toc[i].name, decInfo->extract_name) == 0)
+        {
+            entry = &toc[i];
+        }
+    }
+    if (entry == NULL)
+    {
+        printf("INFO: %s is not in the archive. Available files:\n", decInfo->extract_name);
+        for (uint i = 0; i < count; i++)
+        {
+            printf("INFO:   %s (%u bytes)\n", toc[i].name, toc[i].length);
+        }
+        return e_failure;
+    }
+
+    // Members are written under their own name unless told otherwise
+    if (decInfo->out_flag)
+    {
+        strcpy(decInfo->out_fname, entry->name);
+    }
+    if (open_output_file(decInfo) == e_failure)
+    {
+        printf("Error opening output file.\n");
+        return e_failure;
+    }
+
+    // Seek straight to the first sample of the member
+    long pos = archive_data_start(toc, count) + (long)entry->offset * 8;
+    if (carrier_seek(&decInfo->carrier, decInfo->fptr_stego, pos) == e_failure)
+    {
+        printf("Error seeking to %s.\n", entry->name);
+        return e_failure;
+    }
+
+    printf("INFO: Decoding %s (%u bytes).\n", entry->name, entry->length);
+    char ch;
+    for (uint i = 0; i < entry->length; i++)
+    {
+        if (decode_byte_from_image(&decInfo->carrier, decInfo->fptr_stego, &ch) == e_failure)
+        {
+            printf("Error: stego image is truncated.\n");
+            return e_failure;
+        }
+        fwrite(&ch, 1, 1, decInfo->fptr_output);
+    }
+
+    if (finish_output_file(decInfo) == e_failure)
+    {
+        printf("Error writing output file.\n");
+        return e_failure;
+    }
+    close_decode_files(decInfo);
+    printf("INFO: ## Decoding Done Successfully. ##\n");
+    return e_success;
+}
@@ -0,0 +1,114 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdio.h>
+#include "types.h" // Contains user defined types
+#include "decode.h"
+
+/*
+ * This header file defines the structures and function prototypes
+ * required for embedding several files into one stego image together
+ * with a table of contents, and for extracting a single file back.
+ *
+ * Layout after the carrier header (every byte takes 8 carrier samples):
+ *   ARCHIVE_MAGIC | file count (32 bits) |
+ *   { name length (32 bits) | name | offset (32 bits) | length (32 bits) } * count |
+ *   file data, concatenated in table order
+ *
+ * The offset of a file is relative to the start of the data region, so
+ * byte i of a file sits at sample data_start + 8 * (offset + i).
+ */
+
+#define MAX_ARCHIVE_FILES 32    // Maximum number of files in one archive
+#define MAX_ARCHIVE_NAME 64     // Maximum length of a stored file name
+
+/*
+ * Structure: ArchiveEntry
+ * Purpose: One row of the table of contents.
+ */
+typedef struct _ArchiveEntry
+{
+    char name[MAX_ARCHIVE_NAME];    // Stored file name (without directories)
+    uint offset;                    // Offset of the file inside the data region
+    uint length;                    // Length of the file in bytes
+} ArchiveEntry;
+
+/*
+ * Structure: ArchiveInfo
+ * Purpose: To store all necessary information for embedding an archive.
+ */
+typedef struct _ArchiveInfo
+{
+    /* Source Image info */
+    char *src_image_fname;          // Cover image file name
+    FILE *fptr_src_image;           // File pointer to the cover image
+    uint image_capacity;            // Number of payload carrying bytes
+    CarrierInfo carrier;            // Layout of the cover
+
+    /* Stego Image Info */
+    char *stego_image_fname;        // Output image file name
+    char part_fname[MAX_OUT_FNAME + 8]; // Output being written, renamed when done
+    FILE *fptr_stego_image;         // File pointer to the output image
+
+    /* Files to embed */
+    uint file_count;                        // Number of files in the archive
+    char *file_names[MAX_ARCHIVE_FILES];    // Paths of the files to embed
+    ArchiveEntry toc[MAX_ARCHIVE_FILES];    // Table of contents
+
+} ArchiveInfo;
+
+/*
+ * Function: read_and_validate_archive_args
+ * Purpose: Validates the command-line arguments passed for archive embedding.
+ * Inputs:
+ *  - argc, argv: Command-line arguments (-a <cover> <output> <file1> [file2 ...]).
+ *  - arcInfo: Pointer to ArchiveInfo structure to store parsed arguments.
+ * Outputs:
+ *  - Returns e_success if validation is successful, otherwise e_failure.
+ */
+Status read_and_validate_archive_args(int argc, char *argv[], ArchiveInfo *arcInfo);
+
+/*
+ * Function: do_archive_encoding
+ * Purpose: Embeds every file of the archive together with its table of contents.
+ * Inputs:
+ *  - arcInfo: Pointer to ArchiveInfo structure containing necessary details.
+ * Outputs:
+ *  - Returns e_success if embedding is completed successfully, otherwise e_failure.
+ */
+Status do_archive_encoding(ArchiveInfo *arcInfo);
+
+/*
+ * Function: archive_data_start
+ * Purpose: Computes the carrier sample where the data region begins.
+ * Inputs:
+ *  - toc, count: Table of contents and number of entries.
+ * Outputs:
+ *  - Returns the sample index in the stego image.
+ */
+long archive_data_start(const ArchiveEntry *toc, uint count);
+
+/*
+ * Function: read_archive_toc
+ * Purpose: Reads and validates the archive magic and table of contents.
+ * Inputs:
+ *  - carrier: Layout of the stego image.
+ *  - fptr: File pointer to the stego image.
+ *  - toc: Array of MAX_ARCHIVE_FILES entries to fill.
+ *  - count: Receives the number of entries.
+ * Outputs:
+ *  - Returns e_success if a valid table was read, otherwise e_failure.
+ */
+Status read_archive_toc(CarrierInfo *carrier, FILE *fptr, ArchiveEntry *toc, uint *count);
+
+/*
+ * Function: extract_archive_file
+ * Purpose: Seeks straight to one file of the archive and decodes only its bytes.
+ * Inputs:
+ *  - decInfo: Pointer to DecodeInfo structure; extract_name selects the file.
+ * Outputs:
+ *  - Returns e_success if the file was extracted, otherwise e_failure.
+ */
+Status extract_archive_file(DecodeInfo *decInfo);
+
+#endif // End of ARCHIVE_H
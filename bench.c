@@ -0,0 +1,424 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "types.h"
+#include "encode.h"
+#include "decode.h"
+#include "kernel.h"
+#include "quality.h"
+#include "analysis.h"
+#include "fec.h"
+#include "bench.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#endif
+
+#define CHECK_MAX_LEN 67    // Longest random case, odd so every tail path runs
+#define CHECK_LONG_EVERY 64 // Every Nth case of the block checks is long
+#define CHECK_LONG_GROUPS 4200  // Longest of those, past the counter flushes of the block kernels
+
+/* Timing of one kernel direction on one buffer */
+typedef struct _BenchTiming
+{
+    double ns_per_byte;     // Wall time per payload byte
+    double cycles_per_byte; // TSC cycles per payload byte, 0 when unavailable
+} BenchTiming;
+
+// Function to return the next value of a xorshift generator
+static uint bench_random(uint *state)
+{
+    uint x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// Function to fill a buffer with random bytes
+static void bench_fill(unsigned char *buffer, size_t len, uint *state)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        buffer[i] = bench_random(state);
+    }
+}
+
+// Function to find the reference kernel of a depth
+static const LsbKernel *reference_kernel(uint bits)
+{
+    for (uint i = 0; i < lsb_kernel_count; i++)
+    {
+        if (lsb_kernels[i].bits == bits)
+        {
+            return &lsb_kernels[i];
+        }
+    }
+    return NULL;
+}
+
+// Function to check one kernel against its reference
+static Status verify_kernel(const LsbKernel *kernel, uint rounds, uint *state)
+{
+    unsigned char data[CHECK_MAX_LEN], got[CHECK_MAX_LEN], want[CHECK_MAX_LEN];
+    unsigned char cover[CHECK_MAX_LEN * 8 + 1], ref_out[CHECK_MAX_LEN * 8 + 1], out[CHECK_MAX_LEN * 8 + 1];
+    const LsbKernel *ref = reference_kernel(kernel->bits);
+
+    for (uint r = 0; r < rounds; r++)
+    {
+        // Random length and start, so unaligned heads and short tails are covered
+        uint len = bench_random(state) % (CHECK_MAX_LEN + 1);
+        uint skew = bench_random(state) & 1;
+        uint samples = len * 8 / kernel->bits;
+        bench_fill(data, len, state);
+        bench_fill(cover, sizeof(cover), state);
+
+        // Embed: identical samples, including the untouched upper bits
+        memcpy(ref_out, cover, sizeof(cover));
+        memcpy(out, cover, sizeof(cover));
+        ref->embed(data, len, ref_out + skew);
+        kernel->embed(data, len, out + skew);
+        if (memcmp(ref_out, out, sizeof(cover)))
+        {
+            printf("INFO: %s embed differs from %s (round %u, %u bytes)\n", kernel->name, ref->name, r, len);
+            return e_failure;
+        }
+
+        // Extract: identical bytes from random samples, and the payload back from embedded ones
+        ref->extract(cover + skew, len, want);
+        kernel->extract(cover + skew, len, got);
+        if (memcmp(want, got, len))
+        {
+            printf("INFO: %s extract differs from %s (round %u, %u bytes)\n", kernel->name, ref->name, r, len);
+            return e_failure;
+        }
+        kernel->extract(out + skew, len, got);
+        if (memcmp(data, got, len) || (samples + skew < sizeof(cover) && out[samples + skew] != cover[samples + skew]))
+        {
+            printf("INFO: %s does not round trip (round %u, %u bytes)\n", kernel->name, r, len);
+            return e_failure;
+        }
+    }
+    return e_success;
+}
+
+// Function to check the 32-bit header kernels against the block kernels
+static Status verify_int_kernels(uint rounds, uint *state)
+{
+    unsigned char ref_out[32], out[32], bytes[4];
+
+    for (uint r = 0; r < rounds; r++)
+    {
+        uint value = bench_random(state);
+        bench_fill(ref_out, sizeof(ref_out), state);
+        memcpy(out, ref_out, sizeof(out));
+
+        // A 32-bit value is its four bytes, most significant first
+        for (int i = 0; i < 4; i++)
+        {
+            bytes[i] = value >> (24 - 8 * i);
+        }
+        encode_int_to_lsb((char *)ref_out, value);
+        lsb_embed_block(bytes, 4, out);
+        if (memcmp(ref_out, out, sizeof(out)) || decode_lsb_to_size((char *)out) != value)
+        {
+            printf("INFO: 32-bit kernels differ from the block kernels (round %u)\n", r);
+            return e_failure;
+        }
+    }
+    return e_success;
+}
+
+// Function to check the quality kernels against the scalar reference
+static Status verify_quality_kernels(uint rounds, uint *state)
+{
+    static unsigned char cover[CHECK_LONG_GROUPS * MAX_CARRIER_GROUP], stego[CHECK_LONG_GROUPS * MAX_CARRIER_GROUP];
+    ChannelQuality want[MAX_CARRIER_GROUP], got[MAX_CARRIER_GROUP];
+    const QualityKernel *ref = &quality_kernels[0];
+
+    for (uint r = 0; r < rounds; r++)
+    {
+        // Every channel count, short blocks for the tails and now and then a long one
+        uint lanes = 1 + bench_random(state) % MAX_CARRIER_GROUP;
+        uint count = bench_random(state) % ((r % CHECK_LONG_EVERY) ? CHECK_MAX_LEN + 1 : CHECK_LONG_GROUPS + 1);
+        bench_fill(cover, (size_t)count * lanes, state);
+        bench_fill(stego, (size_t)count * lanes, state);
+
+        memset(want, 0, sizeof(want));
+        ref->compare(cover, stego, count, lanes, want);
+        for (uint i = 1; i < quality_kernel_count; i++)
+        {
+            memset(got, 0, sizeof(got));
+            quality_kernels[i].compare(cover, stego, count, lanes, got);
+            if (memcmp(want, got, sizeof(want)))
+            {
+                printf("INFO: %s quality differs from %s (round %u, %u groups of %u)\n", quality_kernels[i].name,
+                       ref->name, r, count, lanes);
+                return e_failure;
+            }
+        }
+    }
+    return e_success;
+}
+
+// Function to check the RS analysis kernels against the scalar reference
+static Status verify_rs_analysis_kernels(uint rounds, uint *state)
+{
+    static unsigned char samples[CHECK_LONG_GROUPS * MAX_CARRIER_GROUP];
+    unsigned long long want[8], got[8];
+    const RsAnalysisKernel *ref = &rs_analysis_kernels[0];
+
+    for (uint r = 0; r < rounds; r++)
+    {
+        // Random channel stride; now and then smooth samples, which rarely tie on random bytes
+        uint stride = 1 + bench_random(state) % MAX_CARRIER_GROUP;
+        uint count = bench_random(state) % ((r % CHECK_LONG_EVERY) ? CHECK_MAX_LEN + 1 : CHECK_LONG_GROUPS + 1);
+        bench_fill(samples, (size_t)count * stride, state);
+        if (r & 1)
+        {
+            for (size_t i = 0; i < (size_t)count * stride; i++)
+            {
+                samples[i] = (samples[i] & 3) + (i & 0x80 ? 252 : 0);
+            }
+        }
+
+        memset(want, 0, sizeof(want));
+        ref->count(samples, count, stride, want);
+        for (uint i = 1; i < rs_analysis_kernel_count; i++)
+        {
+            memset(got, 0, sizeof(got));
+            rs_analysis_kernels[i].count(samples, count, stride, got);
+            if (memcmp(want, got, sizeof(want)))
+            {
+                printf("INFO: %s RS analysis differs from %s (round %u, %u samples)\n", rs_analysis_kernels[i].name,
+                       ref->name, r, count);
+                return e_failure;
+            }
+        }
+    }
+    return e_success;
+}
+
+// Function to check the lane gather / scatter kernels against the scalar reference
+static Status verify_lane_kernels(uint rounds, uint *state)
+{
+    static unsigned char raw[CHECK_LONG_GROUPS * MAX_CARRIER_GROUP], want_raw[CHECK_LONG_GROUPS * MAX_CARRIER_GROUP];
+    static unsigned char got_raw[CHECK_LONG_GROUPS * MAX_CARRIER_GROUP], samples[CHECK_LONG_GROUPS * MAX_CARRIER_GROUP];
+    static unsigned char want[CHECK_LONG_GROUPS * MAX_CARRIER_GROUP], got[CHECK_LONG_GROUPS * MAX_CARRIER_GROUP];
+    const LaneKernel *ref = &lane_kernels[0];
+
+    for (uint r = 0; r < rounds; r++)
+    {
+        // Every group size with any non-empty lane mask, short blocks for the tails and now and then a long one
+        uint group_size = 1 + bench_random(state) % MAX_CARRIER_GROUP;
+        uint lane_mask = 1 + bench_random(state) % ((1u << group_size) - 1);
+        uint groups = bench_random(state) % ((r % CHECK_LONG_EVERY) ? CHECK_MAX_LEN + 1 : CHECK_LONG_GROUPS + 1);
+        size_t len = (size_t)groups * group_size;
+        bench_fill(raw, len, state);
+        bench_fill(samples, len, state);
+
+        memset(want, 0, len);
+        ref->gather(raw, groups, group_size, lane_mask, want);
+        memcpy(want_raw, raw, len);
+        ref->scatter(samples, groups, group_size, lane_mask, want_raw);
+        for (uint i = 1; i < lane_kernel_count; i++)
+        {
+            memset(got, 0, len);
+            lane_kernels[i].gather(raw, groups, group_size, lane_mask, got);
+            memcpy(got_raw, raw, len);
+            lane_kernels[i].scatter(samples, groups, group_size, lane_mask, got_raw);
+            if (memcmp(want, got, len) || memcmp(want_raw, got_raw, len))
+            {
+                printf("INFO: %s lanes differ from %s (round %u, %u groups of %u, mask 0x%x)\n", lane_kernels[i].name,
+                       ref->name, r, groups, group_size, lane_mask);
+                return e_failure;
+            }
+        }
+    }
+    return e_success;
+}
+
+// Function to check the Reed-Solomon encoders against the scalar reference
+static Status verify_fec_kernels(uint rounds, uint *state)
+{
+    unsigned char data[RS_DATA], want[RS_PARITY], codeword[RS_BLOCK];
+    const FecKernel *ref = &fec_kernels[0];
+
+    fec_init();
+    for (uint r = 0; r < rounds; r++)
+    {
+        uint k = 1 + bench_random(state) % RS_DATA;
+        bench_fill(data, k, state);
+        ref->encode(data, k, want);
+
+        for (uint i = 0; i < fec_kernel_count; i++)
+        {
+            // Same parity as the reference, and a damaged codeword still repairs
+            memcpy(codeword, data, k);
+            fec_kernels[i].encode(data, k, codeword + k);
+            if (memcmp(want, codeword + k, RS_PARITY))
+            {
+                printf("INFO: %s parity differs from %s (round %u, %u bytes)\n", fec_kernels[i].name, ref->name, r, k);
+                return e_failure;
+            }
+            uint damage = bench_random(state) % (RS_PARITY / 2 + 1);
+            for (uint d = 0; d < damage; d++)
+            {
+                codeword[bench_random(state) % (k + RS_PARITY)] ^= 1 + bench_random(state) % 255;
+            }
+            if (rs_decode(codeword, k + RS_PARITY) < 0 || memcmp(data, codeword, k))
+            {
+                printf("INFO: %s does not round trip (round %u, %u bytes)\n", fec_kernels[i].name, r, k);
+                return e_failure;
+            }
+        }
+    }
+    return e_success;
+}
+
+// Function to run the differential checks
+Status verify_kernels(uint rounds, uint seed)
+{
+    uint state = seed ? seed : 1;
+    Status status = e_success;
+
+    printf("INFO: Differential check, %u rounds per kernel, seed %u\n", rounds, seed);
+    for (uint i = 0; i < lsb_kernel_count; i++)
+    {
+        Status s = verify_kernel(&lsb_kernels[i], rounds, &state);
+        printf("INFO: %-10s %u-bit %s\n", lsb_kernels[i].name, lsb_kernels[i].bits, s == e_success ? "identical" : "MISMATCH");
+        status = (s == e_success) ? status : e_failure;
+    }
+    Status s = verify_int_kernels(rounds, &state);
+    printf("INFO: %-10s %u-bit %s\n", "int32", 1, s == e_success ? "identical" : "MISMATCH");
+    status = (s == e_success) ? status : e_failure;
+    s = verify_quality_kernels(rounds, &state);
+    printf("INFO: %-10s %u variants %s\n", "quality", quality_kernel_count, s == e_success ? "identical" : "MISMATCH");
+    status = (s == e_success) ? status : e_failure;
+    s = verify_rs_analysis_kernels(rounds, &state);
+    printf("INFO: %-10s %u variants %s\n", "rs-scan", rs_analysis_kernel_count, s == e_success ? "identical" : "MISMATCH");
+    status = (s == e_success) ? status : e_failure;
+    s = verify_lane_kernels(rounds, &state);
+    printf("INFO: %-10s %u variants %s\n", "lanes", lane_kernel_count, s == e_success ? "identical" : "MISMATCH");
+    status = (s == e_success) ? status : e_failure;
+    s = verify_fec_kernels(rounds, &state);
+    printf("INFO: %-10s %u variants %s\n", "rs-encode", fec_kernel_count, s == e_success ? "identical" : "MISMATCH");
+    return (s == e_success) ? status : e_failure;
+}
+
+// Function to read a monotonic clock in nanoseconds
+static double bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Function to read the cycle counter
+static unsigned long long bench_cycles(void)
+{
+#ifdef HAVE_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Function to time one direction of a kernel on a buffer
+static BenchTiming bench_kernel(const LsbKernel *kernel, int extract, unsigned char *data, unsigned char *samples, uint len)
+{
+    BenchTiming best = { 0.0, 0.0 };
+    uint reps = (len < BENCH_TARGET_BYTES) ? BENCH_TARGET_BYTES / len : 1;
+
+    for (int run = 0; run < BENCH_RUNS; run++)
+    {
+        double start_ns = bench_now_ns();
+        unsigned long long start_cycles = bench_cycles();
+        for (uint r = 0; r < reps; r++)
+        {
+            if (extract)
+            {
+                kernel->extract(samples, len, data);
+            }
+            else
+            {
+                kernel->embed(data, len, samples);
+            }
+        }
+        double bytes = (double)reps * len;
+        BenchTiming t = { (bench_now_ns() - start_ns) / bytes, (bench_cycles() - start_cycles) / bytes };
+        if (run == 0 || t.ns_per_byte < best.ns_per_byte)
+        {
+            best = t;
+        }
+    }
+    return best;
+}
+
+// Function to handle the benchmark operation
+Status do_benchmark(int argc, char *argv[])
+{
+    uint rounds = BENCH_DEFAULT_ROUNDS;
+    uint seed = time(NULL);
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc)
+        {
+            rounds = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            seed = strtoul(argv[++i], NULL, 0);
+        }
+        else
+        {
+            printf("INFO: Unexpected argument %s\n", argv[i]);
+            return e_failure;
+        }
+    }
+
+    // Never time a kernel that is not proven identical
+    if (verify_kernels(rounds, seed) == e_failure)
+    {
+        printf("INFO: Kernels differ from the reference. Not benchmarking.\n");
+        return e_failure;
+    }
+
+    // Samples for the largest buffer at the smallest depth
+    unsigned char *data = malloc(BENCH_DRAM_BYTES);
+    unsigned char *samples = malloc((size_t)BENCH_DRAM_BYTES * 8);
+    if (data == NULL || samples == NULL)
+    {
+        free(data);
+        free(samples);
+        return e_failure;
+    }
+    uint state = seed ? seed : 1;
+    bench_fill(data, BENCH_DRAM_BYTES, &state);
+    bench_fill(samples, (size_t)BENCH_DRAM_BYTES * 8, &state);
+
+    static const struct { const char *name; uint len; } buffers[] =
+    {
+        { "cache", BENCH_CACHE_BYTES },
+        { "dram", BENCH_DRAM_BYTES },
+    };
+
+    printf("%-10s %4s %-6s %12s %12s %12s %12s\n", "kernel", "bits", "buffer", "embed ns/B", "embed cyc/B", "extract ns/B", "extract cyc/B");
+    for (uint b = 0; b < sizeof(buffers) / sizeof(buffers[0]); b++)
+    {
+        for (uint i = 0; i < lsb_kernel_count; i++)
+        {
+            const LsbKernel *kernel = &lsb_kernels[i];
+            BenchTiming embed = bench_kernel(kernel, 0, data, samples, buffers[b].len);
+            BenchTiming extract = bench_kernel(kernel, 1, data, samples, buffers[b].len);
+            printf("%-10s %4u %-6s %12.3f %12.2f %12.3f %12.2f\n", kernel->name, kernel->bits, buffers[b].name,
+                   embed.ns_per_byte, embed.cycles_per_byte, extract.ns_per_byte, extract.cycles_per_byte);
+        }
+    }
+
+    free(data);
+    free(samples);
+    return e_success;
+}
@@ -0,0 +1,45 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "types.h" // Contains user defined types
+
+/*
+ * This header file defines the kernel microbenchmark. It first proves that
+ * every registered LSB kernel is bit-identical to the scalar reference of
+ * its depth on random inputs, then times each one on a cache-resident and
+ * a DRAM-resident buffer. The SIMD variants of the quality statistics, the
+ * RS analysis and the Reed-Solomon encoder are checked the same way.
+ */
+
+#define BENCH_DEFAULT_ROUNDS 2000       // Random cases per kernel in the differential check
+#define BENCH_CACHE_BYTES (4 << 10)     // Payload bytes of the cache-resident buffer
+#define BENCH_DRAM_BYTES (8 << 20)      // Payload bytes of the DRAM-resident buffer
+#define BENCH_TARGET_BYTES (16 << 20)   // Payload bytes processed per timing run
+#define BENCH_RUNS 3                    // Timing runs, the fastest is reported
+
+/*
+ * Function: verify_kernels
+ * Purpose: Runs randomized differential checks of every kernel against the
+ *          reference of its depth, including the 32-bit header kernels
+ *          the quality statistics, the RS analysis and the Reed-Solomon
+ *          encoders.
+ * Inputs:
+ *  - rounds: Number of random cases per kernel.
+ *  - seed: Seed of the random inputs, printed so a failure can be replayed.
+ * Outputs:
+ *  - Returns e_success if every kernel matched, otherwise e_failure.
+ */
+Status verify_kernels(uint rounds, uint seed);
+
+/*
+ * Function: do_benchmark
+ * Purpose: Handles "-b [--rounds N] [--seed N]": verifies the kernels, then
+ *          prints ns and cycles per payload byte of every kernel.
+ * Inputs:
+ *  - argc, argv: Command-line arguments.
+ * Outputs:
+ *  - Returns e_success if the kernels verified and were timed, otherwise e_failure.
+ */
+Status do_benchmark(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,441 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "types.h"
+#include "cache.h"
+
+#define CACHE_HASH_PRIME 0x9E3779B97F4A7C15ULL  // Odd 64-bit multiplier
+#define CACHE_HASH_SEED 0xCBF29CE484222325ULL   // Start of every hash
+#define CACHE_BLOCK (64 * 1024)                 // Bytes hashed or copied per read
+
+/* Counters kept in the stats file */
+typedef struct _CacheStats
+{
+    unsigned long hits;         // Outputs served from the cache
+    unsigned long misses;       // Lookups without a usable object
+    unsigned long stores;       // Objects added
+    unsigned long evictions;    // Objects removed for space
+    unsigned long corrupt;      // Objects dropped because their hash changed
+    unsigned long hit_bytes;    // Output bytes served from the cache
+} CacheStats;
+
+/* One object seen while evicting */
+typedef struct _CacheEntry
+{
+    char name[32];      // Key in hex
+    long size;          // Object bytes
+    struct timespec used;   // Time of the last store or hit
+} CacheEntry;
+
+// Function to hash a buffer, eight bytes per multiply
+static uint64_t hash_bytes(uint64_t h, const unsigned char *p, size_t n)
+{
+    while (n >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        h = (h ^ word) * CACHE_HASH_PRIME;
+        h ^= h >> 32;
+        p += 8;
+        n -= 8;
+    }
+    while (n-- > 0)
+    {
+        h = (h ^ *p++) * CACHE_HASH_PRIME;
+        h ^= h >> 32;
+    }
+    return h;
+}
+
+// Function to hash a whole file
+static Status hash_file(const char *fname, uint64_t *hash, long *size)
+{
+    static __thread unsigned char buffer[CACHE_BLOCK];
+    uint64_t h = CACHE_HASH_SEED;
+    size_t n;
+
+    FILE *fptr = fopen(fname, "r");
+    if (fptr == NULL)
+    {
+        return e_failure;
+    }
+
+    // Blocks are a multiple of eight, so the hash does not depend on them
+    *size = 0;
+    while ((n = fread(buffer, 1, sizeof(buffer), fptr)) > 0)
+    {
+        h = hash_bytes(h, buffer, n);
+        *size += n;
+    }
+    int failed = ferror(fptr);
+    fclose(fptr);
+    *hash = h ^ *size;
+    return failed ? e_failure : e_success;
+}
+
+// Function to build the path of an object or meta file
+static void object_path(const ResultCache *cache, char *path, const char *ext)
+{
+    snprintf(path, MAX_CACHE_PATH, "%s/objects/%016llx%s", cache->dir, (unsigned long long)cache->key, ext);
+}
+
+// Function to copy a file under a private name next to dest, then rename it into place
+static Status copy_file(const char *src, const char *dest)
+{
+    static __thread unsigned char buffer[CACHE_BLOCK];
+    char tmp[MAX_CACHE_PATH + 16];
+    struct stat st;
+    Status status = e_success;
+
+    int fd_src = open(src, O_RDONLY);
+    if (fd_src < 0)
+    {
+        return e_failure;
+    }
+    snprintf(tmp, sizeof(tmp), "%s.XXXXXX", dest);
+    int fd_dest = mkstemp(tmp);
+    if (fd_dest < 0 || fstat(fd_src, &st) || fchmod(fd_dest, st.st_mode & 0777))
+    {
+        if (fd_dest >= 0)
+        {
+            close(fd_dest);
+            unlink(tmp);
+        }
+        close(fd_src);
+        return e_failure;
+    }
+
+    // Let the kernel share the extents (a reflink where supported), then fall back to plain copying
+    loff_t in = 0, out = 0;
+    while (in < st.st_size)
+    {
+        ssize_t n = copy_file_range(fd_src, &in, fd_dest, &out, st.st_size - in, 0);
+        if (n <= 0)
+        {
+            break;
+        }
+    }
+    while (status == e_success && in < st.st_size)
+    {
+        ssize_t n = pread(fd_src, buffer, (st.st_size - in < CACHE_BLOCK) ? st.st_size - in : CACHE_BLOCK, in);
+        if (n <= 0 || pwrite(fd_dest, buffer, n, out) != n)
+        {
+            status = e_failure;
+        }
+        in += n;
+        out += n;
+    }
+    close(fd_src);
+
+    // Readers of dest see the old file or the whole copy, and never share an inode with the source
+    if (close(fd_dest) || status == e_failure || rename(tmp, dest))
+    {
+        unlink(tmp);
+        return e_failure;
+    }
+    return e_success;
+}
+
+// Function to create the cache directories on first use
+static Status make_cache_dirs(const ResultCache *cache)
+{
+    char path[MAX_CACHE_PATH];
+
+    snprintf(path, sizeof(path), "%s/objects", cache->dir);
+    if ((mkdir(cache->dir, 0755) && errno != EEXIST) || (mkdir(path, 0755) && errno != EEXIST))
+    {
+        perror("mkdir");
+        return e_failure;
+    }
+    return e_success;
+}
+
+// Function to add to the shared counters and print them
+static void update_stats(const ResultCache *cache, const CacheStats *add)
+{
+    char path[MAX_CACHE_PATH];
+    char text[256] = "";
+    CacheStats stats;
+
+    memset(&stats, 0, sizeof(stats));
+    snprintf(path, sizeof(path), "%s/stats", cache->dir);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        return;
+    }
+
+    // Every process updates the same file, one at a time
+    flock(fd, LOCK_EX);
+    ssize_t n = pread(fd, text, sizeof(text) - 1, 0);
+    text[(n > 0) ? n : 0] = '\0';
+    sscanf(text, "hits=%lu misses=%lu stores=%lu evictions=%lu corrupt=%lu hit_bytes=%lu",
+           &stats.hits, &stats.misses, &stats.stores, &stats.evictions, &stats.corrupt, &stats.hit_bytes);
+    stats.hits += add->hits;
+    stats.misses += add->misses;
+    stats.stores += add->stores;
+    stats.evictions += add->evictions;
+    stats.corrupt += add->corrupt;
+    stats.hit_bytes += add->hit_bytes;
+    int len = snprintf(text, sizeof(text), "hits=%lu misses=%lu stores=%lu evictions=%lu corrupt=%lu hit_bytes=%lu\n",
+                       stats.hits, stats.misses, stats.stores, stats.evictions, stats.corrupt, stats.hit_bytes);
+    if (ftruncate(fd, 0) == 0)
+    {
+        pwrite(fd, text, len, 0);
+    }
+    close(fd);
+
+    unsigned long lookups = stats.hits + stats.misses;
+    printf("INFO: Cache: %lu hits, %lu misses (%.1f%% hit rate), %lu evictions.\n", stats.hits, stats.misses,
+           lookups ? 100.0 * stats.hits / lookups : 0.0, stats.evictions);
+}
+
+// Function to start a key
+void cache_key_begin(ResultCache *cache, const char *tag)
+{
+    cache->key = CACHE_HASH_SEED;
+    cache_key_string(cache, CACHE_MAGIC);
+    cache_key_string(cache, tag);
+}
+
+// Function to add an option to the key
+void cache_key_string(ResultCache *cache, const char *text)
+{
+    // The length goes first, so neighbouring strings cannot run into each other
+    uint64_t len = (text != NULL) ? strlen(text) : ~0ULL;
+    cache->key = hash_bytes(cache->key, (const unsigned char *)&len, sizeof(len));
+    if (text != NULL)
+    {
+        cache->key = hash_bytes(cache->key, (const unsigned char *)text, len);
+    }
+}
+
+// Function to add a file to the key
+Status cache_key_file(ResultCache *cache, const char *fname)
+{
+    uint64_t hash;
+    long size;
+
+    if (hash_file(fname, &hash, &size) == e_failure)
+    {
+        return e_failure;
+    }
+    cache->key = hash_bytes(cache->key, (const unsigned char *)&hash, sizeof(hash));
+    return e_success;
+}
+
+// Function to serve an output from the cache
+Status cache_fetch(ResultCache *cache, const char *output)
+{
+    char object[MAX_CACHE_PATH], meta[MAX_CACHE_PATH], dest[MAX_CACHE_PATH];
+    char magic[32];
+    unsigned long long sum;
+    long size;
+    CacheStats add;
+
+    memset(&add, 0, sizeof(add));
+    if (make_cache_dirs(cache) == e_failure)
+    {
+        return e_failure;
+    }
+    object_path(cache, object, "");
+    object_path(cache, meta, ".meta");
+    cache->suffix[0] = '\0';
+
+    // The meta file is written last, so an object without one is not complete
+    FILE *fptr = fopen(meta, "r");
+    int fields = 0;
+    if (fptr != NULL)
+    {
+        fields = fscanf(fptr, "%31s %ld %llx", magic, &size, &sum);
+        if (fields == 3 && fgetc(fptr) == '\n' && fgets(cache->suffix, sizeof(cache->suffix), fptr) != NULL)
+        {
+            cache->suffix[strcspn(cache->suffix, "\n")] = '\0';
+        }
+        fclose(fptr);
+    }
+    if (fields != 3 || strcmp(magic, CACHE_MAGIC))
+    {
+        printf("INFO: Cache miss for key %016llx.\n", (unsigned long long)cache->key);
+        add.misses = 1;
+        update_stats(cache, &add);
+        return e_failure;
+    }
+
+    // The object may have been damaged or edited since it was stored
+    uint64_t hash;
+    long actual;
+    if (hash_file(object, &hash, &actual) == e_failure || actual != size || hash != sum)
+    {
+        printf("INFO: Cache object %016llx does not match its hash, dropping it.\n", (unsigned long long)cache->key);
+        unlink(meta);
+        unlink(object);
+        add.misses = 1;
+        add.corrupt = 1;
+        update_stats(cache, &add);
+        return e_failure;
+    }
+
+    snprintf(dest, sizeof(dest), "%s%s", output, cache->suffix);
+    if (copy_file(object, dest) == e_failure)
+    {
+        perror("cache");
+        add.misses = 1;
+        update_stats(cache, &add);
+        return e_failure;
+    }
+
+    // Mark the object as recently used
+    utimensat(AT_FDCWD, meta, NULL, 0);
+    printf("INFO: Cache hit for key %016llx, copied %s (%ld bytes).\n", (unsigned long long)cache->key, dest, size);
+    add.hits = 1;
+    add.hit_bytes = size;
+    update_stats(cache, &add);
+    return e_success;
+}
+
+// Function to order objects from least to most recently used
+static int compare_entries(const void *a, const void *b)
+{
+    const CacheEntry *x = a, *y = b;
+    if (x->used.tv_sec != y->used.tv_sec)
+    {
+        return (x->used.tv_sec > y->used.tv_sec) - (x->used.tv_sec < y->used.tv_sec);
+    }
+    return (x->used.tv_nsec > y->used.tv_nsec) - (x->used.tv_nsec < y->used.tv_nsec);
+}
+
+// Function to remove least recently used objects until the rest fits the limit
+static uint evict_objects(const ResultCache *cache)
+{
+    char path[MAX_CACHE_PATH], current[32];
+    CacheEntry *entries = NULL;
+    uint count = 0, capacity = 0, evicted = 0;
+    long total = 0;
+    struct dirent *ent;
+
+    snprintf(path, sizeof(path), "%s/objects", cache->dir);
+    DIR *dir = opendir(path);
+    if (dir == NULL)
+    {
+        return 0;
+    }
+    while ((ent = readdir(dir)) != NULL)
+    {
+        struct stat meta_st, object_st;
+        char *ext = strstr(ent->d_name, ".meta");
+        if (ext == NULL || ext[5] != '\0' || ext - ent->d_name >= (long)sizeof(entries->name))
+        {
+            continue;
+        }
+        if (count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            CacheEntry *grown = realloc(entries, capacity * sizeof(CacheEntry));
+            if (grown == NULL)
+            {
+                break;
+            }
+            entries = grown;
+        }
+        CacheEntry *entry = &entries[count];
+        snprintf(entry->name, sizeof(entry->name), "%.*s", (int)(ext - ent->d_name), ent->d_name);
+        snprintf(path, sizeof(path), "%s/objects/%s", cache->dir, ent->d_name);
+        if (stat(path, &meta_st))
+        {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/objects/%s", cache->dir, entry->name);
+        entry->size = stat(path, &object_st) ? 0 : object_st.st_size;
+        entry->used = meta_st.st_mtim;
+        total += entry->size;
+        count++;
+    }
+    closedir(dir);
+
+    // The object just stored is never the one to go, even if its timestamp ties with older ones
+    snprintf(current, sizeof(current), "%016llx", (unsigned long long)cache->key);
+    qsort(entries, count, sizeof(CacheEntry), compare_entries);
+    for (uint i = 0; i < count && total > cache->limit; i++)
+    {
+        if (strcmp(entries[i].name, current) == 0)
+        {
+            continue;
+        }
+        // The meta file goes first, so a racing lookup sees a miss, not a partial object
+        snprintf(path, sizeof(path), "%s/objects/%s.meta", cache->dir, entries[i].name);
+        unlink(path);
+        snprintf(path, sizeof(path), "%s/objects/%s", cache->dir, entries[i].name);
+        unlink(path);
+        total -= entries[i].size;
+        evicted++;
+    }
+    free(entries);
+    return evicted;
+}
+
+// Function to add a finished output to the cache
+Status cache_store(ResultCache *cache, const char *output, const char *suffix)
+{
+    char object[MAX_CACHE_PATH], meta[MAX_CACHE_PATH], tmp[MAX_CACHE_PATH + 16];
+    uint64_t hash;
+    long size;
+    CacheStats add;
+
+    memset(&add, 0, sizeof(add));
+    if (make_cache_dirs(cache) == e_failure)
+    {
+        return e_failure;
+    }
+    if (hash_file(output, &hash, &size) == e_failure || strlen(suffix) >= MAX_CACHE_SUFFIX)
+    {
+        return e_failure;
+    }
+    if (size > cache->limit)
+    {
+        printf("INFO: %s is larger than the cache, not stored.\n", output);
+        return e_failure;
+    }
+
+    // Copy the object in, then publish its meta file; both go through private temporary names
+    object_path(cache, object, "");
+    object_path(cache, meta, ".meta");
+    if (copy_file(output, object) == e_failure)
+    {
+        perror("cache");
+        return e_failure;
+    }
+    snprintf(tmp, sizeof(tmp), "%s.XXXXXX", meta);
+    int fd = mkstemp(tmp);
+    FILE *fptr = (fd >= 0 && fchmod(fd, 0644) == 0) ? fdopen(fd, "w") : NULL;
+    if (fptr == NULL)
+    {
+        perror("cache");
+        if (fd >= 0)
+        {
+            close(fd);
+            unlink(tmp);
+        }
+        return e_failure;
+    }
+    fprintf(fptr, "%s %ld %016llx\n%s\n", CACHE_MAGIC, size, (unsigned long long)hash, suffix);
+    if (fclose(fptr) || rename(tmp, meta))
+    {
+        perror("rename");
+        unlink(tmp);
+        return e_failure;
+    }
+    printf("INFO: Stored %s in the cache as %016llx.\n", output, (unsigned long long)cache->key);
+
+    add.stores = 1;
+    add.evictions = evict_objects(cache);
+    update_stats(cache, &add);
+    return e_success;
+}
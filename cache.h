@@ -0,0 +1,90 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * This header file defines the result cache. An encode or decode given
+ * "--cache <dir>" looks its output up by a 64-bit hash of every input byte
+ * and every option that changes the output:
+ *
+ *   objects/KEY        a copy of the output
+ *   objects/KEY.meta   size and content hash of the object, output suffix
+ *   stats              hit, miss, store and eviction counters
+ *
+ * On a hit the object is checked against its content hash, then copied to
+ * the requested output. Objects and outputs never share an inode, so an
+ * output written later cannot change the cache or other outputs. Every
+ * copy goes to a unique temporary name (mkstemp) and is renamed into place;
+ * copy_file_range shares the extents on filesystems with reflinks. When
+ * the objects grow past the size limit, the least recently used ones are
+ * removed; a hit refreshes the time of the meta file.
+ */
+
+#define CACHE_MAGIC "stego-cache-1"         // First word of every meta file
+#define CACHE_DEFAULT_LIMIT (1024L << 20)   // Object bytes kept by default
+#define MAX_CACHE_PATH 4096                 // Longest path inside the cache
+#define MAX_CACHE_SUFFIX 256                // Longest output suffix
+
+/*
+ * Structure: ResultCache
+ * Purpose: Cache directory and the key of one operation.
+ */
+typedef struct _ResultCache
+{
+    char *dir;                          // Cache directory (NULL = no cache)
+    long limit;                         // Object bytes to keep
+    uint64_t key;                       // Hash of the inputs and options
+    char suffix[MAX_CACHE_SUFFIX];      // Appended to the output name of the object
+} ResultCache;
+
+/*
+ * Function: cache_key_begin
+ * Purpose: Starts a new key.
+ * Inputs:
+ *  - cache: Cache to key.
+ *  - tag: Name of the operation, so encodes and decodes never share keys.
+ */
+void cache_key_begin(ResultCache *cache, const char *tag);
+
+/*
+ * Function: cache_key_string
+ * Purpose: Adds an option to the key; NULL and "" are different.
+ */
+void cache_key_string(ResultCache *cache, const char *text);
+
+/*
+ * Function: cache_key_file
+ * Purpose: Adds the size and every byte of a file to the key.
+ * Outputs:
+ *  - Returns e_failure if the file cannot be read.
+ */
+Status cache_key_file(ResultCache *cache, const char *fname);
+
+/*
+ * Function: cache_fetch
+ * Purpose: Verifies the object of the key and copies it to output plus its suffix.
+ * Inputs:
+ *  - cache: Keyed cache; suffix is filled on a hit.
+ *  - output: Output name without the suffix.
+ * Outputs:
+ *  - Returns e_success on a hit, e_failure on a miss.
+ */
+Status cache_fetch(ResultCache *cache, const char *output);
+
+/*
+ * Function: cache_store
+ * Purpose: Adds a finished output as the object of the key, then evicts
+ *          least recently used objects down to the limit.
+ * Inputs:
+ *  - cache: Keyed cache.
+ *  - output: Full name of the finished output.
+ *  - suffix: Part of output to append to the output name of a later hit.
+ * Outputs:
+ *  - Returns e_success if the object was added.
+ */
+Status cache_store(ResultCache *cache, const char *output, const char *suffix);
+
+#endif
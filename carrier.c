@@ -0,0 +1,802 @@
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "types.h"
+#include "carrier.h"
+#include "plane.h"
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+// Function to read a little-endian value of n bytes
+static uint read_le(const unsigned char *p, int n)
+{
+    uint value = 0;
+    for (int i = n - 1; i >= 0; i--)
+    {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+// Function to fill the derived fields of a layout
+static void carrier_set_layout(CarrierInfo *carrier, uint group_size, uint lane_mask, uint groups)
+{
+    carrier->group_size = group_size;
+    carrier->lane_mask = lane_mask;
+    carrier->lanes = 0;
+    for (uint i = 0; i < group_size; i++)
+    {
+        carrier->lanes += (lane_mask >> i) & 1;
+    }
+    carrier->capacity = groups * carrier->lanes;
+    carrier->phase = 0;
+}
+
+// Function to parse a 24-bit or 32-bit uncompressed BMP header
+static Status parse_bmp_header(FILE *fptr, CarrierInfo *carrier)
+{
+    unsigned char header[54];
+
+    rewind(fptr);
+    if (fread(header, 54, 1, fptr) != 1 || header[0] != 'B' || header[1] != 'M')
+    {
+        return e_failure;
+    }
+
+    uint compression = read_le(header + 30, 4);
+    uint bits_per_pixel = read_le(header + 28, 2);
+    int height = (int)read_le(header + 22, 4);
+
+    carrier->data_offset = read_le(header + 10, 4);
+    carrier->width = read_le(header + 18, 4);
+    carrier->height = (height < 0) ? -height : height; // Top-down images have a negative height
+    carrier->channels = 3;
+    carrier->channel_names = "BGR";
+    carrier->sample_bits = 8;
+
+    if (bits_per_pixel == 24 && compression == 0)
+    {
+        // Every byte of the pixel array carries payload, the row padding included
+        carrier->row_padding = (4 - (carrier->width * 3) % 4) % 4;
+        carrier_set_layout(carrier, 3, 0x7, (carrier->width * 3 + carrier->row_padding) * carrier->height / 3);
+    }
+    else if (bits_per_pixel == 32 && (compression == 0 || compression == 3))
+    {
+        // B, G and R carry payload, alpha is skipped
+        carrier_set_layout(carrier, 4, 0x7, carrier->width * carrier->height);
+    }
+    else
+    {
+        fprintf(stderr, "ERROR: only 24-bit and 32-bit uncompressed BMP are supported\n");
+        return e_failure;
+    }
+    return e_success;
+}
+
+// Function to read one header field of a netpbm file, skipping comments
+static long read_pnm_field(FILE *fptr)
+{
+    int ch = fgetc(fptr);
+
+    // Skip whitespace and comment lines
+    while (ch != EOF && (isspace(ch) || ch == '#'))
+    {
+        if (ch == '#')
+        {
+            while (ch != EOF && ch != '\n')
+            {
+                ch = fgetc(fptr);
+            }
+        }
+        ch = fgetc(fptr);
+    }
+
+    long value = -1;
+    while (ch != EOF && isdigit(ch))
+    {
+        value = (value < 0 ? 0 : value * 10) + (ch - '0');
+        ch = fgetc(fptr);
+    }
+
+    // The single whitespace after the last field is part of the header
+    if (ch != EOF && !isspace(ch))
+    {
+        return -1;
+    }
+    return value;
+}
+
+// Function to parse a binary PPM (P6) or PGM (P5) header
+static Status parse_pnm_header(FILE *fptr, CarrierInfo *carrier)
+{
+    char magic[2];
+
+    rewind(fptr);
+    if (fread(magic, 2, 1, fptr) != 1 || magic[0] != 'P' || (magic[1] != '5' && magic[1] != '6'))
+    {
+        return e_failure;
+    }
+
+    long width = read_pnm_field(fptr);
+    long height = read_pnm_field(fptr);
+    long maxval = read_pnm_field(fptr);
+    if (width <= 0 || height <= 0 || maxval <= 0)
+    {
+        return e_failure;
+    }
+    if (maxval > 255)
+    {
+        fprintf(stderr, "ERROR: only 8-bit netpbm images are supported\n");
+        return e_failure;
+    }
+
+    carrier->data_offset = ftell(fptr);
+    carrier->width = width;
+    carrier->height = height;
+    carrier->sample_bits = 8;
+    if (magic[1] == '6')
+    {
+        // R, G and B all carry payload
+        carrier->channels = 3;
+        carrier->channel_names = "RGB";
+        carrier_set_layout(carrier, 3, 0x7, width * height);
+    }
+    else
+    {
+        carrier->channels = 1;
+        carrier->channel_names = "Y";
+        carrier_set_layout(carrier, 1, 0x1, width * height);
+    }
+    return e_success;
+}
+
+// Function to parse a 16-bit PCM WAV header
+static Status parse_wav_header(FILE *fptr, CarrierInfo *carrier)
+{
+    unsigned char header[12], chunk[8], fmt[16];
+    uint channels = 0, bits_per_sample = 0;
+
+    rewind(fptr);
+    if (fread(header, 12, 1, fptr) != 1 || memcmp(header, "RIFF", 4) || memcmp(header + 8, "WAVE", 4))
+    {
+        return e_failure;
+    }
+
+    // Walk the chunks up to the sample data
+    while (fread(chunk, 8, 1, fptr) == 1)
+    {
+        uint size = read_le(chunk + 4, 4);
+        if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16)
+        {
+            if (fread(fmt, 16, 1, fptr) != 1)
+            {
+                return e_failure;
+            }
+            if (read_le(fmt, 2) != 1)
+            {
+                fprintf(stderr, "ERROR: only PCM WAV is supported\n");
+                return e_failure;
+            }
+            channels = read_le(fmt + 2, 2);
+            bits_per_sample = read_le(fmt + 14, 2);
+            fseek(fptr, (size - 16) + (size & 1), SEEK_CUR);
+        }
+        else if (memcmp(chunk, "data", 4) == 0)
+        {
+            if (bits_per_sample != 16 || channels == 0 || channels * 2 > MAX_CARRIER_GROUP)
+            {
+                fprintf(stderr, "ERROR: only 16-bit PCM WAV is supported\n");
+                return e_failure;
+            }
+
+            // The low byte of every little-endian sample carries payload
+            uint lane_mask = 0;
+            for (uint i = 0; i < channels; i++)
+            {
+                lane_mask |= 1u << (2 * i);
+            }
+            carrier->data_offset = ftell(fptr);
+            carrier->channels = channels;
+            carrier->channel_names = "01234567";
+            carrier->sample_bits = 16;
+            carrier->width = size / (channels * 2);
+            carrier->height = 1;
+            carrier_set_layout(carrier, channels * 2, lane_mask, carrier->width);
+            return e_success;
+        }
+        else
+        {
+            // Chunks are padded to an even size
+            fseek(fptr, size + (size & 1), SEEK_CUR);
+        }
+    }
+    return e_failure;
+}
+
+// Function to parse the header of a packed LSB plane opened with plane_fopen
+static Status parse_plane_header(FILE *fptr, CarrierInfo *carrier)
+{
+    static const char *const known_names[] = { "BGR", "RGB", "Y", "01234567" };
+    unsigned char header[PLANE_HEADER_SIZE];
+
+    rewind(fptr);
+    if (fread(header, PLANE_HEADER_SIZE, 1, fptr) != 1 || memcmp(header, PLANE_STREAM_MAGIC, 4))
+    {
+        return e_failure;
+    }
+
+    // The channel letters point at static strings, so find the ones the plane was exported with
+    uint channels = header[5];
+    carrier->channel_names = NULL;
+    for (uint i = 0; i < sizeof(known_names) / sizeof(known_names[0]); i++)
+    {
+        if (strlen(known_names[i]) >= channels && memcmp(header + 8, known_names[i], channels) == 0)
+        {
+            carrier->channel_names = known_names[i];
+            break;
+        }
+    }
+    if (carrier->channel_names == NULL)
+    {
+        return e_failure;
+    }
+
+    // Every byte of the stream is one sample, the lanes of a group are the channels of the source
+    carrier->data_offset = PLANE_HEADER_SIZE;
+    carrier->channels = channels;
+    carrier->sample_bits = 1;
+    carrier->width = read_le(header + 16, 4);
+    carrier->height = read_le(header + 20, 4);
+    carrier->row_padding = header[6];   // Mirrors the rows of the source, so channels line up the same way
+    carrier_set_layout(carrier, channels, (1u << channels) - 1, read_le(header + 24, 4) / channels);
+    return e_success;
+}
+
+/* Supported carrier formats, probed in order */
+static const CarrierBackend backends[] =
+{
+    { "BMP", { ".bmp", NULL }, parse_bmp_header },
+    { "netpbm", { ".ppm", ".pgm", NULL }, parse_pnm_header },
+    { "WAV", { ".wav", NULL }, parse_wav_header },
+    { "LSB plane", { PLANE_EXTN, NULL }, parse_plane_header },
+};
+
+#define NUM_BACKENDS (sizeof(backends) / sizeof(backends[0]))
+
+// Function to check whether an extension belongs to a supported carrier
+Status carrier_known_extn(const char *extn)
+{
+    if (extn == NULL)
+    {
+        return e_failure;
+    }
+    for (uint i = 0; i < NUM_BACKENDS; i++)
+    {
+        for (int j = 0; backends[i].extns[j] != NULL; j++)
+        {
+            if (strcmp(extn, backends[i].extns[j]) == 0)
+            {
+                return e_success;
+            }
+        }
+    }
+    return e_failure;
+}
+
+// Function to detect the carrier format and parse its header
+Status carrier_open(FILE *fptr, CarrierInfo *carrier)
+{
+    memset(carrier, 0, sizeof(CarrierInfo));
+    for (uint i = 0; i < NUM_BACKENDS; i++)
+    {
+        if (backends[i].parse_header(fptr, carrier) == e_success)
+        {
+            carrier->backend = &backends[i];
+            fseek(fptr, carrier->data_offset, SEEK_SET);
+            return e_success;
+        }
+    }
+    fprintf(stderr, "ERROR: unsupported carrier format\n");
+    return e_failure;
+}
+
+// Function to copy the carrier header
+Status carrier_copy_header(CarrierInfo *carrier, FILE *fptr_src, FILE *fptr_dest)
+{
+    char buffer[4096];
+
+    if (carrier->data_offset < 0)
+    {
+        return e_failure;
+    }
+    size_t left = carrier->data_offset;
+
+    rewind(fptr_src);
+    while (left > 0)
+    {
+        size_t n = (left < sizeof(buffer)) ? left : sizeof(buffer);
+        if (fread(buffer, n, 1, fptr_src) != 1)
+        {
+            return e_failure;
+        }
+        fwrite(buffer, n, 1, fptr_dest);
+        left -= n;
+    }
+    carrier->phase = 0;
+    carrier->column = 0;
+    return e_success;
+}
+
+// Function to compute the file offset of a group
+static long carrier_group_offset(CarrierInfo *carrier, long group)
+{
+    if (!carrier->skip_padding)
+    {
+        return carrier->data_offset + group * carrier->group_size;
+    }
+
+    // Whole rows of width groups, each followed by its padding
+    long stride = carrier->width * carrier->group_size + carrier->row_padding;
+    long column = carrier->row_phase + group;
+    long row_start = carrier->data_offset - carrier->row_phase * carrier->group_size;
+    return row_start + (column / carrier->width) * stride + (column % carrier->width) * carrier->group_size;
+}
+
+// Function to find the byte of its group holding a lane
+static uint carrier_lane_byte(CarrierInfo *carrier, uint lane)
+{
+    uint byte;
+    for (byte = 0; byte < carrier->group_size; byte++)
+    {
+        if ((carrier->lane_mask >> byte) & 1)
+        {
+            if (lane == 0)
+            {
+                break;
+            }
+            lane--;
+        }
+    }
+    return byte;
+}
+
+// Function to compute the file offset of a sample
+long carrier_sample_offset(CarrierInfo *carrier, long index)
+{
+    long group = index / carrier->lanes;
+    return carrier_group_offset(carrier, group) + carrier_lane_byte(carrier, index % carrier->lanes);
+}
+
+// Function to seek to a sample
+Status carrier_seek(CarrierInfo *carrier, FILE *fptr, long index)
+{
+    long group = index / carrier->lanes;
+    if (fseek(fptr, carrier_sample_offset(carrier, index), SEEK_SET))
+    {
+        return e_failure;
+    }
+    carrier->phase = carrier_lane_byte(carrier, index % carrier->lanes);
+    carrier->column = carrier->skip_padding ? (carrier->row_phase + group) % carrier->width : 0;
+    return e_success;
+}
+
+// Function to set the streaming position from a file offset
+void carrier_sync_position(CarrierInfo *carrier, long offset)
+{
+    carrier->column = 0;
+    if (!carrier->skip_padding)
+    {
+        carrier->phase = (offset - carrier->data_offset) % carrier->group_size;
+        return;
+    }
+
+    // A window ends either inside a row or right before the padding of a finished one
+    long stride = carrier->width * carrier->group_size + carrier->row_padding;
+    long in_row = (offset - (carrier->data_offset - carrier->row_phase * carrier->group_size)) % stride;
+    if (in_row >= (long)(carrier->width * carrier->group_size))
+    {
+        carrier->column = carrier->width;
+        carrier->phase = 0;
+        return;
+    }
+    carrier->column = in_row / carrier->group_size;
+    carrier->phase = in_row % carrier->group_size;
+}
+
+// Function to gather the next n samples
+Status carrier_read_window(CarrierInfo *carrier, FILE *fptr, CarrierWindow *window, uint n)
+{
+    window->raw_len = 0;
+    window->count = 0;
+
+    // Every byte is a sample, read the run directly
+    if (carrier->lanes == carrier->group_size && !carrier->skip_padding)
+    {
+        if (fread(window->raw, 1, n, fptr) != n)
+        {
+            return e_failure;
+        }
+        memcpy(window->samples, window->raw, n);
+        for (uint i = 0; i < n; i++)
+        {
+            window->where[i] = i;
+        }
+        window->raw_len = window->count = n;
+        carrier->phase = (carrier->phase + n) % carrier->group_size;
+        return e_success;
+    }
+
+    // Otherwise find the raw bytes holding the next n samples, remembering the skipped ones
+    uint phase = carrier->phase, column = carrier->column;
+    while (window->count < n)
+    {
+        // A finished row is followed by its padding, kept in raw and never a sample
+        if (carrier->skip_padding && phase == 0 && column == carrier->width)
+        {
+            window->raw_len += carrier->row_padding;
+            column = 0;
+        }
+
+        // Take the lanes left in this group lowest first, one step per sample rather than per byte
+        uint left = (carrier->lane_mask >> phase) << phase, next = carrier->group_size;
+        while (left != 0 && window->count < n)
+        {
+            uint b = __builtin_ctz(left);
+            window->where[window->count++] = window->raw_len + b - phase;
+            left &= left - 1;
+            next = b + 1;
+        }
+
+        // A full window stops right after its last sample, otherwise the group is done
+        next = (window->count < n) ? carrier->group_size : next;
+        window->raw_len += next - phase;
+        phase = next;
+        if (phase == carrier->group_size)
+        {
+            phase = 0;
+            column++;
+        }
+    }
+
+    // Read them in one go and pick the samples out
+    if (fread(window->raw, 1, window->raw_len, fptr) != window->raw_len)
+    {
+        return e_failure;
+    }
+    for (uint i = 0; i < n; i++)
+    {
+        window->samples[i] = window->raw[window->where[i]];
+    }
+    carrier->phase = phase;
+    carrier->column = carrier->skip_padding ? column : 0;
+    return e_success;
+}
+
+// Function to write a window back
+Status carrier_write_window(CarrierWindow *window, FILE *fptr)
+{
+    for (uint i = 0; i < window->count; i++)
+    {
+        window->raw[window->where[i]] = window->samples[i];
+    }
+    if (fwrite(window->raw, 1, window->raw_len, fptr) != window->raw_len)
+    {
+        return e_failure;
+    }
+    return e_success;
+}
+
+// Function to turn channel letters into a channel mask
+Status carrier_channel_mask(CarrierInfo *carrier, const char *names, uint *mask)
+{
+    *mask = 0;
+    for (int i = 0; names[i] != '\0'; i++)
+    {
+        const char *p = strchr(carrier->channel_names, toupper((unsigned char)names[i]));
+        if (p == NULL || (uint)(p - carrier->channel_names) >= carrier->channels)
+        {
+            return e_failure;
+        }
+        *mask |= 1u << (p - carrier->channel_names);
+    }
+    return (*mask != 0) ? e_success : e_failure;
+}
+
+// Function to restrict the payload to some channels
+Status carrier_select_channels(CarrierInfo *carrier, uint channel_mask, long first)
+{
+    // Channel i is the i-th payload carrying byte of a group
+    if (carrier->channels < 2 || channel_mask == 0 || (channel_mask >> carrier->channels) != 0)
+    {
+        return e_failure;
+    }
+    uint lane_mask = 0, channel = 0;
+    for (uint b = 0; b < carrier->group_size; b++)
+    {
+        if ((carrier->lane_mask >> b) & 1)
+        {
+            if ((channel_mask >> channel) & 1)
+            {
+                lane_mask |= 1u << b;
+            }
+            channel++;
+        }
+    }
+
+    // Start on a group boundary, the rest of a partly used group is left alone
+    long groups = carrier->capacity / carrier->lanes;
+    long skipped = (first + carrier->lanes - 1) / carrier->lanes;
+    if (skipped > groups)
+    {
+        return e_failure;
+    }
+
+    // The full layout runs through the row padding, so restart at the next whole pixel
+    if (carrier->row_padding != 0 && !carrier->skip_padding)
+    {
+        long stride = carrier->width * carrier->group_size + carrier->row_padding;
+        long row = skipped * carrier->group_size / stride;
+        long column = (skipped * carrier->group_size % stride + carrier->group_size - 1) / carrier->group_size;
+        if (column >= carrier->width)
+        {
+            row++;
+            column = 0;
+        }
+        carrier_skip_padding(carrier);
+        groups = carrier->capacity / carrier->lanes;
+        skipped = row * carrier->width + column;
+        if (skipped > groups)
+        {
+            return e_failure;
+        }
+    }
+
+    carrier->data_offset = carrier_group_offset(carrier, skipped);
+    if (carrier->skip_padding)
+    {
+        carrier->row_phase = (carrier->row_phase + skipped) % carrier->width;
+    }
+    carrier_set_layout(carrier, carrier->group_size, lane_mask, groups - skipped);
+    carrier->column = carrier->row_phase;
+    return e_success;
+}
+
+// Function to leave the row padding out of the samples
+void carrier_skip_padding(CarrierInfo *carrier)
+{
+    if (carrier->row_padding == 0 || carrier->skip_padding || carrier->width == 0)
+    {
+        return;
+    }
+    carrier->skip_padding = 1;
+    carrier->row_phase = 0;
+    carrier_set_layout(carrier, carrier->group_size, carrier->lane_mask, carrier->width * carrier->height);
+    carrier->column = 0;
+}
+
+// Function to use every byte after an offset as a sample
+void carrier_every_byte(CarrierInfo *carrier, long data_offset, long file_size)
+{
+    carrier->data_offset = data_offset;
+    carrier->channels = 1;
+    carrier->row_padding = 0;
+    carrier->skip_padding = 0;
+    carrier_set_layout(carrier, 1, 0x1, (file_size > data_offset) ? file_size - data_offset : 0);
+}
+
+// Function to gather lanes, testing every byte (the reference)
+static void gather_scalar(const unsigned char *raw, uint groups, uint group_size, uint lane_mask, unsigned char *samples)
+{
+    for (uint i = 0; i < groups * group_size; i++)
+    {
+        if ((lane_mask >> (i % group_size)) & 1)
+        {
+            *samples++ = raw[i];
+        }
+    }
+}
+
+// Function to scatter lanes, testing every byte (the reference)
+static void scatter_scalar(const unsigned char *samples, uint groups, uint group_size, uint lane_mask, unsigned char *raw)
+{
+    for (uint i = 0; i < groups * group_size; i++)
+    {
+        if ((lane_mask >> (i % group_size)) & 1)
+        {
+            raw[i] = *samples++;
+        }
+    }
+}
+
+// Function to list the lane bytes of a group
+static uint lane_offsets(uint group_size, uint lane_mask, uint *offsets)
+{
+    uint lanes = 0;
+    for (uint b = 0; b < group_size; b++)
+    {
+        if ((lane_mask >> b) & 1)
+        {
+            offsets[lanes++] = b;
+        }
+    }
+    return lanes;
+}
+
+// Function to gather lanes group by group from their offsets
+static void gather_offsets(const unsigned char *raw, uint groups, uint group_size, uint lane_mask, unsigned char *samples)
+{
+    uint offsets[MAX_CARRIER_GROUP];
+    uint lanes = lane_offsets(group_size, lane_mask, offsets);
+    for (uint g = 0; g < groups; g++, raw += group_size)
+    {
+        for (uint l = 0; l < lanes; l++)
+        {
+            *samples++ = raw[offsets[l]];
+        }
+    }
+}
+
+// Function to scatter lanes group by group from their offsets
+static void scatter_offsets(const unsigned char *samples, uint groups, uint group_size, uint lane_mask, unsigned char *raw)
+{
+    uint offsets[MAX_CARRIER_GROUP];
+    uint lanes = lane_offsets(group_size, lane_mask, offsets);
+    for (uint g = 0; g < groups; g++, raw += group_size)
+    {
+        for (uint l = 0; l < lanes; l++)
+        {
+            raw[offsets[l]] = *samples++;
+        }
+    }
+}
+
+#ifdef __SSSE3__
+// Function to build the pshufb controls for the 16 / group_size whole groups of a vector
+static uint lane_controls(uint group_size, uint lane_mask, __m128i *gather, __m128i *scatter, __m128i *select)
+{
+    unsigned char g[16], s[16], m[16];
+    uint n = 0;
+
+    // Unused control bytes have the top bit set, so pshufb zeroes them
+    memset(g, 0x80, sizeof(g));
+    memset(s, 0x80, sizeof(s));
+    memset(m, 0, sizeof(m));
+    for (uint p = 0; p < 16 / group_size * group_size; p++)
+    {
+        if ((lane_mask >> (p % group_size)) & 1)
+        {
+            g[n] = p;
+            s[p] = n++;
+            m[p] = 0xFF;
+        }
+    }
+    *gather = _mm_loadu_si128((const __m128i *)g);
+    *scatter = _mm_loadu_si128((const __m128i *)s);
+    *select = _mm_loadu_si128((const __m128i *)m);
+    return n;
+}
+
+// Function to gather lanes with one pshufb per 16 raw bytes
+static void gather_ssse3(const unsigned char *raw, uint groups, uint group_size, uint lane_mask, unsigned char *samples)
+{
+    __m128i gather, scatter, select;
+    uint per_vector = lane_controls(group_size, lane_mask, &gather, &scatter, &select);
+    uint step = 16 / group_size, lanes = per_vector / step, g = 0;
+
+    // Whole 16 byte loads and stores while both stay inside the buffers, the offsets loop does the rest
+    for (; (groups - g) * group_size >= 16 && (groups - g) * lanes >= 16; g += step)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(raw + g * group_size));
+        _mm_storeu_si128((__m128i *)(samples + g * lanes), _mm_shuffle_epi8(v, gather));
+    }
+    gather_offsets(raw + g * group_size, groups - g, group_size, lane_mask, samples + g * lanes);
+}
+
+// Function to scatter lanes with one pshufb and a blend per 16 raw bytes
+static void scatter_ssse3(const unsigned char *samples, uint groups, uint group_size, uint lane_mask, unsigned char *raw)
+{
+    __m128i gather, scatter, select;
+    uint per_vector = lane_controls(group_size, lane_mask, &gather, &scatter, &select);
+    uint step = 16 / group_size, lanes = per_vector / step, g = 0;
+
+    // Bytes past the whole groups of a vector are stored back unchanged
+    for (; (groups - g) * group_size >= 16 && (groups - g) * lanes >= 16; g += step)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(raw + g * group_size));
+        __m128i s = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(samples + g * lanes)), scatter);
+        v = _mm_or_si128(_mm_andnot_si128(select, v), _mm_and_si128(select, s));
+        _mm_storeu_si128((__m128i *)(raw + g * group_size), v);
+    }
+    scatter_offsets(samples + g * lanes, groups - g, group_size, lane_mask, raw + g * group_size);
+}
+#endif
+
+/* Registered lane kernels; the first is the reference */
+const LaneKernel lane_kernels[] =
+{
+    { "scalar", gather_scalar, scatter_scalar },
+    { "offsets", gather_offsets, scatter_offsets },
+#ifdef __SSSE3__
+    { "ssse3", gather_ssse3, scatter_ssse3 },
+#endif
+};
+
+const uint lane_kernel_count = sizeof(lane_kernels) / sizeof(lane_kernels[0]);
+
+// Function to gather the lanes of whole groups with the fastest kernel
+void carrier_gather(const CarrierInfo *carrier, const unsigned char *raw, uint groups, unsigned char *samples)
+{
+#ifdef __SSSE3__
+    gather_ssse3(raw, groups, carrier->group_size, carrier->lane_mask, samples);
+#else
+    gather_offsets(raw, groups, carrier->group_size, carrier->lane_mask, samples);
+#endif
+}
+
+// Function to scatter the lanes of whole groups with the fastest kernel
+void carrier_scatter(const CarrierInfo *carrier, const unsigned char *samples, uint groups, unsigned char *raw)
+{
+#ifdef __SSSE3__
+    scatter_ssse3(samples, groups, carrier->group_size, carrier->lane_mask, raw);
+#else
+    scatter_offsets(samples, groups, carrier->group_size, carrier->lane_mask, raw);
+#endif
+}
+
+// Function to read whole groups and keep only their payload carrying bytes
+static uint carrier_read_groups(CarrierInfo *carrier, FILE *fptr, unsigned char *samples, uint groups)
+{
+    // Every byte is a sample, read straight into the destination
+    if (carrier->lanes == carrier->group_size)
+    {
+        return fread(samples, carrier->group_size, groups, fptr);
+    }
+
+    // Otherwise read the raw groups in chunks and compact the lanes
+    unsigned char raw[256 * MAX_CARRIER_GROUP];
+    uint done = 0;
+    while (done < groups)
+    {
+        uint want = (groups - done < 256) ? groups - done : 256;
+        uint got = fread(raw, carrier->group_size, want, fptr);
+        carrier_gather(carrier, raw, got, samples + (size_t)done * carrier->lanes);
+        done += got;
+        if (got < want)
+        {
+            break;
+        }
+    }
+    return done;
+}
+
+// Function to read whole groups, row by row when the padding is skipped
+uint carrier_read_block(CarrierInfo *carrier, FILE *fptr, unsigned char *samples, uint groups)
+{
+    if (!carrier->skip_padding)
+    {
+        return carrier_read_groups(carrier, fptr, samples, groups);
+    }
+
+    uint done = 0;
+    while (done < groups)
+    {
+        if (carrier->column == carrier->width)
+        {
+            if (fseek(fptr, carrier->row_padding, SEEK_CUR))
+            {
+                break;
+            }
+            carrier->column = 0;
+        }
+        uint want = (groups - done < carrier->width - carrier->column) ? groups - done : carrier->width - carrier->column;
+        uint got = carrier_read_groups(carrier, fptr, samples + (size_t)done * carrier->lanes, want);
+        done += got;
+        carrier->column += got;
+        if (got < want)
+        {
+            break;
+        }
+    }
+    return done;
+}
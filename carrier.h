@@ -0,0 +1,142 @@
+#ifndef CARRIER_H
+#define CARRIER_H
+
+#include <stdio.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * This header file defines the carrier backends. A backend understands
+ * one file format: it parses the header and describes where the payload
+ * carrying bytes ("samples") live, so that the LSB kernels never need to
+ * know the format.
+ *
+ * Samples are laid out in groups (a pixel or an audio frame) of
+ * group_size bytes starting at data_offset. lane_mask selects the bytes of
+ * a group that carry payload bits; the others (alpha, high sample bytes)
+ * are copied through untouched.
+ *
+ * Rows of 24-bit BMPs are padded to a multiple of 4 bytes. The full layout
+ * runs straight through the padding, as the first builds did, so existing
+ * stego images keep decoding. Layouts that pick channels, and the
+ * per-channel statistics, skip the padding so every group is one whole
+ * pixel.
+ */
+
+#define MAX_CARRIER_GROUP 16    // Largest group (pixel / audio frame) in bytes
+#define MAX_CARRIER_WINDOW 32   // Largest number of samples handled per call
+
+typedef struct _CarrierInfo CarrierInfo;
+
+/*
+ * Structure: CarrierBackend
+ * Purpose: One supported carrier format.
+ */
+typedef struct _CarrierBackend
+{
+    const char *name;                                       // Format name for messages
+    const char *extns[3];                                   // File extensions, NULL terminated
+    Status (*parse_header)(FILE *fptr, CarrierInfo *carrier); // Fill the layout from the header
+} CarrierBackend;
+
+/*
+ * Structure: CarrierInfo
+ * Purpose: Layout of the samples of one carrier file.
+ */
+struct _CarrierInfo
+{
+    const CarrierBackend *backend;  // Backend that parsed the header
+    long data_offset;               // File offset of the first group
+    uint group_size;                // Bytes per group
+    uint lane_mask;                 // Bit i set when byte i of a group carries payload
+    uint lanes;                     // Number of payload bytes per group
+    uint channels;                  // Colour / audio channels per group, one per lane
+    const char *channel_names;      // One letter per channel, in lane order
+    uint sample_bits;               // Bits per channel value (8 for images, 16 for audio)
+    uint width;                     // Image width, or frames for audio
+    uint height;                    // Image height, 1 for audio
+    uint capacity;                  // Number of payload carrying bytes
+    uint phase;                     // Byte position inside the current group while streaming
+    uint row_padding;               // Padding bytes after every row of width groups
+    uint skip_padding;              // 1 when the padding is left out of the samples
+    uint row_phase;                 // Column of the first group when the padding is skipped
+    uint column;                    // Group position inside the current row while streaming
+};
+
+/*
+ * Structure: CarrierWindow
+ * Purpose: A run of samples gathered from the carrier together with the
+ *          raw bytes around them, so they can be written back in place.
+ */
+typedef struct _CarrierWindow
+{
+    char raw[MAX_CARRIER_WINDOW * MAX_CARRIER_GROUP];   // Bytes as read from the file
+    uint raw_len;                                       // Number of raw bytes
+    char samples[MAX_CARRIER_WINDOW];                   // Gathered payload carrying bytes
+    uint where[MAX_CARRIER_WINDOW];                     // Index of each sample in raw
+    uint count;                                         // Number of samples
+} CarrierWindow;
+
+/*
+ * Structure: LaneKernel
+ * Purpose: One implementation of the gather / scatter of the payload
+ *          carrying bytes of whole groups.
+ */
+typedef struct _LaneKernel
+{
+    const char *name;   // Variant name for reports
+    void (*gather)(const unsigned char *raw, uint groups, uint group_size, uint lane_mask,
+                   unsigned char *samples);     // Lanes of groups raw groups into groups * lanes samples
+    void (*scatter)(const unsigned char *samples, uint groups, uint group_size, uint lane_mask,
+                    unsigned char *raw);        // The reverse, the other bytes of raw stay as they are
+} LaneKernel;
+
+/* Every compiled variant; the first one is the reference */
+extern const LaneKernel lane_kernels[];
+extern const uint lane_kernel_count;
+
+/* Check whether a file extension belongs to a supported carrier */
+Status carrier_known_extn(const char *extn);
+
+/* Detect the carrier format and parse its header */
+Status carrier_open(FILE *fptr, CarrierInfo *carrier);
+
+/* Copy the carrier header from src to dest, leaving both at the first group */
+Status carrier_copy_header(CarrierInfo *carrier, FILE *fptr_src, FILE *fptr_dest);
+
+/* File offset of a sample, by sample index */
+long carrier_sample_offset(CarrierInfo *carrier, long index);
+
+/* Seek to a sample, by sample index */
+Status carrier_seek(CarrierInfo *carrier, FILE *fptr, long index);
+
+/* Read the next n samples (n <= MAX_CARRIER_WINDOW) into a window */
+Status carrier_read_window(CarrierInfo *carrier, FILE *fptr, CarrierWindow *window, uint n);
+
+/* Write a window back with its samples merged into the raw bytes */
+Status carrier_write_window(CarrierWindow *window, FILE *fptr);
+
+/* Turn channel letters such as "BG" into a channel mask of this carrier */
+Status carrier_channel_mask(CarrierInfo *carrier, const char *names, uint *mask);
+
+/* Leave the row padding out of the samples of a full layout, so every group is one whole pixel */
+void carrier_skip_padding(CarrierInfo *carrier);
+
+/* Set the streaming position from a file offset on a window boundary */
+void carrier_sync_position(CarrierInfo *carrier, long offset);
+
+/* Keep only the lanes of the channels in channel_mask, starting at the first whole group after sample first */
+Status carrier_select_channels(CarrierInfo *carrier, uint channel_mask, long first);
+
+/* Treat every byte from data_offset to the end of the file as a sample, the layout of the first builds */
+void carrier_every_byte(CarrierInfo *carrier, long data_offset, long file_size);
+
+/* Read up to groups whole groups, storing lanes * groups samples; returns groups read */
+uint carrier_read_block(CarrierInfo *carrier, FILE *fptr, unsigned char *samples, uint groups);
+
+/* Gather the payload carrying bytes of groups raw groups with the fastest lane kernel */
+void carrier_gather(const CarrierInfo *carrier, const unsigned char *raw, uint groups, unsigned char *samples);
+
+/* Scatter groups * lanes samples back into their raw groups with the fastest lane kernel */
+void carrier_scatter(const CarrierInfo *carrier, const unsigned char *samples, uint groups, unsigned char *raw);
+
+#endif
@@ -4,4 +4,29 @@
 /* Magic string to identify whether stegged or not */
 #define MAGIC_STRING "#*"
 
+/* Magic string to identify a multi-file archive */
+#define ARCHIVE_MAGIC "#A"
+
+/*
+ * Option flags. They are stored three times in the upper bytes of the
+ * extension size field, so older images (all zero) read as no flags.
+ */
+#define FLAG_FEC 0x01               // Header triplicated, payload Reed-Solomon coded
+#define FLAG_CHANNEL_SHIFT 4        // Position of the channel mask in the flags
+#define FLAG_CHANNEL_MASK 0xF0      // Channels carrying the payload after the field, 0 = all
+#define FLAGS_SUPPORTED (FLAG_FEC | FLAG_CHANNEL_MASK)  // Flags this build understands
+
+/* Channel mask of the flags, bit i = channel i of the carrier */
+#define FLAG_CHANNELS(flags) (((flags) & FLAG_CHANNEL_MASK) >> FLAG_CHANNEL_SHIFT)
+
+/*
+ * Samples of the magic string and extension size field. They always use
+ * every channel, so the flags can be read before the channel mask is known.
+ */
+#define HEADER_FIELD_SAMPLES ((long)(strlen(MAGIC_STRING) + 4) * 8)
+
+/* Pack / unpack the extension size field */
+#define EXTN_FIELD(flags, len) (((uint)(flags) << 24) | ((uint)(flags) << 16) | ((uint)(flags) << 8) | (uint)(len))
+#define EXTN_FIELD_LEN(field) ((field) & 0xFF)
+
 #endif
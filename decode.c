@@ -1,38 +1,132 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
 #include "types.h"
+#include "common.h"
+#include "fec.h"
 #include "decode.h"
+#include "archive.h"
+#include "y4m.h"
+#include "plane.h"
+#include "journal.h"
 
 // Function to read and validate decode arguments
 Status read_and_validate_decode_args(char *argv[], DecodeInfo *decInfo)
 {
+    // Start from a clean structure
+    memset(decInfo, 0, sizeof(DecodeInfo));
+
     // Check if the stego file has a valid extension
-    char *src_extn = strchr(argv[2], '.');
-    // Check if the extension exists and if it's ".bmp"
-    if (src_extn == NULL || strcmp(src_extn, ".bmp") != 0)
+    char *src_extn = strrchr(argv[2], '.');
+    // Check if the extension exists and belongs to a supported carrier
+    decInfo->video_flag = (src_extn != NULL && strcmp(src_extn, Y4M_EXTN) == 0);
+    if (!decInfo->video_flag && carrier_known_extn(src_extn) == e_failure)
     {
-        printf("INFO: Validation Error. The file should have a .bmp extension.\n");
+        printf("INFO: Validation Error. The file should be a .bmp, .ppm, .pgm, .wav, .y4m or .lsbp file.\n");
         return e_failure;
     }
 
     // Store the stego file name in the structure
     decInfo->stego_fname = argv[2];
 
+    // Collect the optional arguments
+    char *out_arg = NULL;
+    for (int i = 3; argv[i] != NULL; i++)
+    {
+        if (strcmp(argv[i], "--extract") == 0)
+        {
+            // Name of the archive member to extract
+            if (argv[i + 1] == NULL)
+            {
+                printf("INFO: Validation Error. --extract needs a file name.\n");
+                return e_failure;
+            }
+            decInfo->extract_name = argv[++i];
+        }
+        else if (strcmp(argv[i], "--range") == 0)
+        {
+            // Byte window of the secret to decode
+            if (argv[i + 1] == NULL || parse_decode_range(argv[i + 1], decInfo) == e_failure)
+            {
+                printf("INFO: Validation Error. --range needs offset:length.\n");
+                return e_failure;
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "--magic") == 0)
+        {
+            // Magic string, so decoding needs no prompt
+            if (argv[i + 1] == NULL)
+            {
+                printf("INFO: Validation Error. --magic needs a string.\n");
+                return e_failure;
+            }
+            decInfo->magic_string = argv[++i];
+        }
+        else if (strcmp(argv[i], "--auto") == 0)
+        {
+            // Find the layout and magic string without asking
+            decInfo->auto_flag = 1;
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && argv[i + 1] != NULL)
+        {
+            // Worker threads of the video pipeline
+            decInfo->threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--cache") == 0 && argv[i + 1] != NULL)
+        {
+            // Reuse outputs of earlier runs on the same carrier
+            decInfo->cache.dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--cache-size") == 0 && argv[i + 1] != NULL && atol(argv[i + 1]) > 0)
+        {
+            // Limit of the cache in MiB
+            decInfo->cache.limit = atol(argv[++i]) << 20;
+        }
+        else if (out_arg == NULL)
+        {
+            out_arg = argv[i];
+        }
+        else
+        {
+            printf("INFO: Validation Error. Unexpected argument %s.\n", argv[i]);
+            return e_failure;
+        }
+    }
+
+    if (decInfo->cache.limit == 0)
+    {
+        decInfo->cache.limit = CACHE_DEFAULT_LIMIT;
+    }
+
     // Check if an output file name is provided
-    if (argv[3] != NULL)
+    if (out_arg != NULL && strlen(out_arg) >= MAX_OUT_FNAME - MAX_FILE_SUFFIX)
     {
-        // Extract extension part from the output file name
-        char *out_extn = strchr(argv[3], '.');
+        printf("INFO: Validation Error. Output file name is too long.\n");
+        return e_failure;
+    }
+    if (out_arg != NULL && decInfo->extract_name != NULL)
+    {
+        // Archive members keep the output name exactly as given
+        strcpy(decInfo->out_fname, out_arg);
+    }
+    else if (out_arg != NULL)
+    {
+        // Extract extension part from the output file name, ignoring dots in its directories
+        char *out_base = strrchr(out_arg, '/');
+        char *out_extn = strchr((out_base != NULL) ? out_base + 1 : out_arg, '.');
         if (out_extn != NULL)
         {
             // Copy the file name before the extension
-            strncpy(decInfo->out_fname, argv[3], out_extn - argv[3]);
-            decInfo->out_fname[out_extn - argv[3]] = '\0'; // Null-terminate the string
+            strncpy(decInfo->out_fname, out_arg, out_extn - out_arg);
+            decInfo->out_fname[out_extn - out_arg] = '\0'; // Null-terminate the string
         }
         else
         {
             // Copy the output file name as it is if no extension is provided
-            strcpy(decInfo->out_fname, argv[3]);
+            strcpy(decInfo->out_fname, out_arg);
         }
     }
     else
@@ -49,6 +143,54 @@ Status do_decoding(DecodeInfo *decInfo)
 {
     printf("INFO: ## Decoding Procedure Started. ##\n");
 
+    // The same carrier and options were decoded before
+    if (decInfo->extract_name != NULL && decInfo->out_flag)
+    {
+        // Members without an output name are written under their own name
+        decInfo->out_fname[0] = '\0';
+    }
+    decInfo->cache_base_len = strlen(decInfo->out_fname);
+    if (decInfo->cache.dir != NULL && decode_from_cache(decInfo) == e_success)
+    {
+        printf("INFO: ## Decoding Done Successfully. ##\n");
+        return e_success;
+    }
+
+    // Video carriers stream frame by frame through their own pipeline
+    if (decInfo->video_flag)
+    {
+        char magic_string[10];
+        if (decInfo->extract_name != NULL || decInfo->range_flag)
+        {
+            printf("Error: --extract and --range do not apply to Y4M carriers.\n");
+            return e_failure;
+        }
+        if (get_magic_string(decInfo, magic_string) == e_failure || do_y4m_decoding(decInfo, magic_string) == e_failure)
+        {
+            return e_failure;
+        }
+        if (decInfo->cache.dir != NULL)
+        {
+            cache_store(&decInfo->cache, decInfo->out_fname, decInfo->out_fname + decInfo->cache_base_len);
+        }
+        printf("INFO: ## Decoding Done Successfully. ##\n");
+        return e_success;
+    }
+
+    // Archive members are located through the table of contents
+    if (decInfo->extract_name != NULL)
+    {
+        if (extract_archive_file(decInfo) == e_failure)
+        {
+            return e_failure;
+        }
+        if (decInfo->cache.dir != NULL)
+        {
+            cache_store(&decInfo->cache, decInfo->out_fname, decInfo->out_fname + decInfo->cache_base_len);
+        }
+        return e_success;
+    }
+
     // Step 1: Open the stego (input) file
     if (open_stego_file(decInfo) == e_failure)
     {
@@ -57,16 +199,27 @@ Status do_decoding(DecodeInfo *decInfo)
     }
 
     // Step 2: Skip the header of the BMP file
-    if (skip_header(decInfo->fptr_stego) == e_failure)
+    if (skip_header(decInfo->fptr_stego, &decInfo->carrier) == e_failure)
     {
         printf("Error skipping header data.\n");
         return e_failure;
     }
 
-    // Step 3: Decode the magic string
+    // Step 3: Decode the magic string, detecting the layout first when asked to
     char magic_string[10];
-    printf("Enter the magic string:\n");
-    scanf("%s", magic_string); // Get the magic string from the user
+    if (decInfo->auto_flag)
+    {
+        if (probe_decode_layout(decInfo, magic_string) == e_failure)
+        {
+            printf("Error detecting the stego layout.\n");
+            return e_failure;
+        }
+        skip_header(decInfo->fptr_stego, &decInfo->carrier);
+    }
+    else if (get_magic_string(decInfo, magic_string) == e_failure)
+    {
+        return e_failure;
+    }
     if (decode_magic_string(magic_string, decInfo) == e_failure)
     {
         printf("Magic String not decoded.\n");
@@ -102,39 +255,373 @@ Status do_decoding(DecodeInfo *decInfo)
         return e_failure;
     }
 
-    // Step 8: Decode the secret file data
-    if (decode_secret_file_data(decInfo) == e_failure)
+    // Step 8: Decode the secret file data, or only the requested window of it
+    if (decInfo->range_flag)
+    {
+        long offset = decInfo->range_offset;
+        long length = decInfo->range_length;
+
+        // Resolve the range against the decoded size
+        if (offset < 0)
+        {
+            offset += decInfo->secret_size;
+        }
+        if (offset < 0 || offset > (long)decInfo->secret_size)
+        {
+            printf("Error: range is outside the %u byte secret.\n", decInfo->secret_size);
+            return e_failure;
+        }
+        if (length < 0)
+        {
+            length = (long)decInfo->secret_size - offset;
+        }
+
+        // Compared with what is left after offset, so a length near LONG_MAX cannot overflow the sum
+        if (length > (long)decInfo->secret_size - offset)
+        {
+            printf("Error: range is outside the %u byte secret.\n", decInfo->secret_size);
+            return e_failure;
+        }
+
+        if (decInfo->flags & FLAG_FEC)
+        {
+            printf("Error: ranges cannot be decoded from error corrected images.\n");
+            return e_failure;
+        }
+        if (decode_secret_range(decInfo, offset, length) == e_failure)
+        {
+            printf("Error decoding secret range.\n");
+            return e_failure;
+        }
+    }
+    else if (((decInfo->flags & FLAG_FEC) ? decode_secret_file_data_fec(decInfo) : decode_secret_file_data(decInfo)) == e_failure)
     {
         printf("Error decoding secret data.\n");
         return e_failure;
     }
 
+    if (finish_output_file(decInfo) == e_failure)
+    {
+        printf("Error writing output file.\n");
+        return e_failure;
+    }
+    close_decode_files(decInfo);
+    if (decInfo->cache.dir != NULL)
+    {
+        cache_store(&decInfo->cache, decInfo->out_fname, decInfo->out_fname + decInfo->cache_base_len);
+    }
     printf("INFO: ## Decoding Done Successfully. ##\n");
     return e_success;
 }
 
+/* Function to read one header byte, voted from its copies when protected */
+static Status probe_header_byte(CarrierInfo *carrier, FILE *fptr, uint count, char *byte)
+{
+    char copies[FEC_COPIES];
+
+    for (uint c = 0; c < count; c++)
+    {
+        if (decode_byte_from_image(carrier, fptr, &copies[c]) == e_failure)
+        {
+            return e_failure;
+        }
+    }
+    *byte = (count == 1) ? copies[0] : (char)fec_majority(copies[0], copies[1], copies[2]);
+    return e_success;
+}
+
+/* Function to check one candidate layout and magic string against the header */
+static Status probe_candidate(DecodeInfo *decInfo, CarrierInfo *layout, const char *magic, const char *found)
+{
+    CarrierInfo carrier = *layout;
+    uint field;
+    char byte;
+
+    // Magic string, then the flags stored three times and voted like parse_payload_header does
+    if (strcmp(found, magic) || decode_int_from_image(&carrier, decInfo->fptr_stego, &field) == e_failure)
+    {
+        return e_failure;
+    }
+    uint flags = fec_majority(field >> 24, field >> 16, field >> 8);
+    uint length = EXTN_FIELD_LEN(field);
+    if (flags & ~FLAGS_SUPPORTED)
+    {
+        return e_failure;
+    }
+    if (FLAG_CHANNELS(flags) &&
+        (carrier_select_channels(&carrier, FLAG_CHANNELS(flags), HEADER_FIELD_SAMPLES) == e_failure ||
+         carrier_seek(&carrier, decInfo->fptr_stego, 0) == e_failure))
+    {
+        return e_failure;
+    }
+
+    // A protected image also stores the extension length three times, the voted copy is the one decoded
+    uint count = (flags & FLAG_FEC) ? FEC_COPIES : 1;
+    if (flags & FLAG_FEC)
+    {
+        if (probe_header_byte(&carrier, decInfo->fptr_stego, count, &byte) == e_failure)
+        {
+            return e_failure;
+        }
+        length = (unsigned char)byte;
+    }
+    if (length == 0 || length >= MAX_FILE_SUFFIX)
+    {
+        return e_failure;
+    }
+
+    // The extension is a dot and printable characters
+    for (uint i = 0; i < length; i++)
+    {
+        if (probe_header_byte(&carrier, decInfo->fptr_stego, count, &byte) == e_failure ||
+            (i == 0 && byte != '.') || (i > 0 && (byte < 0x21 || byte > 0x7E)))
+        {
+            return e_failure;
+        }
+    }
+    return e_success;
+}
+
+/* Function to find the layout and magic string of a stego file */
+Status probe_decode_layout(DecodeInfo *decInfo, char *magic_string)
+{
+    CarrierInfo layouts[MAX_PROBE_LAYOUTS];
+    const char *layout_names[MAX_PROBE_LAYOUTS];
+    const char *magics[] = { decInfo->magic_string, MAGIC_STRING };
+    uint count = 0, probed = 0;
+    int archive = 0;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Size of the stream, which for a packed plane is not the size on disk
+    fseek(decInfo->fptr_stego, 0, SEEK_END);
+    long file_size = ftell(decInfo->fptr_stego);
+
+    // The layout of this build, then every byte as a sample from the same offset and from the fixed offset of the first builds
+    layouts[count] = decInfo->carrier;
+    layout_names[count++] = decInfo->carrier.backend->name;
+    if (decInfo->carrier.lanes != decInfo->carrier.group_size)
+    {
+        layouts[count] = decInfo->carrier;
+        carrier_every_byte(&layouts[count], decInfo->carrier.data_offset, file_size);
+        layout_names[count++] = "every byte";
+    }
+    if (decInfo->carrier.data_offset != LEGACY_DATA_OFFSET || decInfo->carrier.lanes != decInfo->carrier.group_size)
+    {
+        layouts[count] = decInfo->carrier;
+        carrier_every_byte(&layouts[count], LEGACY_DATA_OFFSET, file_size);
+        layout_names[count++] = "every byte from offset 54";
+    }
+
+    for (uint i = 0; i < count; i++)
+    {
+        // The magic string of a layout is read once and compared with every candidate
+        char found[sizeof(MAGIC_STRING)];
+        carrier_seek(&layouts[i], decInfo->fptr_stego, 0);
+        for (uint k = 0; k < strlen(MAGIC_STRING); k++)
+        {
+            decode_byte_from_image(&layouts[i], decInfo->fptr_stego, &found[k]);
+        }
+        found[strlen(MAGIC_STRING)] = '\0';
+        archive |= (strcmp(found, ARCHIVE_MAGIC) == 0);
+
+        for (uint j = 0; j < sizeof(magics) / sizeof(magics[0]); j++)
+        {
+            if (magics[j] == NULL || (j > 0 && magics[0] != NULL && strcmp(magics[0], magics[j]) == 0))
+            {
+                continue;
+            }
+            probed++;
+            carrier_seek(&layouts[i], decInfo->fptr_stego, strlen(MAGIC_STRING) * 8);
+            if (probe_candidate(decInfo, &layouts[i], magics[j], found) == e_success)
+            {
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                printf("INFO: Detected %s layout with magic string %s in %.0f us (%u candidates).\n", layout_names[i], magics[j],
+                       (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3, probed);
+                decInfo->carrier = layouts[i];
+                snprintf(magic_string, 10, "%s", magics[j]);
+                return e_success;
+            }
+        }
+    }
+    if (archive)
+    {
+        printf("INFO: The image holds an archive, use --extract <name>.\n");
+    }
+    else
+    {
+        printf("INFO: No layout and magic string matched, %u candidates probed.\n", probed);
+    }
+    return e_failure;
+}
+
+/* Function to take the magic string from the command line or the user */
+Status get_magic_string(DecodeInfo *decInfo, char *magic_string)
+{
+    if (decInfo->magic_string == NULL && decInfo->auto_flag)
+    {
+        // Only the default magic string can be assumed without asking
+        snprintf(magic_string, 10, "%s", MAGIC_STRING);
+        return e_success;
+    }
+    if (decInfo->magic_string != NULL)
+    {
+        snprintf(magic_string, 10, "%s", decInfo->magic_string);
+        return e_success;
+    }
+    printf("Enter the magic string:\n");
+    if (scanf("%9s", magic_string) != 1) // Get the magic string from the user
+    {
+        printf("Magic String not entered.\n");
+        return e_failure;
+    }
+    return e_success;
+}
+
+/* Function to parse a payload header from decoded payload bytes */
+int parse_payload_header(const char *magic_string, const unsigned char *buf, uint len, DecodeInfo *decInfo)
+{
+    uint pos = strlen(MAGIC_STRING);
+
+    // Magic string and extension size field, most significant byte first
+    if (len < pos + 4)
+    {
+        return 0;
+    }
+    if (strlen(magic_string) != pos || memcmp(buf, magic_string, pos))
+    {
+        printf("INFO: Magic String does not match.\n");
+        return -1;
+    }
+    uint field = (uint)buf[pos] << 24 | (uint)buf[pos + 1] << 16 | (uint)buf[pos + 2] << 8 | buf[pos + 3];
+    pos += 4;
+    decInfo->flags = fec_majority(field >> 24, field >> 16, field >> 8);
+    decInfo->secret_extn_length = EXTN_FIELD_LEN(field);
+    if (decInfo->flags & ~FLAGS_SUPPORTED)
+    {
+        printf("INFO: Image uses unsupported options 0x%02x.\n", decInfo->flags);
+        return -1;
+    }
+
+    // Extension and size, every byte FEC_COPIES times when protected
+    uint copies = (decInfo->flags & FLAG_FEC) ? FEC_COPIES : 1;
+    if (decInfo->flags & FLAG_FEC)
+    {
+        if (len < pos + copies)
+        {
+            return 0;
+        }
+        decInfo->secret_extn_length = fec_majority(buf[pos], buf[pos + 1], buf[pos + 2]);
+        pos += copies;
+    }
+    if (decInfo->secret_extn_length >= MAX_FILE_SUFFIX)
+    {
+        return -1; // Extension cannot fit, the carrier is not stegged
+    }
+    if (len < pos + (decInfo->secret_extn_length + 4) * copies)
+    {
+        return 0;
+    }
+    unsigned char fields[MAX_FILE_SUFFIX + 4];
+    for (uint i = 0; i < decInfo->secret_extn_length + 4; i++, pos += copies)
+    {
+        fields[i] = (copies == 1) ? buf[pos] : fec_majority(buf[pos], buf[pos + 1], buf[pos + 2]);
+    }
+    memcpy(decInfo->secret_extn, fields, decInfo->secret_extn_length);
+    decInfo->secret_extn[decInfo->secret_extn_length] = '\0';
+    const unsigned char *size = fields + decInfo->secret_extn_length;
+    decInfo->secret_size = (uint)size[0] << 24 | (uint)size[1] << 16 | (uint)size[2] << 8 | size[3];
+    return pos;
+}
+
+/* Function to key the decode and copy a cached output */
+Status decode_from_cache(DecodeInfo *decInfo)
+{
+    char range[64];
+
+    // Without --magic or --auto the key would depend on what is typed at the prompt
+    if (decInfo->magic_string == NULL && !decInfo->auto_flag)
+    {
+        printf("INFO: --cache needs --magic or --auto, decoding without the cache.\n");
+        decInfo->cache.dir = NULL;
+        return e_failure;
+    }
+
+    // Everything that changes the output bytes is part of the key
+    cache_key_begin(&decInfo->cache, "decode");
+    if (cache_key_file(&decInfo->cache, decInfo->stego_fname) == e_failure)
+    {
+        return e_failure;
+    }
+    cache_key_string(&decInfo->cache, decInfo->magic_string);
+    cache_key_string(&decInfo->cache, decInfo->auto_flag ? "auto" : "");
+    cache_key_string(&decInfo->cache, decInfo->extract_name);
+    snprintf(range, sizeof(range), "%d %ld %ld", decInfo->range_flag, decInfo->range_offset, decInfo->range_length);
+    cache_key_string(&decInfo->cache, range);
+    if (cache_fetch(&decInfo->cache, decInfo->out_fname) == e_failure)
+    {
+        return e_failure;
+    }
+    if (decInfo->cache_base_len + strlen(decInfo->cache.suffix) < MAX_OUT_FNAME)
+    {
+        strcat(decInfo->out_fname, decInfo->cache.suffix);
+    }
+    return e_success;
+}
+
+/* Function to close the files that are still open */
+void close_decode_files(DecodeInfo *decInfo)
+{
+    if (decInfo->fptr_stego != NULL)
+    {
+        fclose(decInfo->fptr_stego);
+        decInfo->fptr_stego = NULL;
+    }
+    if (decInfo->fptr_output != NULL)
+    {
+        fclose(decInfo->fptr_output);
+        decInfo->fptr_output = NULL;
+    }
+    if (decInfo->part_fname[0] != '\0')
+    {
+        // The output was never finished, so it never appears under its real name
+        unlink(decInfo->part_fname);
+        decInfo->part_fname[0] = '\0';
+    }
+}
+
 /* Function to open the stego file */
 Status open_stego_file(DecodeInfo *decInfo)
 {
     printf("INFO: Opening required files.\n");
-    decInfo->fptr_stego = fopen(decInfo->stego_fname, "r");
+    decInfo->fptr_stego = plane_fopen(decInfo->stego_fname);
     if (decInfo->fptr_stego == NULL)
     {
         return e_failure;
     }
     printf("INFO: Opened %s.\n", decInfo->stego_fname);
+
+    // Find out where the samples live
+    if (carrier_open(decInfo->fptr_stego, &decInfo->carrier) == e_failure)
+    {
+        return e_failure;
+    }
     return e_success;
 }
 
 /* Function to open the output file */
 Status open_output_file(DecodeInfo *decInfo)
 {
-    decInfo->fptr_output = fopen(decInfo->out_fname, "w");
+    // Written under a temporary name, so an existing file is replaced only by a complete output
+    snprintf(decInfo->part_fname, sizeof(decInfo->part_fname), "%s%s", decInfo->out_fname, PART_SUFFIX);
+    decInfo->fptr_output = fopen(decInfo->part_fname, "w");
     if (decInfo->fptr_output == NULL)
     {
+        decInfo->part_fname[0] = '\0';
         return e_failure;
     }
-    if (decInfo->out_flag)
+    if (decInfo->out_flag && decInfo->extract_name == NULL)
     {
         printf("INFO: Output file not mentioned. Creating 'decoded.txt' as default.\n");
     }
@@ -142,25 +629,45 @@ Status open_output_file(DecodeInfo *decInfo)
     return e_success;
 }
 
-/* Function to skip the header of the BMP file */
-Status skip_header(FILE *fptr)
+/* Function to put the finished output in place */
+Status finish_output_file(DecodeInfo *decInfo)
 {
-    fseek(fptr, 54, SEEK_SET); // BMP headers are typically 54 bytes
+    FILE *fptr = decInfo->fptr_output;
+
+    decInfo->fptr_output = NULL;
+    if (fptr == NULL || fclose(fptr) || rename(decInfo->part_fname, decInfo->out_fname))
+    {
+        perror("rename");
+        unlink(decInfo->part_fname);
+        decInfo->part_fname[0] = '\0';
+        return e_failure;
+    }
+    decInfo->part_fname[0] = '\0';
     return e_success;
 }
 
+/* Function to skip the header of the carrier file */
+Status skip_header(FILE *fptr, CarrierInfo *carrier)
+{
+    return carrier_seek(carrier, fptr, 0); // Position on the first sample
+}
+
 /* Function to decode the magic string */
 Status decode_magic_string(const char *user_string, DecodeInfo *decInfo)
 {
     printf("INFO: Decoding Magic String Signature.\n");
-    char buffer[8], magic[4];
+    char magic[4];
 
     // Decode the magic string from the file
     for (int i = 0; i < 2; i++)
     {
-        fread(buffer, 8, 1, decInfo->fptr_stego);
-        magic[i] = decode_lsb_to_byte(buffer); // Extract each byte
+        // Extract each byte
+        if (decode_byte_from_image(&decInfo->carrier, decInfo->fptr_stego, &magic[i]) == e_failure)
+        {
+            return e_failure;
+        }
     }
+    magic[2] = '\0'; // Null-terminate the decoded string
 
     // Compare the user-entered magic string with the decoded string
     if (strcmp(user_string, magic) == 0)
@@ -174,23 +681,67 @@ Status decode_magic_string(const char *user_string, DecodeInfo *decInfo)
 /* Function to decode the size of the secret file extension */
 Status decode_secret_file_extn_size(DecodeInfo *decInfo)
 {
-    char buffer[32];
-    fread(buffer, 32, 1, decInfo->fptr_stego); // Read 32 bits from the stego file
-    decInfo->secret_extn_length = decode_lsb_to_size(buffer); // Decode size
+    uint field;
+
+    // Decode size from the next 32 samples
+    if (decode_int_from_image(&decInfo->carrier, decInfo->fptr_stego, &field) == e_failure)
+    {
+        return e_failure;
+    }
+
+    // The option flags are stored three times above the length
+    decInfo->flags = fec_majority(field >> 24, field >> 16, field >> 8);
+    decInfo->secret_extn_length = EXTN_FIELD_LEN(field);
+    if (decInfo->flags & ~FLAGS_SUPPORTED)
+    {
+        printf("INFO: Image uses unsupported options 0x%02x.\n", decInfo->flags);
+        return e_failure;
+    }
+
+    // The rest of the header and the data sit on the selected channels only
+    if (FLAG_CHANNELS(decInfo->flags))
+    {
+        if (carrier_select_channels(&decInfo->carrier, FLAG_CHANNELS(decInfo->flags), HEADER_FIELD_SAMPLES) == e_failure ||
+            carrier_seek(&decInfo->carrier, decInfo->fptr_stego, 0) == e_failure)
+        {
+            printf("INFO: Channel mask does not fit the carrier, the header is damaged.\n");
+            return e_failure;
+        }
+        printf("INFO: Payload is on channel mask 0x%x.\n", FLAG_CHANNELS(decInfo->flags));
+    }
+
+    // Error corrected images keep a protected copy of the length
+    if (decInfo->flags & FLAG_FEC)
+    {
+        char length;
+        if (decode_protected_byte(decInfo, &length) == e_failure)
+        {
+            return e_failure;
+        }
+        decInfo->secret_extn_length = (unsigned char)length;
+    }
+    if (decInfo->secret_extn_length >= MAX_FILE_SUFFIX)
+    {
+        return e_failure; // Extension cannot fit, the image is not stegged
+    }
     return e_success;
 }
 
 /* Function to decode the secret file extension */
 Status decode_secret_file_extention(DecodeInfo *decInfo)
 {
-    char extention[8];
     int i;
 
     // Decode each character of the extension
     for (i = 0; i < decInfo->secret_extn_length; i++)
     {
-        fread(extention, 8, 1, decInfo->fptr_stego);
-        decInfo->secret_extn[i] = decode_lsb_to_byte(extention);
+        Status status = (decInfo->flags & FLAG_FEC) ?
+                        decode_protected_byte(decInfo, &decInfo->secret_extn[i]) :
+                        decode_byte_from_image(&decInfo->carrier, decInfo->fptr_stego, &decInfo->secret_extn[i]);
+        if (status == e_failure)
+        {
+            return e_failure;
+        }
     }
     decInfo->secret_extn[i] = '\0'; // Null-terminate the extension
     strcat(decInfo->out_fname, decInfo->secret_extn); // Append extension to the output file name
@@ -201,10 +752,50 @@ Status decode_secret_file_extention(DecodeInfo *decInfo)
 Status decode_secret_file_size(DecodeInfo *decInfo)
 {
     printf("INFO: Decoding %s File Size.\n", decInfo->out_fname);
-    char buffer[32];
-    fread(buffer, 32, 1, decInfo->fptr_stego); // Read 32 bits from the stego file
-    decInfo->secret_size = decode_lsb_to_size(buffer); // Decode size
+    if (decInfo->flags & FLAG_FEC)
+    {
+        // Four protected bytes, most significant first
+        char byte;
+        decInfo->secret_size = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            if (decode_protected_byte(decInfo, &byte) == e_failure)
+            {
+                return e_failure;
+            }
+            decInfo->secret_size = (decInfo->secret_size << 8) | (unsigned char)byte;
+        }
+    }
+    // Decode size from the next 32 samples
+    else if (decode_int_from_image(&decInfo->carrier, decInfo->fptr_stego, &decInfo->secret_size) == e_failure)
+    {
+        return e_failure;
+    }
     printf("INFO: File size: %u bytes.\n", decInfo->secret_size);
+
+    // A damaged size must not send us reading past the carrier
+    long header = strlen(MAGIC_STRING) + 4;
+    long payload;
+    if (decInfo->flags & FLAG_FEC)
+    {
+        header += FEC_COPIES * (1 + decInfo->secret_extn_length + 4);
+        payload = fec_encoded_size(decInfo->secret_size);
+    }
+    else
+    {
+        header += decInfo->secret_extn_length + 4;
+        payload = decInfo->secret_size;
+    }
+    if (FLAG_CHANNELS(decInfo->flags))
+    {
+        // The carrier starts after the magic string and field
+        header -= strlen(MAGIC_STRING) + 4;
+    }
+    if ((header + payload) * 8 > decInfo->carrier.capacity)
+    {
+        printf("INFO: Size does not fit in the carrier, the header is damaged.\n");
+        return e_failure;
+    }
     return e_success;
 }
 
@@ -213,19 +804,167 @@ Status decode_secret_file_data(DecodeInfo *decInfo)
 {
     printf("INFO: Decoding %s File Data.\n", decInfo->out_fname);
     rewind(decInfo->fptr_output); // Reset output file pointer
-    char buffer[8], ch;
+    char ch;
 
     // Decode each byte of the secret data
     for (int i = 0; i < decInfo->secret_size; i++)
     {
-        fread(buffer, 8, 1, decInfo->fptr_stego);
-        ch = decode_lsb_to_byte(buffer);
+        if (decode_byte_from_image(&decInfo->carrier, decInfo->fptr_stego, &ch) == e_failure)
+        {
+            return e_failure; // Stego image is truncated
+        }
         fwrite(&ch, 1, 1, decInfo->fptr_output);
     }
     printf("INFO: Done decoding secret data.\n");
     return e_success;
 }
 
+/* Function to decode Reed-Solomon protected secret data */
+Status decode_secret_file_data_fec(DecodeInfo *decInfo)
+{
+    static __thread unsigned char data[FEC_GROUP_DATA], coded[FEC_GROUP_BLOCK];
+    uint left = decInfo->secret_size;
+    long corrected = 0;
+
+    printf("INFO: Decoding %s File Data with error correction.\n", decInfo->out_fname);
+    fec_init();
+    rewind(decInfo->fptr_output); // Reset output file pointer
+
+    // One interleaved group at a time
+    while (left > 0)
+    {
+        uint len = (left < FEC_GROUP_DATA) ? left : FEC_GROUP_DATA;
+        uint coded_len = fec_encoded_size(len);
+        for (uint i = 0; i < coded_len; i++)
+        {
+            if (decode_byte_from_image(&decInfo->carrier, decInfo->fptr_stego, (char *)&coded[i]) == e_failure)
+            {
+                return e_failure; // Stego image is truncated
+            }
+        }
+        int fixed = fec_decode_group(coded, len, data);
+        if (fixed < 0)
+        {
+            printf("INFO: Too many damaged bytes near offset %u.\n", decInfo->secret_size - left);
+            return e_failure;
+        }
+        corrected += fixed;
+        fwrite(data, 1, len, decInfo->fptr_output);
+        left -= len;
+    }
+    printf("INFO: Done decoding secret data, %ld damaged bytes repaired.\n", corrected);
+    return e_success;
+}
+
+/* Function to decode a majority voted header byte */
+Status decode_protected_byte(DecodeInfo *decInfo, char *data)
+{
+    char copies[FEC_COPIES];
+    for (int i = 0; i < FEC_COPIES; i++)
+    {
+        if (decode_byte_from_image(&decInfo->carrier, decInfo->fptr_stego, &copies[i]) == e_failure)
+        {
+            return e_failure;
+        }
+    }
+    *data = fec_majority(copies[0], copies[1], copies[2]);
+    return e_success;
+}
+
+/* Function to parse an "offset:length" range argument */
+Status parse_decode_range(const char *arg, DecodeInfo *decInfo)
+{
+    char *end;
+
+    // Offset, optionally negative to count from the end
+    decInfo->range_offset = strtol(arg, &end, 10);
+    if (end == arg || *end != ':')
+    {
+        return e_failure;
+    }
+
+    // Length, empty to extend up to the end
+    arg = end + 1;
+    if (*arg == '\0')
+    {
+        decInfo->range_length = -1;
+    }
+    else
+    {
+        decInfo->range_length = strtol(arg, &end, 10);
+        if (*end != '\0' || decInfo->range_length < 0)
+        {
+            return e_failure;
+        }
+    }
+
+    decInfo->range_flag = 1;
+    return e_success;
+}
+
+/* Function to compute the carrier sample of a secret byte */
+long secret_data_sample(DecodeInfo *decInfo, uint index)
+{
+    // Magic string, extension size, extension and file size come first
+    long header = strlen(MAGIC_STRING) + 4 + decInfo->secret_extn_length + 4;
+    if (FLAG_CHANNELS(decInfo->flags))
+    {
+        // The selected channels start after the magic string and field
+        header -= strlen(MAGIC_STRING) + 4;
+    }
+
+    // Every byte takes 8 samples
+    return (header + index) * 8;
+}
+
+/* Function to decode a byte range of the secret file */
+Status decode_secret_range(DecodeInfo *decInfo, uint offset, uint length)
+{
+    printf("INFO: Decoding bytes %u to %u of %s.\n", offset, offset + length, decInfo->out_fname);
+
+    // Seek straight to the first sample of the window
+    if (carrier_seek(&decInfo->carrier, decInfo->fptr_stego, secret_data_sample(decInfo, offset)) == e_failure)
+    {
+        return e_failure;
+    }
+
+    char ch;
+    for (uint i = 0; i < length; i++)
+    {
+        if (decode_byte_from_image(&decInfo->carrier, decInfo->fptr_stego, &ch) == e_failure)
+        {
+            return e_failure; // Stego image is truncated
+        }
+        fwrite(&ch, 1, 1, decInfo->fptr_output);
+    }
+    printf("INFO: Done decoding secret range.\n");
+    return e_success;
+}
+
+/* Function to decode a byte from the next 8 carrier samples */
+Status decode_byte_from_image(CarrierInfo *carrier, FILE *fptr, char *data)
+{
+    CarrierWindow window;
+    if (carrier_read_window(carrier, fptr, &window, 8) == e_failure)
+    {
+        return e_failure;
+    }
+    *data = decode_lsb_to_byte(window.samples);
+    return e_success;
+}
+
+/* Function to decode a 32-bit value from the next 32 carrier samples */
+Status decode_int_from_image(CarrierInfo *carrier, FILE *fptr, uint *data)
+{
+    CarrierWindow window;
+    if (carrier_read_window(carrier, fptr, &window, 32) == e_failure)
+    {
+        return e_failure;
+    }
+    *data = decode_lsb_to_size(window.samples);
+    return e_success;
+}
+
 /* Function to decode a byte from LSBs */
 char decode_lsb_to_byte(char *image_buffer)
 {
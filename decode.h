@@ -2,12 +2,16 @@
 #define DECODE_H
 
 #include "types.h" // Contains user-defined types like Status
+#include "carrier.h" // Carrier formats
+#include "cache.h" // Result cache
 
 /*
  * This header file defines the structures and function prototypes
  * required for decoding secret information from a stego image file.
  */
 
+#define MAX_OUT_FNAME 256              // Maximum length of the output file name
+
 /* 
  * Structure: DecodeInfo
  * Purpose: To store all necessary information for decoding data from
@@ -18,17 +22,38 @@ typedef struct DecodeInfo
     /* Stego image file information */
     char *stego_fname;          // Pointer to the name of the stego image file (input file)
     FILE *fptr_stego;           // File pointer for the stego image file
+    CarrierInfo carrier;        // Layout of the stego carrier
+    int video_flag;             // Stego file is a Y4M video, decoded frame by frame
+    uint threads;               // Worker threads for video files (0 = one per CPU)
 
     /* Output file information */
-    char out_fname[20];         // Name of the output file where decoded data will be saved
+    char out_fname[MAX_OUT_FNAME];  // Name of the output file where decoded data will be saved
     int out_flag;               // Flag to indicate whether the user provided an output file name (1 = default used)
 
     FILE *fptr_output;          // File pointer for the output file
+    char part_fname[MAX_OUT_FNAME + 8]; // Name the output is written under until it is complete
 
     /* Secret file information */
     uint secret_extn_length;    // Length of the secret file's extension (e.g., ".txt")
     char secret_extn[10];       // Buffer to store the secret file extension
     uint secret_size;           // Size of the secret file in bytes
+    uint flags;                 // Option flags (FLAG_*) found in the header
+
+    /* Magic string given on the command line (NULL = prompt for it) */
+    char *magic_string;
+    int auto_flag;              // Probe the layout and magic string instead of asking
+
+    /* Archive information */
+    char *extract_name;         // File to extract from an archive (NULL = plain secret)
+
+    /* Byte range information */
+    int range_flag;             // Flag to indicate that only a byte range is decoded
+    long range_offset;          // First byte of the range (negative = counted from the end)
+    long range_length;          // Number of bytes in the range (-1 = up to the end)
+
+    /* Result cache */
+    ResultCache cache;          // Earlier outputs of the same carrier and options (dir NULL = none)
+    uint cache_base_len;        // Length of out_fname before the decoded suffix was added
 
 } DecodeInfo; // End of DecodeInfo structure definition
 
@@ -38,6 +63,8 @@ typedef struct DecodeInfo
 #define MAX_SECRET_BUF_SIZE 1          // Maximum buffer size for storing secret data (1 byte)
 #define MAX_IMAGE_BUF_SIZE (MAX_SECRET_BUF_SIZE * 8) // Buffer size for storing 8 bits per byte for LSB decoding
 #define MAX_FILE_SUFFIX 10             // Maximum length for file extensions
+#define LEGACY_DATA_OFFSET 54          // Pixel offset the first builds assumed for every carrier
+#define MAX_PROBE_LAYOUTS 3            // Sample layouts tried by --auto
 
 /* 
  * Function Prototypes:
@@ -55,6 +82,56 @@ typedef struct DecodeInfo
  */
 Status read_and_validate_decode_args(char *argv[], DecodeInfo *decInfo);
 
+/*
+ * Function: probe_decode_layout
+ * Purpose: Finds the sample layout and magic string of a stego file by
+ *          trying every candidate layout with every known magic string
+ *          against the first header bytes, stopping at the first one whose
+ *          magic string, three flag copies and extension all check out.
+ * Inputs:
+ *  - decInfo: Pointer to DecodeInfo structure with the stego file open;
+ *             its carrier is replaced by the layout found.
+ *  - magic_string: Buffer of 10 bytes receiving the magic string found.
+ * Outputs:
+ *  - Returns e_success if a layout was found, otherwise e_failure.
+ */
+Status probe_decode_layout(DecodeInfo *decInfo, char *magic_string);
+
+/*
+ * Function: get_magic_string
+ * Purpose: Takes the magic string from --magic, or prompts the user for it.
+ * Inputs:
+ *  - decInfo: Pointer to DecodeInfo structure.
+ *  - magic_string: Buffer of 10 bytes receiving the string.
+ * Outputs:
+ *  - Returns e_success if a string was given, otherwise e_failure.
+ */
+Status get_magic_string(DecodeInfo *decInfo, char *magic_string);
+
+/*
+ * Function: parse_payload_header
+ * Purpose: Parses the magic string, extension and size from payload bytes
+ *          that were already extracted, the inverse of serialize_payload_header.
+ * Inputs:
+ *  - magic_string: Magic string expected.
+ *  - buf, len: Payload bytes from the start of the payload.
+ *  - decInfo: Receives the flags, extension and secret size.
+ * Outputs:
+ *  - Returns the header length, 0 when more bytes are needed, or -1 when
+ *    the magic string does not match or the header is damaged.
+ */
+int parse_payload_header(const char *magic_string, const unsigned char *buf, uint len, DecodeInfo *decInfo);
+
+/*
+ * Function: decode_from_cache
+ * Purpose: Copies an earlier output of the same carrier and options, if the cache has one.
+ * Inputs:
+ *  - decInfo: Pointer to DecodeInfo structure with a cache directory.
+ * Outputs:
+ *  - Returns e_success on a cache hit, otherwise e_failure.
+ */
+Status decode_from_cache(DecodeInfo *decInfo);
+
 /* 
  * Function: do_decoding
  * Purpose: Manages the entire decoding process.
@@ -65,6 +142,25 @@ Status read_and_validate_decode_args(char *argv[], DecodeInfo *decInfo);
  */
 Status do_decoding(DecodeInfo *decInfo);
 
+/*
+ * Function: finish_output_file
+ * Purpose: Closes the output and renames it from its temporary name to out_fname.
+ * Inputs:
+ *  - decInfo: Pointer to DecodeInfo structure with an open output file.
+ * Outputs:
+ *  - Returns e_success if the output is in place, otherwise e_failure.
+ */
+Status finish_output_file(DecodeInfo *decInfo);
+
+/* 
+ * Function: close_decode_files
+ * Purpose: Closes the stego and output files if they are still open. An
+ *          output that was not finished is removed.
+ * Inputs:
+ *  - decInfo: Pointer to DecodeInfo structure holding the file pointers.
+ */
+void close_decode_files(DecodeInfo *decInfo);
+
 /* 
  * Function: open_stego_file
  * Purpose: Opens the stego image file for reading.
@@ -87,13 +183,14 @@ Status open_output_file(DecodeInfo *decInfo);
 
 /* 
  * Function: skip_header
- * Purpose: Skips the header data in the BMP file to reach encoded data.
+ * Purpose: Skips the carrier header to reach encoded data.
  * Inputs:
  *  - fptr: File pointer to the stego image file.
+ *  - carrier: Layout of the stego carrier.
  * Outputs:
  *  - Returns e_success if the header is successfully skipped.
  */
-Status skip_header(FILE *fptr);
+Status skip_header(FILE *fptr, CarrierInfo *carrier);
 
 /* 
  * Function: decode_magic_string
@@ -146,6 +243,87 @@ Status decode_secret_file_size(DecodeInfo *decInfo);
  */
 Status decode_secret_file_data(DecodeInfo *decInfo);
 
+/* 
+ * Function: decode_secret_file_data_fec
+ * Purpose: Decodes Reed-Solomon protected secret data, repairing flipped bits.
+ * Inputs:
+ *  - decInfo: Pointer to DecodeInfo structure to manage file pointers.
+ * Outputs:
+ *  - Returns e_success if every group could be decoded, otherwise e_failure.
+ */
+Status decode_secret_file_data_fec(DecodeInfo *decInfo);
+
+/* 
+ * Function: decode_protected_byte
+ * Purpose: Decodes the FEC_COPIES copies of a header byte and takes their majority.
+ * Inputs:
+ *  - decInfo: Pointer to DecodeInfo structure to manage file pointers.
+ *  - data: Receives the voted byte.
+ * Outputs:
+ *  - Returns e_success, or e_failure if the carrier is truncated.
+ */
+Status decode_protected_byte(DecodeInfo *decInfo, char *data);
+
+/* 
+ * Function: parse_decode_range
+ * Purpose: Parses an "offset:length" range argument.
+ * Inputs:
+ *  - arg: Range text. A negative offset counts from the end of the secret,
+ *         an empty length extends the range up to the end.
+ *  - decInfo: Pointer to DecodeInfo structure to store the range.
+ * Outputs:
+ *  - Returns e_success if the range is well formed, otherwise e_failure.
+ */
+Status parse_decode_range(const char *arg, DecodeInfo *decInfo);
+
+/* 
+ * Function: secret_data_sample
+ * Purpose: Computes the carrier sample holding a given secret byte.
+ * Inputs:
+ *  - decInfo: Pointer to DecodeInfo structure with the decoded extension length.
+ *  - index: Index of the secret byte.
+ * Outputs:
+ *  - Returns the index of the first of its 8 carrier samples.
+ */
+long secret_data_sample(DecodeInfo *decInfo, uint index);
+
+/* 
+ * Function: decode_secret_range
+ * Purpose: Seeks straight to a byte range of the secret and decodes only that window.
+ *          The header (extension and size) must have been decoded already.
+ * Inputs:
+ *  - decInfo: Pointer to DecodeInfo structure to manage file pointers.
+ *  - offset: Index of the first secret byte to decode.
+ *  - length: Number of bytes to decode.
+ * Outputs:
+ *  - Returns e_success if the range is decoded, otherwise e_failure.
+ */
+Status decode_secret_range(DecodeInfo *decInfo, uint offset, uint length);
+
+/* 
+ * Function: decode_byte_from_image
+ * Purpose: Reads the next 8 carrier samples and decodes one byte from them.
+ * Inputs:
+ *  - carrier: Layout of the stego carrier.
+ *  - fptr: File pointer to the stego image file.
+ *  - data: Receives the decoded byte.
+ * Outputs:
+ *  - Returns e_success, or e_failure if the carrier is truncated.
+ */
+Status decode_byte_from_image(CarrierInfo *carrier, FILE *fptr, char *data);
+
+/* 
+ * Function: decode_int_from_image
+ * Purpose: Reads the next 32 carrier samples and decodes a 32-bit value from them.
+ * Inputs:
+ *  - carrier: Layout of the stego carrier.
+ *  - fptr: File pointer to the stego image file.
+ *  - data: Receives the decoded value.
+ * Outputs:
+ *  - Returns e_success, or e_failure if the carrier is truncated.
+ */
+Status decode_int_from_image(CarrierInfo *carrier, FILE *fptr, uint *data);
+
 /* 
  * Function: decode_lsb_to_byte
  * Purpose: Decodes a single byte of data using LSB (Least Significant Bit) method.
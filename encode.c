@@ -1,25 +1,15 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "encode.h"
 #include "types.h"
 #include "common.h"
-
-// Function to calculate the size of the image for a BMP file
-uint get_image_size_for_bmp(FILE *fptr_image)
-{
-    uint width, height;
-    // Seek to the 18th byte, which contains the width of the image
-    fseek(fptr_image, 18, SEEK_SET);
-
-    // Read the width (an int)
-    fread(&width, sizeof(int), 1, fptr_image);
-
-    // Read the height (an int)
-    fread(&height, sizeof(int), 1, fptr_image);
-
-    // Return image capacity (width * height * 3 for RGB)
-    return width * height * 3;
-}
+#include "fec.h"
+#include "synth.h"
+#include "plane.h"
+#include "y4m.h"
 
 // Function to get the size of a file
 uint get_file_size(FILE *fptr)
@@ -35,8 +25,15 @@ Status open_files(EncodeInfo *encInfo)
 {
     printf("INFO: Opening required files.\n");
     
-    // Open the source image file
-    encInfo->fptr_src_image = fopen(encInfo->src_image_fname, "r");
+    // Open the source image file, or generate it
+    if (encInfo->synthetic_flag)
+    {
+        encInfo->fptr_src_image = synthetic_cover_open(&encInfo->synthetic);
+    }
+    else
+    {
+        encInfo->fptr_src_image = fopen(encInfo->src_image_fname, "r");
+    }
     // Error handling for source image file
     if (encInfo->fptr_src_image == NULL)
     {
@@ -55,70 +52,241 @@ Status open_files(EncodeInfo *encInfo)
         return e_failure;
     }
 
-    // Open the stego image file for writing
-    encInfo->fptr_stego_image = fopen(encInfo->stego_image_fname, "w");
+    // Print confirmation messages
+    printf("INFO: Opened %s\n", encInfo->src_image_fname);
+    printf("INFO: Opened %s\n", encInfo->secret_fname);
+    printf("INFO: Done\n");
+    
+    // No failure return e_success
+    return e_success;
+}
+
+// Function to open the part file once the options are final, resuming it when asked to
+Status open_part_file(EncodeInfo *encInfo)
+{
+    // Identify the inputs and final flags (channel mask included), so a journal can only be resumed against them
+    struct stat src_st, secret_st;
+    fstat(fileno(encInfo->fptr_secret), &secret_st);
+    memset(&encInfo->journal, 0, sizeof(EncodeJournal));
+    if (encInfo->synthetic_flag)
+    {
+        // A generated cover is identified by its size and seed
+        encInfo->journal.src_size = encInfo->synthetic.size;
+        encInfo->journal.src_mtime = encInfo->synthetic.seed;
+    }
+    else
+    {
+        fstat(fileno(encInfo->fptr_src_image), &src_st);
+        encInfo->journal.src_size = src_st.st_size;
+        encInfo->journal.src_mtime = src_st.st_mtime;
+    }
+    encInfo->journal.secret_size = secret_st.st_size;
+    encInfo->journal.secret_mtime = secret_st.st_mtime;
+    encInfo->journal.flags = encInfo->flags;
+
+    // Pick up the part file of an interrupted run, otherwise start a new one
+    if (encInfo->resume_flag == 0 || open_resume_point(encInfo) == e_failure)
+    {
+        unlink(encInfo->journal_fname);
+        encInfo->fptr_stego_image = fopen(encInfo->part_fname, "w");
+    }
     // Error handling for stego image file
     if (encInfo->fptr_stego_image == NULL)
     {
         perror("fopen");
-        fprintf(stderr, "ERROR: can't open file %s\n", encInfo->stego_image_fname);
+        fprintf(stderr, "ERROR: can't open file %s\n", encInfo->part_fname);
         return e_failure;
     }
-    
-    // Print confirmation messages
-    printf("INFO: Opened beautiful.bmp\n");
-    printf("INFO: Opened secret.txt\n");
-    printf("INFO: Opened %s\n", encInfo->stego_image_fname);
-    printf("INFO: Done\n");
-    
-    // No failure return e_success
+    printf("INFO: Opened %s\n", encInfo->part_fname);
+    return e_success;
+}
+
+// Function to reopen the part file of an interrupted encode at its last checkpoint
+Status open_resume_point(EncodeInfo *encInfo)
+{
+    EncodeJournal saved;
+
+    if (journal_read(encInfo->journal_fname, &saved) == e_failure)
+    {
+        printf("INFO: No journal found. Starting from the beginning.\n");
+        return e_failure;
+    }
+
+    // The journal only applies to the same inputs and options
+    if (saved.src_size != encInfo->journal.src_size || saved.src_mtime != encInfo->journal.src_mtime ||
+        saved.secret_size != encInfo->journal.secret_size || saved.secret_mtime != encInfo->journal.secret_mtime ||
+        saved.flags != encInfo->journal.flags || saved.out_offset <= 0 || saved.out_offset > saved.src_size)
+    {
+        printf("INFO: Journal does not match the inputs. Starting from the beginning.\n");
+        return e_failure;
+    }
+
+    // Everything up to the checkpoint must still be there
+    struct stat part_st;
+    if (stat(encInfo->part_fname, &part_st) || part_st.st_size < saved.out_offset)
+    {
+        printf("INFO: %s is shorter than the journal. Starting from the beginning.\n", encInfo->part_fname);
+        return e_failure;
+    }
+
+    // Drop whatever was written after the checkpoint
+    encInfo->fptr_stego_image = fopen(encInfo->part_fname, "r+");
+    if (encInfo->fptr_stego_image == NULL || ftruncate(fileno(encInfo->fptr_stego_image), saved.out_offset))
+    {
+        perror("ftruncate");
+        return e_failure;
+    }
+    encInfo->journal = saved;
+    printf("INFO: Resuming at byte %ld of %s.\n", saved.out_offset, encInfo->part_fname);
     return e_success;
 }
 
+// Function to make the output durable and record the checkpoint
+Status encode_checkpoint(EncodeInfo *encInfo)
+{
+    // The output must be on disk before the journal points past it
+    if (fflush(encInfo->fptr_stego_image) || fsync(fileno(encInfo->fptr_stego_image)))
+    {
+        perror("fsync");
+        return e_failure;
+    }
+    encInfo->journal.out_offset = ftell(encInfo->fptr_stego_image);
+    encInfo->journal.secret_offset = encInfo->secret_offset;
+    encInfo->journal.phase = encInfo->carrier.phase;
+    return journal_write(encInfo->journal_fname, &encInfo->journal);
+}
+
 // Function to read and validate encoding arguments
 Status read_and_validate_encode_args(char *argv[], EncodeInfo *encInfo)
 {
-    // Temporary arrays to store file extensions
-    char bmp[10], txt[10], out[10];
-    
-    // Extract the file extension from the source BMP file (argv[2])
-    strcpy(bmp, strchr(argv[2], '.'));
-    
-    // Extract the file extension from the secret TXT file (argv[3])
-    strcpy(txt, strchr(argv[3], '.'));
-    
-    // Check if the output file name is provided (argv[4])
-    if (argv[4] == NULL)
+    // Start from a clean structure
+    memset(encInfo, 0, sizeof(EncodeInfo));
+
+    // A generated cover takes the place of the cover file
+    char *cover_arg = argv[2];
+    int first = 3;
+    if (strcmp(argv[2], "--synthetic-cover") == 0)
     {
-        // If not provided, set a default output file name
-        printf("INFO: Output file not mentioned. Creating stegno_image.bmp as default.\n");
-        encInfo->stego_image_fname = "stegno_image.bmp";
+        if (argv[3] == NULL || parse_synthetic_spec(argv[3], &encInfo->synthetic) == e_failure || argv[4] == NULL)
+        {
+            printf("INFO: Validation Error. --synthetic-cover needs WxH[:seed] and a secret file.\n");
+            return e_failure;
+        }
+        encInfo->synthetic_flag = 1;
+        snprintf(encInfo->synthetic_name, sizeof(encInfo->synthetic_name), "synthetic %ux%u:%u.bmp",
+                 encInfo->synthetic.width, encInfo->synthetic.height, encInfo->synthetic.seed);
+        cover_arg = encInfo->synthetic_name;
+        first = 4;
+    }
+    char *secret_arg = argv[first];
+
+    // Collect the optional arguments after the secret file
+    char *out_arg = NULL;
+    for (int i = first + 1; argv[i] != NULL; i++)
+    {
+        if (strcmp(argv[i], "--fec") == 0)
+        {
+            // Protect header and payload against flipped bits
+            encInfo->flags |= FLAG_FEC;
+        }
+        else if (strcmp(argv[i], "--channels") == 0 && argv[i + 1] != NULL)
+        {
+            // Only these channels carry the payload after the header field
+            encInfo->channels_arg = argv[++i];
+        }
+        else if (strcmp(argv[i], "--cache") == 0 && argv[i + 1] != NULL)
+        {
+            // Reuse outputs of earlier runs with the same inputs
+            encInfo->cache.dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--cache-size") == 0 && argv[i + 1] != NULL && atol(argv[i + 1]) > 0)
+        {
+            // Limit of the cache in MiB
+            encInfo->cache.limit = atol(argv[++i]) << 20;
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && argv[i + 1] != NULL)
+        {
+            // Worker threads of the video pipeline
+            encInfo->threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--resume") == 0)
+        {
+            // Continue an interrupted run from its journal
+            encInfo->resume_flag = 1;
+        }
+        else if (out_arg == NULL && strncmp(argv[i], "--", 2))
+        {
+            out_arg = argv[i];
+        }
+        else
+        {
+            printf("INFO: Unexpected argument %s\n", argv[i]);
+            return e_failure;
+        }
+    }
+
+    // Extract the file extensions of the source image and secret file
+    char *src = strrchr(cover_arg, '.');
+    char *txt = strrchr(secret_arg, '.');
+
+    // Verify if the source image is a supported carrier
+    encInfo->video_flag = (src != NULL && strcmp(src, Y4M_EXTN) == 0);
+    if (!encInfo->video_flag && carrier_known_extn(src) == e_failure)
+    {
+        // If not .bmp, .ppm, .pgm, .wav or .y4m, return failure
+        return e_failure;
+    }
+    if (strcmp(src, PLANE_EXTN) == 0)
+    {
+        printf("INFO: Validation Error. A bit plane holds no samples to embed into, use -p import.\n");
+        return e_failure;
+    }
+    if (encInfo->video_flag && (encInfo->synthetic_flag || encInfo->channels_arg != NULL || encInfo->resume_flag))
+    {
+        printf("INFO: Validation Error. --synthetic-cover, --channels and --resume do not apply to Y4M covers.\n");
+        return e_failure;
+    }
+
+    // Check if the output file name is provided
+    if (out_arg == NULL)
+    {
+        // If not provided, set a default output file name with the source extension
+        sprintf(encInfo->default_stego_fname, "stegno_image%s", src);
+        printf("INFO: Output file not mentioned. Creating %s as default.\n", encInfo->default_stego_fname);
+        encInfo->stego_image_fname = encInfo->default_stego_fname;
     }
     else
     {
-        // Extract the file extension from the output file (argv[4])
-        strcpy(out, strchr(argv[4], '.'));
+        // Extract the file extension from the output file
+        char *out = strrchr(out_arg, '.');
         
-        // Verify if the output file has a .bmp extension
-        if (strcmp(out, ".bmp"))
+        // Verify if the output file has the same format as the source
+        if (out == NULL || strcmp(out, src))
         {
-            // If not .bmp, return failure
+            // If not, return failure
             return e_failure;
         }
         
         // If valid, set the output file name in encInfo structure
-        encInfo->stego_image_fname = argv[4];
+        encInfo->stego_image_fname = out_arg;
+    }
+
+    if (encInfo->cache.limit == 0)
+    {
+        encInfo->cache.limit = CACHE_DEFAULT_LIMIT;
     }
 
-    // Verify if the source image file has a .bmp extension
-    if (strcmp(bmp, ".bmp"))
+    // The output is written under a temporary name next to its journal
+    if (strlen(encInfo->stego_image_fname) + strlen(JOURNAL_SUFFIX) >= MAX_STEGO_FNAME)
     {
-        // If not .bmp, return failure
+        printf("INFO: Output file name is too long.\n");
         return e_failure;
     }
+    sprintf(encInfo->part_fname, "%s%s", encInfo->stego_image_fname, PART_SUFFIX);
+    sprintf(encInfo->journal_fname, "%s%s", encInfo->stego_image_fname, JOURNAL_SUFFIX);
 
     // Verify if the secret file has a .txt extension
-    if (strcmp(txt, ".txt"))
+    if (txt == NULL || strcmp(txt, ".txt"))
     {
         // If not .txt, return failure
         return e_failure;
@@ -128,8 +296,8 @@ Status read_and_validate_encode_args(char *argv[], EncodeInfo *encInfo)
     strcpy(encInfo->extn_secret_file, txt);
     
     // Store the source image file name and secret file name in encInfo
-    encInfo->src_image_fname = argv[2];
-    encInfo->secret_fname = argv[3];
+    encInfo->src_image_fname = cover_arg;
+    encInfo->secret_fname = secret_arg;
     
     // If all validations pass, return success
     return e_success;
@@ -138,7 +306,29 @@ Status read_and_validate_encode_args(char *argv[], EncodeInfo *encInfo)
 // Function to perform the encoding process
 Status do_encoding(EncodeInfo *encInfo)
 {
-    // Open source image and output stego image files
+    // Video covers stream frame by frame through their own pipeline
+    if (encInfo->video_flag)
+    {
+        // The same inputs and options were encoded before
+        if (encInfo->cache.dir != NULL && encode_from_cache(encInfo) == e_success)
+        {
+            printf("INFO: ## Encoding Done successfully. ##\n");
+            return e_success;
+        }
+        if (do_y4m_encoding(encInfo) == e_failure)
+        {
+            discard_part_file(encInfo);
+            return e_failure;
+        }
+        if (encInfo->cache.dir != NULL)
+        {
+            cache_store(&encInfo->cache, encInfo->stego_image_fname, "");
+        }
+        printf("INFO: ## Encoding Done successfully. ##\n");
+        return e_success;
+    }
+
+    // Open the source image and secret files
     if (open_files(encInfo) == e_failure)
     {
         printf("INFO: Files are not opened.\n");
@@ -154,8 +344,130 @@ Status do_encoding(EncodeInfo *encInfo)
         return e_failure;
     }
 
-    // Copy the BMP header from source image to the stego image
-    if (copy_bmp_header(encInfo->fptr_src_image, encInfo->fptr_stego_image) == e_failure)
+    // The same inputs and options were encoded before; only now is the channel mask in the flags
+    if (encInfo->cache.dir != NULL && encode_from_cache(encInfo) == e_success)
+    {
+        close_encode_files(encInfo);
+        printf("INFO: ## Encoding Done successfully. ##\n");
+        return e_success;
+    }
+
+    // The flags are final now, open or resume the output
+    if (open_part_file(encInfo) == e_failure)
+    {
+        printf("INFO: Files are not opened.\n");
+        return e_failure;
+    }
+
+    // A failed encode leaves nothing behind; only an interrupted one keeps its part file
+    if (encode_to_part_file(encInfo) == e_failure)
+    {
+        discard_part_file(encInfo);
+        return e_failure;
+    }
+    close_encode_files(encInfo);
+    if (rename(encInfo->part_fname, encInfo->stego_image_fname))
+    {
+        perror("rename");
+        discard_part_file(encInfo);
+        return e_failure;
+    }
+    unlink(encInfo->journal_fname);
+    printf("INFO: Wrote %s\n", encInfo->stego_image_fname);
+    if (encInfo->cache.dir != NULL)
+    {
+        cache_store(&encInfo->cache, encInfo->stego_image_fname, "");
+    }
+
+    printf("INFO: ## Encoding Done successfully. ##\n");
+
+    return e_success;
+}
+
+// Function to embed the payload and copy the rest of the cover into the open part file
+Status encode_to_part_file(EncodeInfo *encInfo)
+{
+    if (encInfo->journal.out_offset > 0)
+    {
+        // Both files advance together, so the cover resumes at the same offset
+        fseek(encInfo->fptr_src_image, encInfo->journal.out_offset, SEEK_SET);
+        fseek(encInfo->fptr_stego_image, encInfo->journal.out_offset, SEEK_SET);
+        if (FLAG_CHANNELS(encInfo->flags))
+        {
+            carrier_select_channels(&encInfo->carrier, FLAG_CHANNELS(encInfo->flags), HEADER_FIELD_SAMPLES);
+        }
+        carrier_sync_position(&encInfo->carrier, encInfo->journal.out_offset);
+        encInfo->secret_offset = encInfo->journal.secret_offset;
+        printf("INFO: Skipping the header, %ld of %ld secret bytes already encoded.\n", encInfo->secret_offset, encInfo->size_secret_file);
+    }
+    else if (encode_payload_header(encInfo) == e_failure)
+    {
+        return e_failure;
+    }
+
+    // Encode the actual data of the secret file into the stego image
+    if (((encInfo->flags & FLAG_FEC) ? encode_secret_file_data_fec(encInfo) : encode_secret_file_data(encInfo)) == e_failure)
+    {
+        printf("INFO: Error encoding secret data.\n");
+        return e_failure;
+    }
+
+    // Copy any remaining image data from the source image to the stego image
+    if (encode_remaining_img_data(encInfo) == e_failure)
+    {
+        printf("INFO: Error copying the remaining data to output image.\n");
+        return e_failure;
+    }
+
+    // Make the output durable before it is published under its real name
+    if (fflush(encInfo->fptr_stego_image) || fsync(fileno(encInfo->fptr_stego_image)))
+    {
+        perror("fsync");
+        return e_failure;
+    }
+    return e_success;
+}
+
+// Function to remove the part file and journal of a failed encode
+void discard_part_file(EncodeInfo *encInfo)
+{
+    close_encode_files(encInfo);
+    unlink(encInfo->part_fname);
+    unlink(encInfo->journal_fname);
+}
+
+// Function to key the encode and copy a cached output
+Status encode_from_cache(EncodeInfo *encInfo)
+{
+    char flags[16];
+
+    // Everything that changes the output bytes is part of the key
+    cache_key_begin(&encInfo->cache, "encode");
+    if (encInfo->synthetic_flag)
+    {
+        cache_key_string(&encInfo->cache, encInfo->synthetic_name);
+    }
+    else if (cache_key_file(&encInfo->cache, encInfo->src_image_fname) == e_failure)
+    {
+        return e_failure;
+    }
+    if (cache_key_file(&encInfo->cache, encInfo->secret_fname) == e_failure)
+    {
+        return e_failure;
+    }
+    // The flags hold the resolved channel mask, so BG, GB and bg share one key
+    snprintf(flags, sizeof(flags), "%u", encInfo->flags);
+    cache_key_string(&encInfo->cache, encInfo->extn_secret_file);
+    cache_key_string(&encInfo->cache, flags);
+    return cache_fetch(&encInfo->cache, encInfo->stego_image_fname);
+}
+
+// Function to encode everything in front of the secret data
+Status encode_payload_header(EncodeInfo *encInfo)
+{
+    // Copy the carrier header from source image to the stego image
+    printf("INFO: Copying Image Header.\n");
+    if (carrier_copy_header(&encInfo->carrier, encInfo->fptr_src_image, encInfo->fptr_stego_image) == e_failure)
     {
         printf("INFO: Header not copied.\n");
         return e_failure;
@@ -175,6 +487,13 @@ Status do_encoding(EncodeInfo *encInfo)
         return e_failure;
     }
 
+    // Everything after the field goes to the selected channels only
+    if (FLAG_CHANNELS(encInfo->flags) && encode_select_channels(encInfo) == e_failure)
+    {
+        printf("INFO: Error selecting channels.\n");
+        return e_failure;
+    }
+
     // Encode the secret file's extension to ensure correct file type during decoding
     if (encode_secret_file_extn(encInfo->extn_secret_file, encInfo) == e_failure)
     {
@@ -188,24 +507,125 @@ Status do_encoding(EncodeInfo *encInfo)
         printf("INFO: Error encoding secret file size.\n");
         return e_failure;
     }
+    return e_success;
+}
 
-    // Encode the actual data of the secret file into the stego image
-    if (encode_secret_file_data(encInfo) == e_failure)
+// Function to close the files that are still open
+void close_encode_files(EncodeInfo *encInfo)
+{
+    if (encInfo->fptr_src_image != NULL)
     {
-        printf("INFO: Error encoding secret data.\n");
-        return e_failure;
+        fclose(encInfo->fptr_src_image);
+        encInfo->fptr_src_image = NULL;
     }
+    if (encInfo->fptr_secret != NULL)
+    {
+        fclose(encInfo->fptr_secret);
+        encInfo->fptr_secret = NULL;
+    }
+    if (encInfo->fptr_stego_image != NULL)
+    {
+        fclose(encInfo->fptr_stego_image);
+        encInfo->fptr_stego_image = NULL;
+    }
+}
 
-    // Copy any remaining image data from the source image to the stego image
-    if (copy_remaining_img_data(encInfo->fptr_src_image, encInfo->fptr_stego_image) == e_failure)
+// Function to serialize the payload header into bytes
+uint serialize_payload_header(EncodeInfo *encInfo, unsigned char *out)
+{
+    uint len = 0;
+    uint extn_length = strlen(encInfo->extn_secret_file);
+    uint field = EXTN_FIELD(encInfo->flags, extn_length);
+    uint size = encInfo->size_secret_file;
+
+    // Magic string and extension size field, most significant byte first
+    for (int i = 0; MAGIC_STRING[i] != '\0'; i++)
     {
-        printf("INFO: Error copying the remaining data to output image.\n");
-        return e_failure;
+        out[len++] = MAGIC_STRING[i];
+    }
+    for (int i = 3; i >= 0; i--)
+    {
+        out[len++] = field >> (8 * i);
     }
 
-    printf("INFO: ## Encoding Done successfully. ##\n");
+    // Extension and size, every byte FEC_COPIES times when protected
+    unsigned char fields[1 + MAX_FILE_SUFFIX + 4];
+    uint count = 0;
+    if (encInfo->flags & FLAG_FEC)
+    {
+        fields[count++] = extn_length;
+    }
+    memcpy(fields + count, encInfo->extn_secret_file, extn_length);
+    count += extn_length;
+    for (int i = 3; i >= 0; i--)
+    {
+        fields[count++] = size >> (8 * i);
+    }
+    uint copies = (encInfo->flags & FLAG_FEC) ? FEC_COPIES : 1;
+    for (uint i = 0; i < count; i++)
+    {
+        for (uint c = 0; c < copies; c++)
+        {
+            out[len++] = fields[i];
+        }
+    }
+    return len;
+}
 
-    return e_success;
+// Function to start the payload stream of an encode
+void payload_stream_init(EncodeInfo *encInfo, PayloadStream *stream)
+{
+    memset(stream, 0, sizeof(PayloadStream));
+    stream->payload_len = encoded_payload_size(encInfo);
+    stream->header_len = serialize_payload_header(encInfo, stream->header);
+}
+
+// Function to produce the next payload bytes; returns the number produced
+uint payload_stream_read(EncodeInfo *encInfo, PayloadStream *stream, unsigned char *dst, uint n)
+{
+    unsigned char data[FEC_GROUP_DATA];
+    uint done = 0;
+
+    while (done < n && stream->payload_done < stream->payload_len)
+    {
+        uint k;
+        if (stream->payload_done < stream->header_len)
+        {
+            // Magic string, extension and size first
+            k = stream->header_len - stream->payload_done;
+            k = (k < n - done) ? k : n - done;
+            memcpy(dst + done, stream->header + stream->payload_done, k);
+        }
+        else if (encInfo->flags & FLAG_FEC)
+        {
+            // One interleaved group at a time, like encode_secret_file_data_fec
+            if (stream->coded_pos == stream->coded_len)
+            {
+                size_t len = fread(data, 1, FEC_GROUP_DATA, encInfo->fptr_secret);
+                if (len == 0)
+                {
+                    break;
+                }
+                stream->coded_len = fec_encode_group(data, len, stream->coded);
+                stream->coded_pos = 0;
+            }
+            k = stream->coded_len - stream->coded_pos;
+            k = (k < n - done) ? k : n - done;
+            memcpy(dst + done, stream->coded + stream->coded_pos, k);
+            stream->coded_pos += k;
+        }
+        else
+        {
+            k = fread(dst + done, 1, n - done, encInfo->fptr_secret);
+            if (k == 0)
+            {
+                break;
+            }
+        }
+        done += k;
+        stream->payload_done += k;
+    }
+    return done;
 }
 
 // Function to check if the source image has enough capacity to store the secret data
@@ -221,13 +641,19 @@ Status check_capacity(EncodeInfo *encInfo)
     
     // Get Image size
     printf("INFO: Checking for %s capacity to handle %s\n", encInfo->src_image_fname, encInfo->secret_fname);
-    encInfo->image_capacity = get_image_size_for_bmp(encInfo->fptr_src_image);
-    
-    // Get Magic string length
-    uint magic_string_length = strlen(MAGIC_STRING);
+    if (carrier_open(encInfo->fptr_src_image, &encInfo->carrier) == e_failure)
+    {
+        return e_failure;
+    }
+    printf("INFO: Carrier is %s with %u payload bytes\n", encInfo->carrier.backend->name, encInfo->carrier.capacity);
+    encInfo->image_capacity = encInfo->carrier.capacity;
+    if (encInfo->channels_arg != NULL)
+    {
+        return check_channel_capacity(encInfo);
+    }
     
-    // Calculate Required file size
-    uint req_size = 54 + ((magic_string_length + 4 + strlen(encInfo->extn_secret_file) + 4 + encInfo->size_secret_file) * 8);
+    // Calculate Required number of payload carrying bytes
+    long req_size = encoded_payload_size(encInfo) * 8;
     
     // Check if the image capacity is sufficient
     if (encInfo->image_capacity < req_size)
@@ -241,21 +667,80 @@ Status check_capacity(EncodeInfo *encInfo)
     }
 }
 
-// Function to copy the BMP header from the source image to the stego image
-Status copy_bmp_header(FILE *fptr_src_image, FILE *fptr_stego_image)
+// Function to resolve the channel mask and check the capacity of those channels
+Status check_channel_capacity(EncodeInfo *encInfo)
 {
-    printf("INFO: Copying Image Header.\n");
-    rewind(fptr_src_image);
-
-    char temp[54];
-    // Read the BMP header (first 54 bytes)
-    fread(temp, 54, 1, fptr_src_image);
-    // Write the BMP header to the stego image
-    fwrite(temp, 54, 1, fptr_stego_image);
-    printf("INFO : Done\n");
+    uint mask;
+    CarrierInfo selected = encInfo->carrier;
+
+    if (encInfo->carrier.channels < 2)
+    {
+        printf("INFO: %s has a single channel, --channels cannot be used.\n", encInfo->src_image_fname);
+        return e_failure;
+    }
+    if (carrier_channel_mask(&encInfo->carrier, encInfo->channels_arg, &mask) == e_failure || (mask << FLAG_CHANNEL_SHIFT) & ~FLAG_CHANNEL_MASK)
+    {
+        printf("INFO: Invalid channels %s, the carrier has %.*s.\n", encInfo->channels_arg,
+               (int)encInfo->carrier.channels, encInfo->carrier.channel_names);
+        return e_failure;
+    }
+
+    // Every channel is the same as no mask, and stays readable by older builds
+    if (mask == (1u << encInfo->carrier.channels) - 1)
+    {
+        mask = 0;
+    }
+    encInfo->flags = (encInfo->flags & ~FLAG_CHANNEL_MASK) | (mask << FLAG_CHANNEL_SHIFT);
+    if (mask != 0 && carrier_select_channels(&selected, mask, HEADER_FIELD_SAMPLES) == e_failure)
+    {
+        return e_failure;
+    }
+
+    // The magic string and field use every channel, the rest only the selected ones
+    long req_size = encoded_payload_size(encInfo) * 8 - ((mask != 0) ? HEADER_FIELD_SAMPLES : 0);
+    if (selected.capacity < req_size)
+    {
+        return e_failure;
+    }
+    printf("INFO: Done. Found OK, %u payload bytes on channels %s\n", selected.capacity, encInfo->channels_arg);
     return e_success;
 }
 
+// Function to switch the carrier to the selected channels
+Status encode_select_channels(EncodeInfo *encInfo)
+{
+    char buffer[MAX_CARRIER_GROUP];
+
+    if (carrier_select_channels(&encInfo->carrier, FLAG_CHANNELS(encInfo->flags), HEADER_FIELD_SAMPLES) == e_failure)
+    {
+        return e_failure;
+    }
+
+    // The unused rest of the last header group is copied as it is
+    long left = encInfo->carrier.data_offset - ftell(encInfo->fptr_src_image);
+    if (left < 0 || left > (long)sizeof(buffer) || fread(buffer, 1, left, encInfo->fptr_src_image) != (size_t)left)
+    {
+        return e_failure;
+    }
+    fwrite(buffer, 1, left, encInfo->fptr_stego_image);
+    return e_success;
+}
+
+// Function to compute the number of payload bytes for the selected options
+long encoded_payload_size(EncodeInfo *encInfo)
+{
+    // Get Magic string length
+    uint magic_string_length = strlen(MAGIC_STRING);
+    uint extn_length = strlen(encInfo->extn_secret_file);
+
+    if (encInfo->flags & FLAG_FEC)
+    {
+        // Triplicated extension length, extension and size, then coded data
+        return magic_string_length + 4 + FEC_COPIES * (1 + extn_length + 4) + fec_encoded_size(encInfo->size_secret_file);
+    }
+    return magic_string_length + 4 + extn_length + 4 + encInfo->size_secret_file;
+}
+
 // Function to encode a magic string into the stego image
 Status encode_magic_string(const char *magic_string, EncodeInfo *encInfo)
 {
@@ -264,7 +749,7 @@ Status encode_magic_string(const char *magic_string, EncodeInfo *encInfo)
     strcpy(magic, magic_string);
     printf("INFO: Encoding Magic string \n");
     // Encode the magic string into the stego image
-    encode_data_to_image(magic, encInfo->fptr_src_image, encInfo->fptr_stego_image);   
+    encode_data_to_image(magic, &encInfo->carrier, encInfo->fptr_src_image, encInfo->fptr_stego_image);   
     printf("INFO: Done\n");
     return e_success;
 }
@@ -272,25 +757,32 @@ Status encode_magic_string(const char *magic_string, EncodeInfo *encInfo)
 // Function to encode the size of the secret file extension
 Status encode_extention_size(char size, EncodeInfo *encInfo)
 {
-    char buffer[32];
-    // Read 32 bytes from the source image
-    fread(buffer, 32, 1, encInfo->fptr_src_image);
-    // Encode the size into the least significant bits of the buffer
-    encode_int_to_lsb(buffer, size);
-    // Write the modified buffer to the stego image
-    fwrite(buffer, 32, 1, encInfo->fptr_stego_image);
-    return e_success;
+    // The option flags ride in the upper bytes, three times over
+    uint field = EXTN_FIELD(encInfo->flags, size);
+    // Encode the size into the least significant bits of the next 32 samples
+    return encode_int_to_image(field, &encInfo->carrier, encInfo->fptr_src_image, encInfo->fptr_stego_image);
 }
 
 // Function to encode the secret file extension into the stego image
 Status encode_secret_file_extn(const char *file_extn, EncodeInfo *encInfo)
 {
     printf("INFO: Encoding %s Extention.\n", encInfo->secret_fname);
+    if (encInfo->flags & FLAG_FEC)
+    {
+        // Protected copy of the length, then every character
+        encode_protected_byte(strlen(file_extn), encInfo);
+        for (int i = 0; file_extn[i] != '\0'; i++)
+        {
+            encode_protected_byte(file_extn[i], encInfo);
+        }
+        printf("INFO: Done\n");
+        return e_success;
+    }
     char image_buffer[8];
     // Copy the file extension into a temporary buffer
     strcpy(image_buffer, file_extn);
     // Encode the file extension into the stego image
-    encode_data_to_image(image_buffer, encInfo->fptr_src_image, encInfo->fptr_stego_image);
+    encode_data_to_image(image_buffer, &encInfo->carrier, encInfo->fptr_src_image, encInfo->fptr_stego_image);
     printf("INFO: Done\n");
     return e_success;
 }
@@ -299,13 +791,18 @@ Status encode_secret_file_extn(const char *file_extn, EncodeInfo *encInfo)
 Status encode_secret_file_size(long file_size, EncodeInfo *encInfo)
 {
     printf("INFO: Encoding %s file size.\n", encInfo->secret_fname);
-    char buffer[32];
-    // Read 32 bytes from the source image
-    fread(buffer, 32, 1, encInfo->fptr_src_image);
-    // Encode the file size into the least significant bits of the buffer
-    encode_int_to_lsb(buffer, file_size);
-    // Write the modified buffer to the stego image
-    fwrite(buffer, 32, 1, encInfo->fptr_stego_image);
+    if (encInfo->flags & FLAG_FEC)
+    {
+        // Most significant byte first, like encode_int_to_lsb
+        for (int i = 3; i >= 0; i--)
+        {
+            encode_protected_byte((file_size >> (8 * i)) & 0xFF, encInfo);
+        }
+        printf("INFO: Done\n");
+        return e_success;
+    }
+    // Encode the file size into the least significant bits of the next 32 samples
+    encode_int_to_image(file_size, &encInfo->carrier, encInfo->fptr_src_image, encInfo->fptr_stego_image);
     printf("INFO: Done\n");
     return e_success;
 }
@@ -314,17 +811,96 @@ Status encode_secret_file_size(long file_size, EncodeInfo *encInfo)
 Status encode_secret_file_data(EncodeInfo *encInfo)
 {
     printf("INFO: Encoding %s file data.\n", encInfo->secret_fname);
-    rewind(encInfo->fptr_secret);
-    char ch;
-    char buffer[8];
+    fseek(encInfo->fptr_secret, encInfo->secret_offset, SEEK_SET);
+    long since_checkpoint = 0;
+    int ch;
     // Read each character from the secret file and encode it
     while ((ch = getc(encInfo->fptr_secret)) != EOF)
     {
-        fread(buffer, 8, 1, encInfo->fptr_src_image);
-        // Encode the character into the buffer
-        encode_byte_to_lsb(ch, buffer);
-        // Write the modified buffer to the stego image
-        fwrite(buffer, 8, 1, encInfo->fptr_stego_image);
+        if (encode_byte_to_image(ch, &encInfo->carrier, encInfo->fptr_src_image, encInfo->fptr_stego_image) == e_failure)
+        {
+            return e_failure;
+        }
+
+        encInfo->secret_offset++;
+
+        // Commit roughly every CHECKPOINT_INTERVAL samples
+        since_checkpoint += 8;
+        if (since_checkpoint >= CHECKPOINT_INTERVAL)
+        {
+            if (encode_checkpoint(encInfo) == e_failure)
+            {
+                return e_failure;
+            }
+            since_checkpoint = 0;
+        }
+    }
+    printf("INFO: Done.\n");
+    return e_success;
+}
+
+// Function to encode the secret file data with Reed-Solomon protection
+Status encode_secret_file_data_fec(EncodeInfo *encInfo)
+{
+    static __thread unsigned char data[FEC_GROUP_DATA], coded[FEC_GROUP_BLOCK];
+
+    printf("INFO: Encoding %s file data with error correction.\n", encInfo->secret_fname);
+    fec_init();
+    fseek(encInfo->fptr_secret, encInfo->secret_offset, SEEK_SET);
+    long since_checkpoint = 0;
+
+    // One interleaved group at a time
+    size_t len;
+    while ((len = fread(data, 1, FEC_GROUP_DATA, encInfo->fptr_secret)) > 0)
+    {
+        uint coded_len = fec_encode_group(data, len, coded);
+        for (uint i = 0; i < coded_len; i++)
+        {
+            if (encode_byte_to_image(coded[i], &encInfo->carrier, encInfo->fptr_src_image, encInfo->fptr_stego_image) == e_failure)
+            {
+                return e_failure;
+            }
+        }
+
+        // Checkpoints fall between groups, so a group is never resumed half way
+        encInfo->secret_offset += len;
+        since_checkpoint += coded_len * 8;
+        if (since_checkpoint >= CHECKPOINT_INTERVAL)
+        {
+            if (encode_checkpoint(encInfo) == e_failure)
+            {
+                return e_failure;
+            }
+            since_checkpoint = 0;
+        }
+    }
+    printf("INFO: Done.\n");
+    return e_success;
+}
+
+// Function to copy the rest of the cover with checkpoints
+Status encode_remaining_img_data(EncodeInfo *encInfo)
+{
+    static __thread char buffer[64 * 1024];
+    long since_checkpoint = 0;
+    size_t n;
+
+    printf("INFO: Copying Left over Data.\n");
+    while ((n = fread(buffer, 1, sizeof(buffer), encInfo->fptr_src_image)) > 0)
+    {
+        if (fwrite(buffer, 1, n, encInfo->fptr_stego_image) != n)
+        {
+            return e_failure;
+        }
+        since_checkpoint += n;
+        if (since_checkpoint >= CHECKPOINT_INTERVAL)
+        {
+            if (encode_checkpoint(encInfo) == e_failure)
+            {
+                return e_failure;
+            }
+            since_checkpoint = 0;
+        }
     }
     printf("INFO: Done.\n");
     return e_success;
@@ -345,21 +921,67 @@ Status copy_remaining_img_data(FILE *fptr_src, FILE *fptr_dest)
 }
 
 // Function to encode data into the stego image
-Status encode_data_to_image(char *data, FILE *fptr_src_image, FILE *fptr_stego_image)
+Status encode_data_to_image(char *data, CarrierInfo *carrier, FILE *fptr_src_image, FILE *fptr_stego_image)
 {
-    char buffer[8];
-    // Read 8 bytes of data from the source image and encode each character of the data
+    CarrierWindow window;
+    // Read 8 samples from the source image and encode each character of the data
     for (int i = 0; i < strlen(data); i++)
     {
-        fread(buffer, 1, 8, fptr_src_image);
-        // Encode the character into the buffer
-        encode_byte_to_lsb(data[i], buffer);
-        // Write the modified buffer to the stego image
-        fwrite(buffer, 1, 8, fptr_stego_image);
+        if (carrier_read_window(carrier, fptr_src_image, &window, 8) == e_failure)
+        {
+            return e_failure;
+        }
+        // Encode the character into the samples
+        encode_byte_to_lsb(data[i], window.samples);
+        // Write the modified samples to the stego image
+        carrier_write_window(&window, fptr_stego_image);
+    }
+    return e_success;
+}
+
+// Function to encode a byte into the stego image
+Status encode_byte_to_image(char data, CarrierInfo *carrier, FILE *fptr_src_image, FILE *fptr_stego_image)
+{
+    CarrierWindow window;
+    // Read 8 samples from the source image
+    if (carrier_read_window(carrier, fptr_src_image, &window, 8) == e_failure)
+    {
+        return e_failure;
+    }
+    // Encode the character into the samples
+    encode_byte_to_lsb(data, window.samples);
+    // Write the modified samples to the stego image
+    return carrier_write_window(&window, fptr_stego_image);
+}
+
+// Function to encode a header byte several times for majority voting
+Status encode_protected_byte(char data, EncodeInfo *encInfo)
+{
+    for (int i = 0; i < FEC_COPIES; i++)
+    {
+        if (encode_byte_to_image(data, &encInfo->carrier, encInfo->fptr_src_image, encInfo->fptr_stego_image) == e_failure)
+        {
+            return e_failure;
+        }
     }
     return e_success;
 }
 
+// Function to encode a 32-bit value into the stego image
+Status encode_int_to_image(uint data, CarrierInfo *carrier, FILE *fptr_src_image, FILE *fptr_stego_image)
+{
+    CarrierWindow window;
+    // Read 32 samples from the source image
+    if (carrier_read_window(carrier, fptr_src_image, &window, 32) == e_failure)
+    {
+        return e_failure;
+    }
+    // Encode the value into the least significant bits of the samples
+    encode_int_to_lsb(window.samples, data);
+    // Write the modified samples to the stego image
+    return carrier_write_window(&window, fptr_stego_image);
+}
+
 // Function to encode a single byte into the least significant bits of the image buffer
 Status encode_byte_to_lsb(char data, char *image_buffer)
 {
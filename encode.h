@@ -2,21 +2,33 @@
 #define ENCODE_H
 
 #include "types.h" // Contains user defined types
+#include "carrier.h" // Carrier formats
+#include "journal.h" // Resumable encoding
+#include "synth.h" // Generated covers
+#include "cache.h" // Result cache
+#include "fec.h" // Error correction
 
 
 
 #define MAX_SECRET_BUF_SIZE 1
 #define MAX_IMAGE_BUF_SIZE (MAX_SECRET_BUF_SIZE * 8)
 #define MAX_FILE_SUFFIX 10
+#define MAX_STEGO_FNAME 256
+#define MAX_PAYLOAD_HEADER 64   // Largest serialized payload header (FEC protected)
 
 typedef struct _EncodeInfo
 {
     /* Source Image info */
     char *src_image_fname;      //Source filename beautiful.bmp
     FILE *fptr_src_image;       //file pointer to beautiful.bmp
-    uint image_capacity;        //Source file size
-    //uint bits_per_pixel;      24 bits per pixel
+    uint image_capacity;        //Number of payload carrying bytes
+    CarrierInfo carrier;        //Layout of the source carrier
     char image_data[MAX_IMAGE_BUF_SIZE];        //To store image data
+    int synthetic_flag;         //Cover is generated instead of read
+    SyntheticSpec synthetic;    //Parameters of the generated cover
+    char synthetic_name[64];    //Name of the generated cover for messages
+    int video_flag;             //Cover is a Y4M video, encoded frame by frame
+    uint threads;               //Worker threads for video covers (0 = one per CPU)
 
     
 
@@ -26,13 +38,36 @@ typedef struct _EncodeInfo
     char extn_secret_file[MAX_FILE_SUFFIX];     //Extention of secret file(.txt)
     char secret_data[MAX_SECRET_BUF_SIZE];      //To store secret data
     long size_secret_file;      //secret file size.
+    uint flags;                 //Option flags (FLAG_*)
+    char *channels_arg;         //Channels given with --channels (NULL = all)
+    long secret_offset;         //Secret bytes already embedded
 
     /* Stego Image Info */
     char *stego_image_fname;        //Outpur image file
+    char default_stego_fname[MAX_FILE_SUFFIX + 16];     //Storage for the default output name
     FILE *fptr_stego_image;         //File pointer to output image
+    char part_fname[MAX_STEGO_FNAME];       //Output being written, renamed when done
+    char journal_fname[MAX_STEGO_FNAME];    //Journal of committed output
+    int resume_flag;                //Continue from the journal if possible
+    EncodeJournal journal;          //Last committed checkpoint
+
+    /* Result cache */
+    ResultCache cache;              //Earlier outputs of the same inputs (dir NULL = none)
 
 } EncodeInfo;       //Datatype of the structure
 
+/* Payload of an encode (header, then plain or FEC coded data), produced in order */
+typedef struct _PayloadStream
+{
+    unsigned char header[MAX_PAYLOAD_HEADER];   //Serialized payload header
+    uint header_len;                            //Bytes in header
+    long payload_len;                           //Payload bytes in total (header and data)
+    long payload_done;                          //Payload bytes produced so far
+    unsigned char coded[FEC_GROUP_BLOCK];       //Encoded group not fully produced yet (FEC)
+    uint coded_len;                             //Bytes in coded
+    uint coded_pos;                             //Bytes of coded already produced
+} PayloadStream;
+
 
 /* Encoding function prototype */
 
@@ -45,21 +80,27 @@ Status read_and_validate_encode_args(char *argv[], EncodeInfo *encInfo);
 /* Perform the encoding */
 Status do_encoding(EncodeInfo *encInfo);
 
-/* Get File pointers for i/p and o/p files */
+/* Get File pointers for the source image and secret files */
 Status open_files(EncodeInfo *encInfo);
 
+/* Record the inputs and final flags in the journal, then open or resume the part file */
+Status open_part_file(EncodeInfo *encInfo);
+
+/* Embed the payload and copy the rest of the cover into the open part file */
+Status encode_to_part_file(EncodeInfo *encInfo);
+
+/* Remove the part file and journal of a failed encode */
+void discard_part_file(EncodeInfo *encInfo);
+
+/* Close the files that are still open */
+void close_encode_files(EncodeInfo *encInfo);
+
 /* check capacity */
 Status check_capacity(EncodeInfo *encInfo);
 
-/* Get image size */
-uint get_image_size_for_bmp(FILE *fptr_image);
-
 /* Get file size */
 uint get_file_size(FILE *fptr);
 
-/* Copy bmp image header */
-Status copy_bmp_header(FILE *fptr_src_image, FILE *fptr_dest_image);
-
 /* Store Magic String */
 Status encode_magic_string(const char *magic_string, EncodeInfo *encInfo);
 
@@ -69,11 +110,53 @@ Status encode_secret_file_extn(const char *file_extn, EncodeInfo *encInfo);
 /* Encode secret file size */
 Status encode_secret_file_size(long file_size, EncodeInfo *encInfo);
 
+/* Encode the magic string, extension and size */
+Status encode_payload_header(EncodeInfo *encInfo);
+
+/* Resolve --channels against the carrier and check the capacity of those channels */
+Status check_channel_capacity(EncodeInfo *encInfo);
+
+/* Copy an earlier output of the same inputs and options, if the cache has one */
+Status encode_from_cache(EncodeInfo *encInfo);
+
+/* Continue on the selected channels from the first whole group after the field */
+Status encode_select_channels(EncodeInfo *encInfo);
+
+/* Serialize the magic string, extension and size as they are embedded; returns the length */
+uint serialize_payload_header(EncodeInfo *encInfo, unsigned char *out);
+
+/* Start the payload stream of an encode whose secret is open */
+void payload_stream_init(EncodeInfo *encInfo, PayloadStream *stream);
+
+/* Produce the next payload bytes; returns the number produced */
+uint payload_stream_read(EncodeInfo *encInfo, PayloadStream *stream, unsigned char *dst, uint n);
+
+/* Continue from the journal of an interrupted encode */
+Status open_resume_point(EncodeInfo *encInfo);
+
+/* Make the output written so far durable and record it in the journal */
+Status encode_checkpoint(EncodeInfo *encInfo);
+
 /* Encode secret file data*/
 Status encode_secret_file_data(EncodeInfo *encInfo);
 
+/* Encode secret file data as interleaved Reed-Solomon groups */
+Status encode_secret_file_data_fec(EncodeInfo *encInfo);
+
+/* Number of payload bytes needed for the secret with the selected options */
+long encoded_payload_size(EncodeInfo *encInfo);
+
 /* Encode function, which does the real encoding */
-Status encode_data_to_image(char *data,FILE *fptr_src_image, FILE *fptr_stego_image);
+Status encode_data_to_image(char *data, CarrierInfo *carrier, FILE *fptr_src_image, FILE *fptr_stego_image);
+
+/* Encode a byte into the next 8 carrier samples */
+Status encode_byte_to_image(char data, CarrierInfo *carrier, FILE *fptr_src_image, FILE *fptr_stego_image);
+
+/* Encode a header byte FEC_COPIES times for majority voting */
+Status encode_protected_byte(char data, EncodeInfo *encInfo);
+
+/* Encode a 32-bit value into the next 32 carrier samples */
+Status encode_int_to_image(uint data, CarrierInfo *carrier, FILE *fptr_src_image, FILE *fptr_stego_image);
 
 /* Encode a byte into LSB of image data array */
 Status encode_byte_to_lsb(char data, char *image_buffer);
@@ -82,6 +165,9 @@ Status encode_byte_to_lsb(char data, char *image_buffer);
 Status encode_int_to_lsb(char *image_buffer, int data);
 
 Status encode_extention_size(char size, EncodeInfo *encInfo);
+/* Copy the rest of the cover, checkpointing as it goes */
+Status encode_remaining_img_data(EncodeInfo *encInfo);
+
 /* Copy remaining image bytes from src to stego image after encoding */
 Status copy_remaining_img_data(FILE *fptr_src, FILE *fptr_dest);
 
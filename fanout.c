@@ -0,0 +1,313 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "types.h"
+#include "common.h"
+#include "encode.h"
+#include "kernel.h"
+#include "journal.h"
+#include "fanout.h"
+
+// Function to read and validate fan-out arguments
+static Status read_and_validate_fanout_args(int argc, char *argv[], FanoutJob *jobs, uint *count)
+{
+    uint flags = 0;
+    int last = argc;
+
+    // Options come after the pairs
+    while (last > 3 && strncmp(argv[last - 1], "--", 2) == 0)
+    {
+        if (strcmp(argv[last - 1], "--fec") == 0)
+        {
+            flags |= FLAG_FEC;
+        }
+        else
+        {
+            printf("INFO: Unexpected argument %s\n", argv[last - 1]);
+            return e_failure;
+        }
+        last--;
+    }
+
+    char *src_extn = strrchr(argv[2], '.');
+    if (carrier_known_extn(src_extn) == e_failure)
+    {
+        printf("INFO: Validation Error. Unsupported cover %s.\n", argv[2]);
+        return e_failure;
+    }
+    if ((last - 3) % 2 || last - 3 < 2 || (last - 3) / 2 > MAX_FANOUT)
+    {
+        printf("INFO: Validation Error. Give 1 to %d pairs of <.txt file> <output>.\n", MAX_FANOUT);
+        return e_failure;
+    }
+
+    *count = (last - 3) / 2;
+    for (uint i = 0; i < *count; i++)
+    {
+        EncodeInfo *info = &jobs[i].info;
+        char *secret = argv[3 + 2 * i];
+        char *output = argv[4 + 2 * i];
+        char *txt = strrchr(secret, '.');
+        char *out_extn = strrchr(output, '.');
+
+        // Same rules as -e: .txt secrets, outputs of the cover's format
+        if (txt == NULL || strcmp(txt, ".txt") || out_extn == NULL || strcmp(out_extn, src_extn))
+        {
+            printf("INFO: Validation Error. %s must be a .txt file and %s a %s file.\n", secret, output, src_extn);
+            return e_failure;
+        }
+        info->src_image_fname = argv[2];
+        info->secret_fname = secret;
+        info->stego_image_fname = output;
+        info->flags = flags;
+        strcpy(info->extn_secret_file, txt);
+    }
+    return e_success;
+}
+
+// Function to open the secret of a job and prepare its payload
+static Status open_fanout_job(FanoutJob *job, CarrierInfo *carrier)
+{
+    EncodeInfo *info = &job->info;
+
+    info->fptr_secret = fopen(info->secret_fname, "r");
+    if (info->fptr_secret == NULL)
+    {
+        perror("fopen");
+        fprintf(stderr, "ERROR: can't open file %s\n", info->secret_fname);
+        return e_failure;
+    }
+    info->size_secret_file = get_file_size(info->fptr_secret);
+    rewind(info->fptr_secret);
+
+    // Every output must fit on its own
+    payload_stream_init(info, &job->stream);
+    if (job->stream.payload_len * 8 > carrier->capacity)
+    {
+        printf("INFO: There is not enough space for %s.\n", info->secret_fname);
+        return e_failure;
+    }
+    return e_success;
+}
+
+// Function to create the part file of a job
+static Status open_fanout_output(FanoutJob *job)
+{
+    EncodeInfo *info = &job->info;
+
+    // Written under a temporary name and renamed once complete, like -e does
+    if ((size_t)snprintf(info->part_fname, sizeof(info->part_fname), "%s%s", info->stego_image_fname,
+                         PART_SUFFIX) >= sizeof(info->part_fname))
+    {
+        printf("INFO: Output file name %s is too long.\n", info->stego_image_fname);
+        return e_failure;
+    }
+    info->fptr_stego_image = fopen(info->part_fname, "w");
+    if (info->fptr_stego_image == NULL)
+    {
+        perror("fopen");
+        fprintf(stderr, "ERROR: can't open file %s\n", info->part_fname);
+        return e_failure;
+    }
+    printf("INFO: %s -> %s (%ld payload bytes)\n", info->secret_fname, info->stego_image_fname, job->stream.payload_len);
+    return e_success;
+}
+
+// Function to embed the next payload bytes of a job into a block of raw groups
+static void embed_fanout_block(FanoutJob *job, CarrierInfo *carrier, unsigned char *raw, uint groups, unsigned char *samples)
+{
+    static unsigned char payload[FANOUT_BLOCK_GROUPS * MAX_CARRIER_GROUP / 8];
+    uint n = payload_stream_read(&job->info, &job->stream, payload, groups * carrier->lanes / 8);
+
+    if (carrier->lanes == carrier->group_size)
+    {
+        // Every byte is a sample, embed in place
+        lsb_embed_block(payload, n, raw);
+        return;
+    }
+
+    // Gather the lanes of the groups the payload reaches, embed, and scatter them back
+    uint used = (n * 8 + carrier->lanes - 1) / carrier->lanes;
+    carrier_gather(carrier, raw, used, samples);
+    lsb_embed_block(payload, n, samples);
+    carrier_scatter(carrier, samples, used, raw);
+}
+
+// Function to copy the untouched tail of the cover into an output
+static Status copy_fanout_tail(int fd_src, int fd_dest, long offset, long end)
+{
+    loff_t in = offset, out = offset;
+
+    // Let the kernel share or copy the extent without a round trip through memory
+    while (in < end)
+    {
+        ssize_t n = copy_file_range(fd_src, &in, fd_dest, &out, end - in, 0);
+        if (n <= 0)
+        {
+            break;
+        }
+    }
+
+    // Filesystems or kernels without support fall back to plain copying
+    char buffer[64 * 1024];
+    while (in < end)
+    {
+        ssize_t n = pread(fd_src, buffer, (end - in < (long)sizeof(buffer)) ? end - in : (long)sizeof(buffer), in);
+        if (n <= 0 || pwrite(fd_dest, buffer, n, out) != n)
+        {
+            return e_failure;
+        }
+        in += n;
+        out += n;
+    }
+    return e_success;
+}
+
+// Function to stream the cover once through every job
+static Status run_fanout(FanoutJob *jobs, uint count, const char *cover, unsigned char *raw, unsigned char *block, unsigned char *samples)
+{
+    CarrierInfo carrier;
+
+    printf("INFO: ## Fan-out Encoding Procedure Started. ##\n");
+    FILE *fptr_src = fopen(cover, "r");
+    jobs[0].info.fptr_src_image = fptr_src; // Closed with the first job
+    if (fptr_src == NULL || carrier_open(fptr_src, &carrier) == e_failure)
+    {
+        fprintf(stderr, "ERROR: can't open cover %s\n", cover);
+        return e_failure;
+    }
+    struct stat st;
+    fstat(fileno(fptr_src), &st);
+    fec_init();
+    for (uint i = 0; i < count; i++)
+    {
+        if (open_fanout_job(&jobs[i], &carrier) == e_failure)
+        {
+            return e_failure;
+        }
+    }
+
+    // Outputs are only created once every secret is known to fit
+    for (uint i = 0; i < count; i++)
+    {
+        if (open_fanout_output(&jobs[i]) == e_failure)
+        {
+            return e_failure;
+        }
+    }
+
+    // Carrier header, read once and written to every output
+    rewind(fptr_src);
+    for (long left = carrier.data_offset; left > 0;)
+    {
+        size_t n = (left < FANOUT_BLOCK_GROUPS * MAX_CARRIER_GROUP) ? left : FANOUT_BLOCK_GROUPS * MAX_CARRIER_GROUP;
+        if (fread(raw, 1, n, fptr_src) != n)
+        {
+            return e_failure;
+        }
+        for (uint i = 0; i < count; i++)
+        {
+            if (fwrite(raw, 1, n, jobs[i].info.fptr_stego_image) != n)
+            {
+                printf("INFO: Error writing the header of %s.\n", jobs[i].info.stego_image_fname);
+                return e_failure;
+            }
+        }
+        left -= n;
+    }
+
+    // Blocks of groups while any output still has payload to embed
+    printf("INFO: Embedding %u secrets in one pass over %s.\n", count, cover);
+    long offset = carrier.data_offset;
+    uint active = count;
+    for (uint i = 0; i < count; i++)
+    {
+        jobs[i].tail_offset = offset;
+    }
+    while (active > 0)
+    {
+        size_t got = fread(raw, 1, FANOUT_BLOCK_GROUPS * carrier.group_size, fptr_src);
+        if (got == 0)
+        {
+            printf("INFO: Cover ended before every payload was embedded.\n");
+            return e_failure;
+        }
+        uint groups = got / carrier.group_size;
+        for (uint i = 0; i < count; i++)
+        {
+            FanoutJob *job = &jobs[i];
+            if (job->stream.payload_done == job->stream.payload_len)
+            {
+                continue;
+            }
+            memcpy(block, raw, got);
+            embed_fanout_block(job, &carrier, block, groups, samples);
+            if (fwrite(block, 1, got, job->info.fptr_stego_image) != got)
+            {
+                return e_failure;
+            }
+            job->tail_offset = offset + got;
+            active -= (job->stream.payload_done == job->stream.payload_len);
+        }
+        offset += got;
+    }
+
+    // Everything after the payload is the cover itself; each output is published once its tail is on disk
+    printf("INFO: Copying the untouched tails.\n");
+    for (uint i = 0; i < count; i++)
+    {
+        EncodeInfo *info = &jobs[i].info;
+        FILE *fptr = info->fptr_stego_image;
+        if (fflush(fptr) || copy_fanout_tail(fileno(fptr_src), fileno(fptr), jobs[i].tail_offset, st.st_size) == e_failure)
+        {
+            printf("INFO: Error copying the tail of %s.\n", info->stego_image_fname);
+            return e_failure;
+        }
+        info->fptr_stego_image = NULL;
+        int failed = fsync(fileno(fptr));
+        failed |= fclose(fptr);
+        if (failed || rename(info->part_fname, info->stego_image_fname))
+        {
+            perror("fanout");
+            printf("INFO: Error writing %s.\n", info->stego_image_fname);
+            return e_failure;
+        }
+    }
+    printf("INFO: ## Fan-out Encoding Done successfully. ##\n");
+    return e_success;
+}
+
+// Function to encode several secrets into one cover in a single pass
+Status do_fanout_encoding(int argc, char *argv[])
+{
+    FanoutJob *jobs = calloc(MAX_FANOUT, sizeof(FanoutJob));
+    unsigned char *raw = malloc(FANOUT_BLOCK_GROUPS * MAX_CARRIER_GROUP);
+    unsigned char *block = malloc(FANOUT_BLOCK_GROUPS * MAX_CARRIER_GROUP);
+    unsigned char *samples = malloc(FANOUT_BLOCK_GROUPS * MAX_CARRIER_GROUP);
+    Status status = e_failure;
+    uint count = 0;
+
+    if (jobs != NULL && raw != NULL && block != NULL && samples != NULL &&
+        read_and_validate_fanout_args(argc, argv, jobs, &count) == e_success)
+    {
+        status = run_fanout(jobs, count, argv[2], raw, block, samples);
+    }
+
+    // Outputs not renamed yet are incomplete and removed with their part files
+    for (uint i = 0; i < count; i++)
+    {
+        close_encode_files(&jobs[i].info);
+        if (status == e_failure && jobs[i].info.part_fname[0] != '\0')
+        {
+            unlink(jobs[i].info.part_fname);
+        }
+    }
+    free(jobs);
+    free(raw);
+    free(block);
+    free(samples);
+    return status;
+}
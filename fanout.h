@@ -0,0 +1,46 @@
+#ifndef FANOUT_H
+#define FANOUT_H
+
+#include <stdio.h>
+#include "types.h" // Contains user defined types
+#include "encode.h"
+
+/*
+ * This header file defines fan-out encoding: one cover, several
+ * (secret, output) pairs. The cover is read once, a block of whole groups
+ * at a time, and every output still carrying payload in that block gets
+ * its own copy with its payload embedded. Once an output's payload is
+ * complete, the rest of it is identical to the cover and is copied
+ * in the kernel with copy_file_range (a reflink on filesystems that
+ * support it) instead of being read again.
+ *
+ * Every output is byte-identical to what -e produces for the same pair.
+ * Like -e, each one is written to <output>.part and renamed once its tail
+ * is on disk; a failed run removes the part files it leaves.
+ */
+
+#define MAX_FANOUT 64               // Maximum number of outputs
+#define FANOUT_BLOCK_GROUPS 8192    // Groups per block, a multiple of 8 so blocks start on payload bytes
+
+/*
+ * Structure: FanoutJob
+ * Purpose: One output of a fan-out encode and its payload stream.
+ */
+typedef struct _FanoutJob
+{
+    EncodeInfo info;            // Secret, output and options of this output
+    PayloadStream stream;       // Payload still to be embedded
+    long tail_offset;           // Cover offset from which the output equals the cover
+} FanoutJob;
+
+/*
+ * Function: do_fanout_encoding
+ * Purpose: Handles "-f <cover> <secret> <output> [<secret> <output> ...] [--fec]".
+ * Inputs:
+ *  - argc, argv: Command-line arguments.
+ * Outputs:
+ *  - Returns e_success if every output was written, otherwise e_failure.
+ */
+Status do_fanout_encoding(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,413 @@
+#include <string.h>
+#include <pthread.h>
+#include "types.h"
+#include "fec.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#define GF_POLY 0x11d   // x^8 + x^4 + x^3 + x^2 + 1
+
+static unsigned char gf_exp[512];           // alpha^i, doubled to skip a modulo
+static unsigned char gf_log[256];           // log_alpha(x)
+static unsigned char gf_mul_table[256][256];    // Full product table
+static unsigned char rs_generator[RS_PARITY + 1];   // Generator polynomial, lowest degree first
+static unsigned char rs_feedback[256][RS_PARITY];   // Feedback byte times every generator coefficient
+static pthread_once_t fec_once = PTHREAD_ONCE_INIT;
+
+// Function to multiply in GF(256)
+static inline unsigned char gf_mul(unsigned char a, unsigned char b)
+{
+    return gf_mul_table[a][b];
+}
+
+// Function to divide in GF(256), b must not be zero
+static inline unsigned char gf_div(unsigned char a, unsigned char b)
+{
+    if (a == 0)
+    {
+        return 0;
+    }
+    return gf_exp[gf_log[a] + 255 - gf_log[b]];
+}
+
+// Function to build the tables
+static void fec_build_tables(void)
+{
+    uint x = 1;
+    for (int i = 0; i < 255; i++)
+    {
+        gf_exp[i] = x;
+        gf_log[x] = i;
+        x <<= 1;
+        if (x & 0x100)
+        {
+            x ^= GF_POLY;
+        }
+    }
+    for (int i = 255; i < 512; i++)
+    {
+        gf_exp[i] = gf_exp[i - 255];
+    }
+
+    // Every product, so the encoder inner loop is one lookup
+    for (int a = 1; a < 256; a++)
+    {
+        for (int b = 1; b < 256; b++)
+        {
+            gf_mul_table[a][b] = gf_exp[gf_log[a] + gf_log[b]];
+        }
+    }
+
+    // g(x) = (x - alpha^0)(x - alpha^1)...(x - alpha^31)
+    memset(rs_generator, 0, sizeof(rs_generator));
+    rs_generator[0] = 1;
+    for (int j = 0; j < RS_PARITY; j++)
+    {
+        unsigned char root = gf_exp[j];
+        for (int i = j + 1; i > 0; i--)
+        {
+            rs_generator[i] = rs_generator[i - 1] ^ gf_mul(rs_generator[i], root);
+        }
+        rs_generator[0] = gf_mul(rs_generator[0], root);
+    }
+
+    // A whole parity register update per feedback byte, for the vector encoders
+    for (int f = 0; f < 256; f++)
+    {
+        for (int j = 0; j < RS_PARITY; j++)
+        {
+            rs_feedback[f][j] = gf_mul(f, rs_generator[j]);
+        }
+    }
+}
+
+// Function to build the GF(256) tables once
+void fec_init(void)
+{
+    pthread_once(&fec_once, fec_build_tables);
+}
+
+// Function to compute the encoded size of size data bytes
+uint fec_encoded_size(uint size)
+{
+    uint codewords = (size + RS_DATA - 1) / RS_DATA;
+    return size + codewords * RS_PARITY;
+}
+
+// Function to take the bitwise majority of three copies
+unsigned char fec_majority(unsigned char a, unsigned char b, unsigned char c)
+{
+    return (a & b) | (a & c) | (b & c);
+}
+
+// Function to compute the parity of a codeword, one coefficient at a time
+static void rs_encode_scalar(const unsigned char *data, uint k, unsigned char *parity)
+{
+    unsigned char reg[RS_PARITY];
+
+    // Remainder of data(x) * x^32 divided by g(x), one data byte at a time
+    memset(reg, 0, sizeof(reg));
+    for (uint i = 0; i < k; i++)
+    {
+        const unsigned char *row = gf_mul_table[data[i] ^ reg[RS_PARITY - 1]];
+        for (int j = RS_PARITY - 1; j > 0; j--)
+        {
+            reg[j] = reg[j - 1] ^ row[rs_generator[j]];
+        }
+        reg[0] = row[rs_generator[0]];
+    }
+
+    // Highest degree first, right after the data
+    for (int j = 0; j < RS_PARITY; j++)
+    {
+        parity[j] = reg[RS_PARITY - 1 - j];
+    }
+}
+
+#ifdef __SSE2__
+// Function to compute the parity of a codeword with the register in two SSE2 vectors
+static void rs_encode_sse2(const unsigned char *data, uint k, unsigned char *parity)
+{
+    unsigned char reg[RS_PARITY];
+    __m128i lo = _mm_setzero_si128();   // reg[0 .. 15]
+    __m128i hi = _mm_setzero_si128();   // reg[16 .. 31]
+
+    // Shift the register up one byte and add the feedback row, as the scalar loop does per coefficient
+    for (uint i = 0; i < k; i++)
+    {
+        const unsigned char *row = rs_feedback[data[i] ^ (_mm_extract_epi16(hi, 7) >> 8)];
+        hi = _mm_or_si128(_mm_slli_si128(hi, 1), _mm_srli_si128(lo, 15));
+        hi = _mm_xor_si128(hi, _mm_loadu_si128((const __m128i *)(row + 16)));
+        lo = _mm_xor_si128(_mm_slli_si128(lo, 1), _mm_loadu_si128((const __m128i *)row));
+    }
+
+    _mm_storeu_si128((__m128i *)reg, lo);
+    _mm_storeu_si128((__m128i *)(reg + 16), hi);
+    for (int j = 0; j < RS_PARITY; j++)
+    {
+        parity[j] = reg[RS_PARITY - 1 - j];
+    }
+}
+#endif
+
+#ifdef __AVX2__
+// Function to compute the parity of a codeword with the register in one AVX2 vector
+static void rs_encode_avx2(const unsigned char *data, uint k, unsigned char *parity)
+{
+    unsigned char reg[RS_PARITY];
+    __m256i r = _mm256_setzero_si256();
+
+    for (uint i = 0; i < k; i++)
+    {
+        const unsigned char *row = rs_feedback[data[i] ^ (unsigned char)_mm256_extract_epi8(r, 31)];
+        // Byte 15 crosses into the upper lane: align against the lower lane moved up, zero below it
+        r = _mm256_alignr_epi8(r, _mm256_permute2x128_si256(r, r, 0x08), 15);
+        r = _mm256_xor_si256(r, _mm256_loadu_si256((const __m256i *)row));
+    }
+
+    _mm256_storeu_si256((__m256i *)reg, r);
+    for (int j = 0; j < RS_PARITY; j++)
+    {
+        parity[j] = reg[RS_PARITY - 1 - j];
+    }
+}
+#endif
+
+/* Registered encoders; the first is the reference */
+const FecKernel fec_kernels[] =
+{
+    { "scalar", rs_encode_scalar },
+#ifdef __SSE2__
+    { "sse2", rs_encode_sse2 },
+#endif
+#ifdef __AVX2__
+    { "avx2", rs_encode_avx2 },
+#endif
+};
+
+const uint fec_kernel_count = sizeof(fec_kernels) / sizeof(fec_kernels[0]);
+
+// Function to compute the parity of a codeword with the fastest encoder
+void rs_encode(const unsigned char *data, uint k, unsigned char *parity)
+{
+#if defined(__AVX2__)
+    rs_encode_avx2(data, k, parity);
+#elif defined(__SSE2__)
+    rs_encode_sse2(data, k, parity);
+#else
+    rs_encode_scalar(data, k, parity);
+#endif
+}
+
+// Function to compute the syndromes of a codeword; returns 1 if any is non-zero
+static int rs_syndromes(const unsigned char *codeword, uint n, unsigned char *synd)
+{
+    int damaged = 0;
+    for (int j = 0; j < RS_PARITY; j++)
+    {
+        // Evaluate the codeword at alpha^j (Horner, highest degree first)
+        unsigned char s = 0;
+        unsigned char root = gf_exp[j];
+        for (uint i = 0; i < n; i++)
+        {
+            s = gf_mul(s, root) ^ codeword[i];
+        }
+        synd[j] = s;
+        damaged |= s;
+    }
+    return damaged != 0;
+}
+
+// Function to repair a codeword in place
+int rs_decode(unsigned char *codeword, uint n)
+{
+    unsigned char synd[RS_PARITY];
+    unsigned char lambda[RS_PARITY + 1], prev[RS_PARITY + 1], temp[RS_PARITY + 1];
+    unsigned char omega[RS_PARITY];
+    uint degrees[RS_PARITY];
+
+    if (!rs_syndromes(codeword, n, synd))
+    {
+        return 0;
+    }
+
+    // Berlekamp-Massey: error locator lambda(x), lowest degree first
+    memset(lambda, 0, sizeof(lambda));
+    memset(prev, 0, sizeof(prev));
+    lambda[0] = prev[0] = 1;
+    int errors = 0, shift = 1;
+    unsigned char last = 1;
+    for (int r = 0; r < RS_PARITY; r++)
+    {
+        unsigned char delta = synd[r];
+        for (int i = 1; i <= errors; i++)
+        {
+            delta ^= gf_mul(lambda[i], synd[r - i]);
+        }
+        if (delta == 0)
+        {
+            shift++;
+            continue;
+        }
+
+        unsigned char scale = gf_div(delta, last);
+        memcpy(temp, lambda, sizeof(lambda));
+        for (int i = 0; i + shift <= RS_PARITY; i++)
+        {
+            lambda[i + shift] ^= gf_mul(scale, prev[i]);
+        }
+        if (2 * errors <= r)
+        {
+            errors = r + 1 - errors;
+            memcpy(prev, temp, sizeof(prev));
+            last = delta;
+            shift = 1;
+        }
+        else
+        {
+            shift++;
+        }
+    }
+    if (2 * errors > RS_PARITY)
+    {
+        return -1;
+    }
+
+    // Chien search: an error at degree d makes lambda(alpha^-d) vanish
+    int found = 0;
+    for (uint d = 0; d < n && found <= errors; d++)
+    {
+        unsigned char x_inv = gf_exp[(255 - d % 255) % 255];
+        unsigned char value = 0;
+        for (int i = errors; i >= 0; i--)
+        {
+            value = gf_mul(value, x_inv) ^ lambda[i];
+        }
+        if (value == 0)
+        {
+            if (found == errors)
+            {
+                return -1;
+            }
+            degrees[found++] = d;
+        }
+    }
+    if (found != errors)
+    {
+        return -1;
+    }
+
+    // Forney: omega(x) = S(x) lambda(x) mod x^32
+    for (int i = 0; i < RS_PARITY; i++)
+    {
+        omega[i] = 0;
+        for (int j = 0; j <= i && j <= errors; j++)
+        {
+            omega[i] ^= gf_mul(lambda[j], synd[i - j]);
+        }
+    }
+    for (int k = 0; k < found; k++)
+    {
+        unsigned char x = gf_exp[degrees[k] % 255];
+        unsigned char x_inv = gf_exp[(255 - degrees[k] % 255) % 255];
+
+        // omega(x^-1) and the formal derivative lambda'(x^-1)
+        unsigned char num = 0, den = 0, power = 1;
+        for (int i = 0; i < RS_PARITY; i++)
+        {
+            num ^= gf_mul(omega[i], power);
+            power = gf_mul(power, x_inv);
+        }
+        power = 1;
+        for (int i = 1; i <= errors; i += 2)
+        {
+            den ^= gf_mul(lambda[i], power);
+            power = gf_mul(power, gf_mul(x_inv, x_inv));
+        }
+        if (den == 0)
+        {
+            return -1;
+        }
+        codeword[n - 1 - degrees[k]] ^= gf_mul(x, gf_div(num, den));
+    }
+
+    // Make sure the result really is a codeword
+    if (rs_syndromes(codeword, n, synd))
+    {
+        return -1;
+    }
+    return found;
+}
+
+// Function to encode and interleave one group
+uint fec_encode_group(const unsigned char *data, uint len, unsigned char *out)
+{
+    unsigned char codewords[RS_INTERLEAVE][RS_BLOCK];
+    uint lengths[RS_INTERLEAVE];
+    uint count = (len + RS_DATA - 1) / RS_DATA;
+    uint total = 0, longest = 0;
+
+    for (uint i = 0; i < count; i++)
+    {
+        uint k = (i + 1 < count) ? RS_DATA : len - i * RS_DATA;
+        memcpy(codewords[i], data + i * RS_DATA, k);
+        rs_encode(codewords[i], k, codewords[i] + k);
+        lengths[i] = k + RS_PARITY;
+        longest = (lengths[i] > longest) ? lengths[i] : longest;
+    }
+
+    // Byte j of every codeword, then byte j + 1 ...
+    for (uint j = 0; j < longest; j++)
+    {
+        for (uint i = 0; i < count; i++)
+        {
+            if (j < lengths[i])
+            {
+                out[total++] = codewords[i][j];
+            }
+        }
+    }
+    return total;
+}
+
+// Function to de-interleave and decode one group
+int fec_decode_group(const unsigned char *in, uint len, unsigned char *data)
+{
+    unsigned char codewords[RS_INTERLEAVE][RS_BLOCK];
+    uint lengths[RS_INTERLEAVE];
+    uint count = (len + RS_DATA - 1) / RS_DATA;
+    uint pos = 0, longest = 0;
+    int corrected = 0;
+
+    for (uint i = 0; i < count; i++)
+    {
+        lengths[i] = ((i + 1 < count) ? RS_DATA : len - i * RS_DATA) + RS_PARITY;
+        longest = (lengths[i] > longest) ? lengths[i] : longest;
+    }
+    for (uint j = 0; j < longest; j++)
+    {
+        for (uint i = 0; i < count; i++)
+        {
+            if (j < lengths[i])
+            {
+                codewords[i][j] = in[pos++];
+            }
+        }
+    }
+
+    for (uint i = 0; i < count; i++)
+    {
+        int fixed = rs_decode(codewords[i], lengths[i]);
+        if (fixed < 0)
+        {
+            return -1;
+        }
+        corrected += fixed;
+        memcpy(data + i * RS_DATA, codewords[i], lengths[i] - RS_PARITY);
+    }
+    return corrected;
+}
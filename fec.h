@@ -0,0 +1,61 @@
+#ifndef FEC_H
+#define FEC_H
+
+#include "types.h" // Contains user defined types
+
+/*
+ * This header file defines the optional forward error correction layer.
+ *
+ * Header fields are protected by storing every byte three times and taking
+ * a bitwise majority vote. The payload is cut into Reed-Solomon RS(255,223)
+ * codewords over GF(256), each able to repair 16 damaged bytes. Codewords
+ * are byte-interleaved in groups of RS_INTERLEAVE, so a run of damaged
+ * samples is spread over several codewords.
+ *
+ * The encoder keeps the 32 parity bytes in SSE2 or AVX2 registers when the
+ * build has them and adds a precomputed row of generator products per data
+ * byte. Every encoder is listed in fec_kernels[] so the benchmark (-b) can
+ * check it against the scalar reference.
+ */
+
+#define RS_DATA 223                             // Data bytes per full codeword
+#define RS_PARITY 32                            // Parity bytes per codeword
+#define RS_BLOCK (RS_DATA + RS_PARITY)          // Bytes per full codeword
+#define RS_INTERLEAVE 8                         // Codewords interleaved together
+#define FEC_GROUP_DATA (RS_DATA * RS_INTERLEAVE)    // Data bytes per interleaved group
+#define FEC_GROUP_BLOCK (RS_BLOCK * RS_INTERLEAVE)  // Encoded bytes per interleaved group
+#define FEC_COPIES 3                            // Copies of every protected header byte
+
+/* One implementation of rs_encode */
+typedef struct _FecKernel
+{
+    const char *name;   // Variant name for reports
+    void (*encode)(const unsigned char *data, uint k, unsigned char *parity);   // Same contract as rs_encode
+} FecKernel;
+
+/* Every compiled encoder; the first one is the reference */
+extern const FecKernel fec_kernels[];
+extern const uint fec_kernel_count;
+
+/* Build the GF(256) tables; safe to call more than once */
+void fec_init(void);
+
+/* Number of encoded bytes for size bytes of data */
+uint fec_encoded_size(uint size);
+
+/* Bitwise majority of three copies */
+unsigned char fec_majority(unsigned char a, unsigned char b, unsigned char c);
+
+/* Compute the RS_PARITY parity bytes of k data bytes (k <= RS_DATA) */
+void rs_encode(const unsigned char *data, uint k, unsigned char *parity);
+
+/* Repair a codeword of n bytes in place; returns the bytes corrected, or -1 */
+int rs_decode(unsigned char *codeword, uint n);
+
+/* Encode one group of len data bytes (len <= FEC_GROUP_DATA); returns the encoded length */
+uint fec_encode_group(const unsigned char *data, uint len, unsigned char *out);
+
+/* Decode one group back into len data bytes; returns the bytes corrected, or -1 */
+int fec_decode_group(const unsigned char *in, uint len, unsigned char *data);
+
+#endif
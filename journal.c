@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "types.h"
+#include "journal.h"
+
+// Function to write the journal atomically
+Status journal_write(const char *fname, const EncodeJournal *journal)
+{
+    char tmp_fname[4096 + 8];
+
+    // Write next to the journal, then rename over it
+    snprintf(tmp_fname, sizeof(tmp_fname), "%s.tmp", fname);
+    FILE *fptr = fopen(tmp_fname, "w");
+    if (fptr == NULL)
+    {
+        perror("fopen");
+        return e_failure;
+    }
+    fprintf(fptr, "%s %ld %ld %ld %ld %u %ld %ld %u\n", JOURNAL_MAGIC,
+            journal->src_size, journal->src_mtime, journal->secret_size, journal->secret_mtime,
+            journal->flags, journal->out_offset, journal->secret_offset, journal->phase);
+    if (fflush(fptr) || fsync(fileno(fptr)))
+    {
+        fclose(fptr);
+        return e_failure;
+    }
+    fclose(fptr);
+    if (rename(tmp_fname, fname))
+    {
+        perror("rename");
+        return e_failure;
+    }
+    return e_success;
+}
+
+// Function to read a journal
+Status journal_read(const char *fname, EncodeJournal *journal)
+{
+    char magic[32];
+
+    FILE *fptr = fopen(fname, "r");
+    if (fptr == NULL)
+    {
+        return e_failure;
+    }
+    int fields = fscanf(fptr, "%31s %ld %ld %ld %ld %u %ld %ld %u", magic,
+                        &journal->src_size, &journal->src_mtime, &journal->secret_size, &journal->secret_mtime,
+                        &journal->flags, &journal->out_offset, &journal->secret_offset, &journal->phase);
+    fclose(fptr);
+    if (fields != 9 || strcmp(magic, JOURNAL_MAGIC))
+    {
+        return e_failure;
+    }
+    return e_success;
+}
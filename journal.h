@@ -0,0 +1,43 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "types.h" // Contains user defined types
+
+/*
+ * This header file defines the encode journal used for resumable encoding.
+ *
+ * The stego image is written to "<output>.part". Every checkpoint flushes
+ * and syncs that file, then records the committed output offset in
+ * "<output>.journal" (written to a temporary name and renamed, so the
+ * journal is always complete). On success the part file is renamed to the
+ * output and the journal removed.
+ */
+
+#define JOURNAL_MAGIC "stego-journal-1"     // First word of every journal
+#define CHECKPOINT_INTERVAL (4L << 20)      // Output bytes between checkpoints
+#define PART_SUFFIX ".part"                 // Suffix of the file being written
+#define JOURNAL_SUFFIX ".journal"           // Suffix of the journal
+
+/*
+ * Structure: EncodeJournal
+ * Purpose: Everything needed to continue an interrupted encode.
+ */
+typedef struct _EncodeJournal
+{
+    long src_size;          // Size of the cover, to detect a changed input
+    long src_mtime;         // Modification time of the cover
+    long secret_size;       // Size of the secret file
+    long secret_mtime;      // Modification time of the secret file
+    uint flags;             // Option flags (FLAG_*) of the encode
+    long out_offset;        // Bytes of the part file that are committed
+    long secret_offset;     // Secret bytes embedded before out_offset
+    uint phase;             // Carrier group phase at out_offset
+} EncodeJournal;
+
+/* Write the journal atomically */
+Status journal_write(const char *fname, const EncodeJournal *journal);
+
+/* Read a journal; fails when missing or malformed */
+Status journal_read(const char *fname, EncodeJournal *journal);
+
+#endif
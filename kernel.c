@@ -0,0 +1,308 @@
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "types.h"
+#include "encode.h"
+#include "decode.h"
+#include "kernel.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#define LSB_LANES 0x0101010101010101ULL     // Bit 0 of every byte of a word
+#define BIT_SELECT 0x0102040810204080ULL    // Bit 7 - i in byte i
+
+static uint64_t spread_table[256];      // Byte -> its bits in the LSBs of 8 bytes, MSB first
+static unsigned char reverse_table[256]; // Byte with its bit order reversed
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+// Function to build the lookup tables
+static void kernel_build_tables(void)
+{
+    for (uint b = 0; b < 256; b++)
+    {
+        uint64_t spread = 0;
+        unsigned char reversed = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            spread |= (uint64_t)((b >> (7 - i)) & 1) << (8 * i);
+            reversed |= ((b >> i) & 1) << (7 - i);
+        }
+        spread_table[b] = spread;
+        reverse_table[b] = reversed;
+    }
+}
+
+// Function to load 8 samples as a little-endian word
+static inline uint64_t load_word(const unsigned char *p)
+{
+    uint64_t w;
+    memcpy(&w, p, 8);
+    return w;
+}
+
+// Function to store a word as 8 samples
+static inline void store_word(unsigned char *p, uint64_t w)
+{
+    memcpy(p, &w, 8);
+}
+
+// Function to embed with the original byte kernel
+static void embed_scalar(const unsigned char *data, uint len, unsigned char *samples)
+{
+    for (uint i = 0; i < len; i++)
+    {
+        encode_byte_to_lsb(data[i], (char *)samples + 8 * i);
+    }
+}
+
+// Function to extract with the original byte kernel
+static void extract_scalar(const unsigned char *samples, uint len, unsigned char *data)
+{
+    for (uint i = 0; i < len; i++)
+    {
+        data[i] = decode_lsb_to_byte((char *)samples + 8 * i);
+    }
+}
+
+// Function to embed one byte per 8-byte word through the spread table
+static void embed_table(const unsigned char *data, uint len, unsigned char *samples)
+{
+    pthread_once(&kernel_once, kernel_build_tables);
+    for (uint i = 0; i < len; i++)
+    {
+        uint64_t w = load_word(samples + 8 * i);
+        store_word(samples + 8 * i, (w & ~LSB_LANES) | spread_table[data[i]]);
+    }
+}
+
+// Function to extract by folding the LSBs together and reversing them
+static void extract_table(const unsigned char *samples, uint len, unsigned char *data)
+{
+    pthread_once(&kernel_once, kernel_build_tables);
+    for (uint i = 0; i < len; i++)
+    {
+        // Bit i of the low byte ends up holding the LSB of sample i
+        uint64_t w = load_word(samples + 8 * i) & LSB_LANES;
+        w |= w >> 7;
+        w |= w >> 14;
+        w |= w >> 28;
+        data[i] = reverse_table[w & 0xFF];
+    }
+}
+
+// Function to embed with word arithmetic only
+static void embed_swar(const unsigned char *data, uint len, unsigned char *samples)
+{
+    for (uint i = 0; i < len; i++)
+    {
+        // Copy the byte to every lane, keep bit 7 - i in lane i, then turn it into 0 / 1
+        uint64_t bits = (data[i] * LSB_LANES) & BIT_SELECT;
+        bits = ((bits + 0x7F7F7F7F7F7F7F7FULL) >> 7) & LSB_LANES;
+        uint64_t w = load_word(samples + 8 * i);
+        store_word(samples + 8 * i, (w & ~LSB_LANES) | bits);
+    }
+}
+
+// Function to extract with word arithmetic only
+static void extract_swar(const unsigned char *samples, uint len, unsigned char *data)
+{
+    for (uint i = 0; i < len; i++)
+    {
+        // The multiply moves the LSB of lane i to bit 63 - i without carries into the top byte
+        uint64_t w = load_word(samples + 8 * i) & LSB_LANES;
+        data[i] = (w * 0x8040201008040201ULL) >> 56;
+    }
+}
+
+#ifdef __SSE2__
+// Function to embed two bytes per 16 samples with SSE2
+static void embed_sse2(const unsigned char *data, uint len, unsigned char *samples)
+{
+    const __m128i select = _mm_set1_epi64x(BIT_SELECT);
+    const __m128i one = _mm_set1_epi8(1);
+    uint i = 0;
+    for (; i + 2 <= len; i += 2)
+    {
+        // Byte i in lanes 0-7, byte i + 1 in lanes 8-15
+        __m128i bytes = _mm_set_epi64x(data[i + 1] * LSB_LANES, data[i] * LSB_LANES);
+        __m128i bits = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(bytes, select), select), one);
+        __m128i s = _mm_loadu_si128((const __m128i *)(samples + 8 * i));
+        s = _mm_or_si128(_mm_andnot_si128(one, s), bits);
+        _mm_storeu_si128((__m128i *)(samples + 8 * i), s);
+    }
+    embed_swar(data + i, len - i, samples + 8 * i);
+}
+
+// Function to extract two bytes per 16 samples with SSE2
+static void extract_sse2(const unsigned char *samples, uint len, unsigned char *data)
+{
+    pthread_once(&kernel_once, kernel_build_tables);
+    uint i = 0;
+    for (; i + 2 <= len; i += 2)
+    {
+        // Move every LSB to the sign bit, then collect the sign bits
+        __m128i s = _mm_loadu_si128((const __m128i *)(samples + 8 * i));
+        uint mask = _mm_movemask_epi8(_mm_slli_epi64(s, 7));
+        data[i] = reverse_table[mask & 0xFF];
+        data[i + 1] = reverse_table[mask >> 8];
+    }
+    extract_swar(samples + 8 * i, len - i, data + i);
+}
+#endif
+
+#ifdef __AVX2__
+// Function to embed four bytes per 32 samples with AVX2
+static void embed_avx2(const unsigned char *data, uint len, unsigned char *samples)
+{
+    const __m256i select = _mm256_set1_epi64x(BIT_SELECT);
+    const __m256i one = _mm256_set1_epi8(1);
+    uint i = 0;
+    for (; i + 4 <= len; i += 4)
+    {
+        __m256i bytes = _mm256_set_epi64x(data[i + 3] * LSB_LANES, data[i + 2] * LSB_LANES,
+                                          data[i + 1] * LSB_LANES, data[i] * LSB_LANES);
+        __m256i bits = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(bytes, select), select), one);
+        __m256i s = _mm256_loadu_si256((const __m256i *)(samples + 8 * i));
+        s = _mm256_or_si256(_mm256_andnot_si256(one, s), bits);
+        _mm256_storeu_si256((__m256i *)(samples + 8 * i), s);
+    }
+    embed_swar(data + i, len - i, samples + 8 * i);
+}
+
+// Function to extract four bytes per 32 samples with AVX2
+static void extract_avx2(const unsigned char *samples, uint len, unsigned char *data)
+{
+    pthread_once(&kernel_once, kernel_build_tables);
+    uint i = 0;
+    for (; i + 4 <= len; i += 4)
+    {
+        __m256i s = _mm256_loadu_si256((const __m256i *)(samples + 8 * i));
+        uint mask = _mm256_movemask_epi8(_mm256_slli_epi64(s, 7));
+        for (int j = 0; j < 4; j++)
+        {
+            data[i + j] = reverse_table[(mask >> (8 * j)) & 0xFF];
+        }
+    }
+    extract_swar(samples + 8 * i, len - i, data + i);
+}
+#endif
+
+// Function to embed k bits per sample, one bit at a time (reference)
+static inline void embed_kbit_scalar(const unsigned char *data, uint len, unsigned char *samples, uint k)
+{
+    long bit = 0;
+    for (uint i = 0; i < len; i++)
+    {
+        for (int b = 7; b >= 0; b--, bit++)
+        {
+            // Bits fill a sample from its bit k - 1 down to bit 0
+            unsigned char *s = &samples[bit / k];
+            uint pos = k - 1 - bit % k;
+            *s = (*s & ~(1u << pos)) | (((data[i] >> b) & 1) << pos);
+        }
+    }
+}
+
+// Function to extract k bits per sample, one bit at a time (reference)
+static inline void extract_kbit_scalar(const unsigned char *samples, uint len, unsigned char *data, uint k)
+{
+    long bit = 0;
+    for (uint i = 0; i < len; i++)
+    {
+        unsigned char ch = 0;
+        for (int b = 7; b >= 0; b--, bit++)
+        {
+            ch |= ((samples[bit / k] >> (k - 1 - bit % k)) & 1) << b;
+        }
+        data[i] = ch;
+    }
+}
+
+// Function to embed k bits per sample, a whole field at a time
+static inline void embed_kbit_shift(const unsigned char *data, uint len, unsigned char *samples, uint k)
+{
+    const unsigned char mask = (1u << k) - 1;
+    const uint per_byte = 8 / k;
+    for (uint i = 0; i < len; i++)
+    {
+        for (uint j = 0; j < per_byte; j++)
+        {
+            unsigned char *s = &samples[i * per_byte + j];
+            *s = (*s & ~mask) | ((data[i] >> (8 - k * (j + 1))) & mask);
+        }
+    }
+}
+
+// Function to extract k bits per sample, a whole field at a time
+static inline void extract_kbit_shift(const unsigned char *samples, uint len, unsigned char *data, uint k)
+{
+    const unsigned char mask = (1u << k) - 1;
+    const uint per_byte = 8 / k;
+    for (uint i = 0; i < len; i++)
+    {
+        unsigned char ch = 0;
+        for (uint j = 0; j < per_byte; j++)
+        {
+            ch = (ch << k) | (samples[i * per_byte + j] & mask);
+        }
+        data[i] = ch;
+    }
+}
+
+/* Fixed depth wrappers, so the compiler can specialise the loops */
+static void embed_k2_scalar(const unsigned char *d, uint n, unsigned char *s) { embed_kbit_scalar(d, n, s, 2); }
+static void extract_k2_scalar(const unsigned char *s, uint n, unsigned char *d) { extract_kbit_scalar(s, n, d, 2); }
+static void embed_k2_shift(const unsigned char *d, uint n, unsigned char *s) { embed_kbit_shift(d, n, s, 2); }
+static void extract_k2_shift(const unsigned char *s, uint n, unsigned char *d) { extract_kbit_shift(s, n, d, 2); }
+static void embed_k4_scalar(const unsigned char *d, uint n, unsigned char *s) { embed_kbit_scalar(d, n, s, 4); }
+static void extract_k4_scalar(const unsigned char *s, uint n, unsigned char *d) { extract_kbit_scalar(s, n, d, 4); }
+static void embed_k4_shift(const unsigned char *d, uint n, unsigned char *s) { embed_kbit_shift(d, n, s, 4); }
+static void extract_k4_shift(const unsigned char *s, uint n, unsigned char *d) { extract_kbit_shift(s, n, d, 4); }
+
+/* Registered kernels; the first of each depth is the reference */
+const LsbKernel lsb_kernels[] =
+{
+    { "scalar", 1, embed_scalar, extract_scalar },
+    { "table", 1, embed_table, extract_table },
+    { "swar", 1, embed_swar, extract_swar },
+#ifdef __SSE2__
+    { "sse2", 1, embed_sse2, extract_sse2 },
+#endif
+#ifdef __AVX2__
+    { "avx2", 1, embed_avx2, extract_avx2 },
+#endif
+    { "scalar-k2", 2, embed_k2_scalar, extract_k2_scalar },
+    { "shift-k2", 2, embed_k2_shift, extract_k2_shift },
+    { "scalar-k4", 4, embed_k4_scalar, extract_k4_scalar },
+    { "shift-k4", 4, embed_k4_shift, extract_k4_shift },
+};
+
+const uint lsb_kernel_count = sizeof(lsb_kernels) / sizeof(lsb_kernels[0]);
+
+// Function to embed a block with the fastest 1-bit kernel
+void lsb_embed_block(const unsigned char *data, uint len, unsigned char *samples)
+{
+#if defined(__AVX2__)
+    embed_avx2(data, len, samples);
+#elif defined(__SSE2__)
+    embed_sse2(data, len, samples);
+#else
+    embed_swar(data, len, samples);
+#endif
+}
+
+// Function to extract a block with the fastest 1-bit kernel
+void lsb_extract_block(const unsigned char *samples, uint len, unsigned char *data)
+{
+#if defined(__AVX2__)
+    extract_avx2(samples, len, data);
+#elif defined(__SSE2__)
+    extract_sse2(samples, len, data);
+#else
+    extract_swar(samples, len, data);
+#endif
+}
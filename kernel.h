@@ -0,0 +1,54 @@
+#ifndef KERNEL_H
+#define KERNEL_H
+
+#include "types.h" // Contains user defined types
+
+/*
+ * This header file defines the block LSB kernels. They embed or extract a
+ * run of payload bytes in one call, MSB first, exactly like
+ * encode_byte_to_lsb / decode_lsb_to_byte do one byte at a time.
+ *
+ * Every kernel is registered in lsb_kernels[] together with the scalar
+ * reference of its bit depth, so the benchmark (-b) can time them side by
+ * side and prove they produce bit-identical output.
+ */
+
+/*
+ * Structure: LsbKernel
+ * Purpose: One implementation of the embed / extract pair.
+ */
+typedef struct _LsbKernel
+{
+    const char *name;   // Variant name for reports
+    uint bits;          // Payload bits per sample (1, 2 or 4)
+    void (*embed)(const unsigned char *data, uint len, unsigned char *samples);  // len bytes into len * 8 / bits samples
+    void (*extract)(const unsigned char *samples, uint len, unsigned char *data); // len bytes from len * 8 / bits samples
+} LsbKernel;
+
+/* Every compiled kernel; the first one of each bit depth is its reference */
+extern const LsbKernel lsb_kernels[];
+extern const uint lsb_kernel_count;
+
+/*
+ * Function: lsb_embed_block
+ * Purpose: Embeds len bytes into the LSBs of len * 8 samples with the
+ *          fastest 1-bit kernel of this build.
+ * Inputs:
+ *  - data: Payload bytes.
+ *  - len: Number of payload bytes.
+ *  - samples: Carrier samples, modified in place.
+ */
+void lsb_embed_block(const unsigned char *data, uint len, unsigned char *samples);
+
+/*
+ * Function: lsb_extract_block
+ * Purpose: Extracts len bytes from the LSBs of len * 8 samples with the
+ *          fastest 1-bit kernel of this build.
+ * Inputs:
+ *  - samples: Carrier samples.
+ *  - len: Number of payload bytes.
+ *  - data: Receives the payload bytes.
+ */
+void lsb_extract_block(const unsigned char *samples, uint len, unsigned char *data);
+
+#endif
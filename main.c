@@ -3,6 +3,14 @@
 #include "encode.h"
 #include "types.h"
 #include "decode.h"
+#include "archive.h"
+#include "quality.h"
+#include "analysis.h"
+#include "bench.h"
+#include "worker.h"
+#include "fanout.h"
+#include "plane.h"
+#include "watch.h"
 
 // Main function
 int main(int argc, char *argv[])
@@ -10,13 +18,26 @@ int main(int argc, char *argv[])
     // Structures to hold encoding and decoding information
     EncodeInfo encInfo;
     DecodeInfo decInfo;
+    ArchiveInfo arcInfo;
+    QualityReport report;
 
     // Validate command-line arguments
     if(argc < 2)
     {
         // Print usage instructions if arguments are insufficient
-        printf("%s: Encoding: %s -e <.bmp file> <.txt file> [output file]\n", argv[0], argv[0]);
-        printf("%s: Decoding: %s -d <.bmp file> [output file]\n", argv[0], argv[0]);
+        printf("%s: Encoding: %s -e <carrier> <.txt file> [output file] [--fec] [--channels BGR] [--resume] [--threads N] [--cache <dir> [--cache-size MiB]]\n", argv[0], argv[0]);
+        printf("%s: Encoding: %s -e --synthetic-cover <WxH[:seed]> <.txt file> [output .bmp] [--fec] [--channels BGR] [--resume] [--cache <dir> [--cache-size MiB]]\n", argv[0], argv[0]);
+        printf("%s: Decoding: %s -d <carrier> [output file] [--magic <string>] [--auto] [--threads N] [--cache <dir> [--cache-size MiB]]\n", argv[0], argv[0]);
+        printf("%s: Archive : %s -a <carrier> <output> <file1> [file2 ...]\n", argv[0], argv[0]);
+        printf("%s: Fan-out : %s -f <carrier> <.txt file> <output> [<.txt file> <output> ...] [--fec]\n", argv[0], argv[0]);
+        printf("%s: Extract : %s -d <carrier> --extract <name> [output file]\n", argv[0], argv[0]);
+        printf("%s: Range   : %s -d <carrier> --range <offset:length> [output file]\n", argv[0], argv[0]);
+        printf("%s: Compare : %s -c <cover> <stego>\n", argv[0], argv[0]);
+        printf("%s: Plane   : %s -p export <carrier> <plane.lsbp> | -p import <cover> <plane.lsbp> <output>\n", argv[0], argv[0]);
+        printf("%s: Analyse : %s -s [--threads N] <file> [file ...]\n", argv[0], argv[0]);
+        printf("%s: Bench   : %s -b [--rounds N] [--seed N]\n", argv[0], argv[0]);
+        printf("%s: Worker  : %s -w <spool dir> [--id name] [--lease seconds] [--exit-when-idle]\n", argv[0], argv[0]);
+        printf("%s: Watch   : %s -m <watch dir> <target dir> [--workers N] [--exit-after N] -e <.txt file> [options] | -d [options]\n", argv[0], argv[0]);
         return e_failure;
     }
 
@@ -29,7 +50,7 @@ int main(int argc, char *argv[])
         // Ensure there are enough arguments for encoding
         if(argc < 4)
         {
-            printf("%s: Encoding: %s -e <.bmp file> <.txt file> [output file]\n", argv[0], argv[0]);
+            printf("%s: Encoding: %s -e <carrier> <.txt file> [output file] [--fec] [--channels BGR] [--resume] [--threads N] [--cache <dir> [--cache-size MiB]]\n", argv[0], argv[0]);
             return e_failure;
         }
 
@@ -53,7 +74,7 @@ int main(int argc, char *argv[])
         // Ensure there are enough arguments for decoding
         if(argc < 3)
         {
-            printf("%s: Decoding: %s -d <.bmp file> [output file]\n", argv[0], argv[0]);
+            printf("%s: Decoding: %s -d <carrier> [output file] [--magic <string>] [--auto] [--threads N] [--cache <dir> [--cache-size MiB]]\n", argv[0], argv[0]);
             return e_failure;
         }
 
@@ -67,10 +88,134 @@ int main(int argc, char *argv[])
         // Perform decoding
         if(do_decoding(&decInfo) == e_failure)
         {
+            close_decode_files(&decInfo);
             printf("Error during decoding.\n");
             return e_failure;
         }
     }
+    // Check if the operation is archive embedding
+    else if(op_type == e_archive)
+    {
+        // Ensure there is at least one file to embed
+        if(argc < 5)
+        {
+            printf("%s: Archive : %s -a <carrier> <output> <file1> [file2 ...]\n", argv[0], argv[0]);
+            return e_failure;
+        }
+
+        // Read and validate archive arguments
+        if(read_and_validate_archive_args(argc, argv, &arcInfo) == e_failure)
+        {
+            printf("Error validating arguments for archive embedding.\n");
+            return e_failure;
+        }
+
+        // Perform archive embedding
+        if(do_archive_encoding(&arcInfo) == e_failure)
+        {
+            printf("Error during archive embedding.\n");
+            return e_failure;
+        }
+    }
+    // Check if the operation is fan-out encoding
+    else if(op_type == e_fanout)
+    {
+        // Ensure there is at least one secret and output pair
+        if(argc < 5)
+        {
+            printf("%s: Fan-out : %s -f <carrier> <.txt file> <output> [<.txt file> <output> ...] [--fec]\n", argv[0], argv[0]);
+            return e_failure;
+        }
+
+        // Read the cover once for every output
+        if(do_fanout_encoding(argc, argv) == e_failure)
+        {
+            printf("Error during fan-out encoding.\n");
+            return e_failure;
+        }
+    }
+    // Check if the operation is a cover-vs-stego comparison
+    else if(op_type == e_compare)
+    {
+        // Ensure both files are given
+        if(argc < 4)
+        {
+            printf("%s: Compare : %s -c <cover> <stego>\n", argv[0], argv[0]);
+            return e_failure;
+        }
+
+        // Stream both files and report the distortion
+        if(compare_carriers(argv[2], argv[3], &report) == e_failure)
+        {
+            printf("Error during comparison.\n");
+            return e_failure;
+        }
+        print_quality_report(&report);
+    }
+    // Check if the operation is a bit plane export or import
+    else if(op_type == e_plane)
+    {
+        // Pack or unpack the LSBs of a carrier
+        if(do_bitplane(argc, argv) == e_failure)
+        {
+            printf("Error during bit plane %s.\n", (argc > 2) ? argv[2] : "operation");
+            return e_failure;
+        }
+    }
+    // Check if the operation is steganalysis
+    else if(op_type == e_analyse)
+    {
+        // Analyse every file and print one line each
+        if(do_analysis(argc, argv) == e_failure)
+        {
+            printf("Error during analysis.\n");
+            return e_failure;
+        }
+    }
+    // Check if the operation is the kernel benchmark
+    else if(op_type == e_bench)
+    {
+        // Verify every kernel against the reference, then time them
+        if(do_benchmark(argc, argv) == e_failure)
+        {
+            printf("Error during benchmark.\n");
+            return e_failure;
+        }
+    }
+    // Check if the operation is the spool worker
+    else if(op_type == e_worker)
+    {
+        // Ensure the spool directory is given
+        if(argc < 3)
+        {
+            printf("%s: Worker  : %s -w <spool dir> [--id name] [--lease seconds] [--exit-when-idle]\n", argv[0], argv[0]);
+            return e_failure;
+        }
+
+        // Claim and run jobs until stopped
+        if(do_worker(argc, argv) == e_failure)
+        {
+            printf("Error in worker.\n");
+            return e_failure;
+        }
+    }
+    // Check if the operation is the watch folder
+    else if(op_type == e_watch)
+    {
+        // Ensure the directories and the command are given
+        if(argc < 5)
+        {
+            printf("%s: Watch   : %s -m <watch dir> <target dir> [--workers N] [--exit-after N] -e <.txt file> [options] | -d [options]\n", argv[0], argv[0]);
+            return e_failure;
+        }
+
+        // Process files as they arrive until stopped
+        if(do_watch(argc, argv) == e_failure)
+        {
+            printf("Error in watch folder.\n");
+            return e_failure;
+        }
+    }
     else
     {
         // Handle unsupported operation types
@@ -94,7 +239,47 @@ OperationType check_operation_type(char *argv)
     {
         return e_decode;
     }
-    // Step 5: Return unsupported operation for any other input
+    // Step 5: Compare argument with "-a" for archive embedding
+    else if(!strcmp(argv, "-a"))
+    {
+        return e_archive;
+    }
+    // Step 7: Compare argument with "-c" for comparison
+    else if(!strcmp(argv, "-c"))
+    {
+        return e_compare;
+    }
+    // Step 9: Compare argument with "-s" for steganalysis
+    else if(!strcmp(argv, "-s"))
+    {
+        return e_analyse;
+    }
+    // Step 11: Compare argument with "-b" for the kernel benchmark
+    else if(!strcmp(argv, "-b"))
+    {
+        return e_bench;
+    }
+    // Step 13: Compare argument with "-w" for the spool worker
+    else if(!strcmp(argv, "-w"))
+    {
+        return e_worker;
+    }
+    // Step 15: Compare argument with "-f" for fan-out encoding
+    else if(!strcmp(argv, "-f"))
+    {
+        return e_fanout;
+    }
+    // Step 17: Compare argument with "-p" for bit plane export / import
+    else if(!strcmp(argv, "-p"))
+    {
+        return e_plane;
+    }
+    // Step 19: Compare argument with "-m" for the watch folder
+    else if(!strcmp(argv, "-m"))
+    {
+        return e_watch;
+    }
+    // Step 21: Return unsupported operation for any other input
     else
     {
         return e_unsupported;
@@ -0,0 +1,389 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "types.h"
+#include "carrier.h"
+#include "kernel.h"
+#include "encode.h"
+#include "plane.h"
+
+#define PLANE_CHUNK 4096    // Packed bytes unpacked per read
+
+/* State of one plane opened with plane_fopen */
+typedef struct _PlaneStream
+{
+    int fd;                                     // Packed plane file
+    unsigned char header[PLANE_HEADER_SIZE];    // Header as served, with the stream magic
+    long pos;                                   // Current stream offset
+    long size;                                  // Header plus one byte per sample
+} PlaneStream;
+
+// Function to store a little-endian value of n bytes
+static void write_le(unsigned char *p, uint value, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        p[i] = value >> (8 * i);
+    }
+}
+
+// Function to read a little-endian value of n bytes
+static uint read_le(const unsigned char *p, int n)
+{
+    uint value = 0;
+    for (int i = n - 1; i >= 0; i--)
+    {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+// Function to check a plane header against the size of its file
+static Status check_plane_header(const unsigned char *header, long file_size, uint *samples)
+{
+    if (memcmp(header, PLANE_MAGIC, 4) || header[4] != PLANE_VERSION ||
+        header[5] == 0 || header[5] > PLANE_MAX_NAMES || read_le(header + 28, 4) != 0)
+    {
+        return e_failure;
+    }
+    *samples = read_le(header + 24, 4);
+    if (*samples == 0 || file_size < PLANE_HEADER_SIZE + ((long)*samples + 7) / 8)
+    {
+        return e_failure;
+    }
+    return e_success;
+}
+
+// Function to write the packed LSB plane of a carrier
+Status plane_export(const char *carrier_fname, const char *plane_fname)
+{
+    CarrierInfo carrier;
+    unsigned char header[PLANE_HEADER_SIZE] = { 0 };
+
+    FILE *fptr_src = fopen(carrier_fname, "r");
+    if (fptr_src == NULL)
+    {
+        perror("fopen");
+        return e_failure;
+    }
+    if (carrier_open(fptr_src, &carrier) == e_failure || carrier.lanes > PLANE_MAX_NAMES)
+    {
+        fclose(fptr_src);
+        return e_failure;
+    }
+    FILE *fptr_plane = fopen(plane_fname, "w");
+    if (fptr_plane == NULL)
+    {
+        perror("fopen");
+        fclose(fptr_src);
+        return e_failure;
+    }
+
+    // One lane per channel, so the letters of the lanes are the channel letters
+    memcpy(header, PLANE_MAGIC, 4);
+    header[4] = PLANE_VERSION;
+    header[5] = carrier.lanes;
+    header[6] = carrier.row_padding;
+    memcpy(header + 8, carrier.channel_names, carrier.lanes);
+    write_le(header + 16, carrier.width, 4);
+    write_le(header + 20, carrier.height, 4);
+    write_le(header + 24, carrier.capacity, 4);
+    fwrite(header, PLANE_HEADER_SIZE, 1, fptr_plane);
+
+    unsigned char *samples = malloc(PLANE_BLOCK_GROUPS * MAX_CARRIER_GROUP);
+    unsigned char *packed = malloc(PLANE_BLOCK_GROUPS * MAX_CARRIER_GROUP / 8 + 1);
+    Status status = (samples != NULL && packed != NULL) ? e_success : e_failure;
+
+    // Read whole groups and pack eight sample LSBs per byte with the extract kernel
+    uint groups_left = carrier.capacity / carrier.lanes;
+    while (status == e_success && groups_left > 0)
+    {
+        uint want = (groups_left < PLANE_BLOCK_GROUPS) ? groups_left : PLANE_BLOCK_GROUPS;
+        if (carrier_read_block(&carrier, fptr_src, samples, want) != want)
+        {
+            fprintf(stderr, "ERROR: %s is truncated\n", carrier_fname);
+            status = e_failure;
+            break;
+        }
+        uint count = want * carrier.lanes;
+        uint bytes = count / 8;
+        lsb_extract_block(samples, bytes, packed);
+
+        // The last byte of the plane is padded with zero bits
+        if (count % 8)
+        {
+            unsigned char tail[8] = { 0 };
+            memcpy(tail, samples + bytes * 8, count % 8);
+            lsb_extract_block(tail, 1, packed + bytes++);
+        }
+        if (fwrite(packed, 1, bytes, fptr_plane) != bytes)
+        {
+            status = e_failure;
+        }
+        groups_left -= want;
+    }
+
+    free(samples);
+    free(packed);
+    fclose(fptr_src);
+    if (fclose(fptr_plane) || status == e_failure)
+    {
+        return e_failure;
+    }
+    printf("INFO: Exported %u samples of %s to %s (%u bytes).\n", carrier.capacity, carrier_fname, plane_fname,
+           PLANE_HEADER_SIZE + (carrier.capacity + 7) / 8);
+    return e_success;
+}
+
+// Function to write a packed plane into the LSBs of a cover
+Status plane_import(const char *cover_fname, const char *plane_fname, const char *output_fname)
+{
+    CarrierInfo carrier;
+    unsigned char header[PLANE_HEADER_SIZE];
+    struct stat st;
+    uint samples_total;
+
+    FILE *fptr_src = fopen(cover_fname, "r");
+    FILE *fptr_plane = fopen(plane_fname, "r");
+    if (fptr_src == NULL || fptr_plane == NULL)
+    {
+        perror("fopen");
+        if (fptr_src != NULL)
+        {
+            fclose(fptr_src);
+        }
+        if (fptr_plane != NULL)
+        {
+            fclose(fptr_plane);
+        }
+        return e_failure;
+    }
+
+    // The plane must come from a carrier of exactly this layout
+    Status status = carrier_open(fptr_src, &carrier);
+    fstat(fileno(fptr_plane), &st);
+    if (status == e_success &&
+        (fread(header, PLANE_HEADER_SIZE, 1, fptr_plane) != 1 || check_plane_header(header, st.st_size, &samples_total) == e_failure))
+    {
+        fprintf(stderr, "ERROR: %s is not a bit plane\n", plane_fname);
+        status = e_failure;
+    }
+    else if (status == e_success && (samples_total != carrier.capacity || header[5] != carrier.lanes ||
+             strncmp((char *)header + 8, carrier.channel_names, carrier.lanes)))
+    {
+        fprintf(stderr, "ERROR: the plane holds %u samples of %.*s, the cover %u samples of %.*s\n", samples_total,
+                header[5], (char *)header + 8, carrier.capacity, carrier.lanes, carrier.channel_names);
+        status = e_failure;
+    }
+    FILE *fptr_out = NULL;
+    if (status == e_success && (fptr_out = fopen(output_fname, "w")) == NULL)
+    {
+        perror("fopen");
+        status = e_failure;
+    }
+    if (status == e_failure)
+    {
+        fclose(fptr_src);
+        fclose(fptr_plane);
+        return e_failure;
+    }
+    carrier_copy_header(&carrier, fptr_src, fptr_out);
+
+    unsigned char *raw = malloc(PLANE_BLOCK_GROUPS * MAX_CARRIER_GROUP);
+    unsigned char *samples = malloc(PLANE_BLOCK_GROUPS * MAX_CARRIER_GROUP);
+    unsigned char *packed = malloc(PLANE_BLOCK_GROUPS * MAX_CARRIER_GROUP / 8 + 1);
+    status = (raw != NULL && samples != NULL && packed != NULL) ? e_success : e_failure;
+
+    uint groups_left = carrier.capacity / carrier.lanes;
+    while (status == e_success && groups_left > 0)
+    {
+        uint want = (groups_left < PLANE_BLOCK_GROUPS) ? groups_left : PLANE_BLOCK_GROUPS;
+        uint count = want * carrier.lanes;
+        uint bytes = (count + 7) / 8;
+        if (fread(raw, carrier.group_size, want, fptr_src) != want || fread(packed, 1, bytes, fptr_plane) != bytes)
+        {
+            fprintf(stderr, "ERROR: %s is truncated\n", cover_fname);
+            status = e_failure;
+            break;
+        }
+
+        // Gather the payload carrying bytes of the groups
+        carrier_gather(&carrier, raw, want, samples);
+
+        // Set eight sample LSBs per plane byte with the embed kernel, the padded last byte through a copy
+        lsb_embed_block(packed, count / 8, samples);
+        if (count % 8)
+        {
+            unsigned char tail[8] = { 0 };
+            memcpy(tail, samples + count / 8 * 8, count % 8);
+            lsb_embed_block(packed + count / 8, 1, tail);
+            memcpy(samples + count / 8 * 8, tail, count % 8);
+        }
+
+        // Scatter them back and write the groups
+        carrier_scatter(&carrier, samples, want, raw);
+        if (fwrite(raw, carrier.group_size, want, fptr_out) != want)
+        {
+            status = e_failure;
+        }
+        groups_left -= want;
+    }
+
+    // Anything after the samples (padding, trailing chunks) is copied as it is
+    if (status == e_success)
+    {
+        status = copy_remaining_img_data(fptr_src, fptr_out);
+    }
+
+    free(raw);
+    free(samples);
+    free(packed);
+    fclose(fptr_src);
+    fclose(fptr_plane);
+    if (fclose(fptr_out) || status == e_failure)
+    {
+        return e_failure;
+    }
+    printf("INFO: Imported %u samples of %s into %s.\n", carrier.capacity, plane_fname, output_fname);
+    return e_success;
+}
+
+// Function to read from an unpacked plane
+static ssize_t plane_read(void *cookie, char *buf, size_t size)
+{
+    PlaneStream *plane = cookie;
+    unsigned char packed[PLANE_CHUNK];
+    size_t done = 0;
+
+    while (done < size && plane->pos < plane->size)
+    {
+        size_t n;
+        if (plane->pos < PLANE_HEADER_SIZE)
+        {
+            n = PLANE_HEADER_SIZE - plane->pos;
+            n = (n < size - done) ? n : size - done;
+            memcpy(buf + done, plane->header + plane->pos, n);
+        }
+        else
+        {
+            // Fetch the packed bytes covering the next run of bits and spread them out
+            long bit = plane->pos - PLANE_HEADER_SIZE;
+            uint first = bit % 8;
+            n = PLANE_CHUNK * 8 - first;
+            n = (n < size - done) ? n : size - done;
+            n = (n < (size_t)(plane->size - plane->pos)) ? n : (size_t)(plane->size - plane->pos);
+            size_t bytes = (first + n + 7) / 8;
+            if (pread(plane->fd, packed, bytes, PLANE_HEADER_SIZE + bit / 8) != (ssize_t)bytes)
+            {
+                return done ? (ssize_t)done : -1;
+            }
+            for (size_t i = 0; i < n; i++)
+            {
+                size_t b = first + i;
+                buf[done + i] = (packed[b / 8] >> (7 - b % 8)) & 1;
+            }
+        }
+        done += n;
+        plane->pos += n;
+    }
+    return done;
+}
+
+// Function to seek in an unpacked plane
+static int plane_seek(void *cookie, off64_t *offset, int whence)
+{
+    PlaneStream *plane = cookie;
+    long base = (whence == SEEK_SET) ? 0 : (whence == SEEK_CUR) ? plane->pos : plane->size;
+
+    if (base + *offset < 0)
+    {
+        return -1;
+    }
+    plane->pos = base + *offset;
+    *offset = plane->pos;
+    return 0;
+}
+
+// Function to close an unpacked plane
+static int plane_close(void *cookie)
+{
+    PlaneStream *plane = cookie;
+    close(plane->fd);
+    free(plane);
+    return 0;
+}
+
+// Function to open a carrier, unpacking packed planes as they are read
+FILE *plane_fopen(const char *fname)
+{
+    unsigned char header[PLANE_HEADER_SIZE];
+    struct stat st;
+    uint samples;
+
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    if (fstat(fd, &st) || pread(fd, header, PLANE_HEADER_SIZE, 0) != PLANE_HEADER_SIZE ||
+        check_plane_header(header, st.st_size, &samples) == e_failure)
+    {
+        // Not a plane, read the file as it is
+        close(fd);
+        return fopen(fname, "r");
+    }
+
+    PlaneStream *plane = calloc(1, sizeof(PlaneStream));
+    if (plane == NULL)
+    {
+        close(fd);
+        return NULL;
+    }
+    plane->fd = fd;
+    plane->size = PLANE_HEADER_SIZE + (long)samples;
+    memcpy(plane->header, header, PLANE_HEADER_SIZE);
+    memcpy(plane->header, PLANE_STREAM_MAGIC, 4);
+
+    cookie_io_functions_t io = { plane_read, NULL, plane_seek, plane_close };
+    FILE *fptr = fopencookie(plane, "r", io);
+    if (fptr == NULL)
+    {
+        plane_close(plane);
+    }
+    return fptr;
+}
+
+// Function to handle the -p operation
+Status do_bitplane(int argc, char *argv[])
+{
+    if (argc == 5 && strcmp(argv[2], "export") == 0)
+    {
+        const char *extn = strrchr(argv[4], '.');
+        if (extn == NULL || strcmp(extn, PLANE_EXTN))
+        {
+            printf("INFO: Validation Error. The plane file should be a %s file.\n", PLANE_EXTN);
+            return e_failure;
+        }
+        return plane_export(argv[3], argv[4]);
+    }
+    if (argc == 6 && strcmp(argv[2], "import") == 0)
+    {
+        // The output is a carrier of the same format as the cover
+        const char *src_extn = strrchr(argv[3], '.');
+        const char *out_extn = strrchr(argv[5], '.');
+        if (carrier_known_extn(src_extn) == e_failure || out_extn == NULL || strcmp(src_extn, out_extn) ||
+            strcmp(src_extn, PLANE_EXTN) == 0)
+        {
+            printf("INFO: Validation Error. The cover and output should both be .bmp, .ppm, .pgm or .wav files.\n");
+            return e_failure;
+        }
+        return plane_import(argv[3], argv[4], argv[5]);
+    }
+    printf("INFO: Validation Error. Use -p export <carrier> <plane%s> or -p import <cover> <plane> <output>.\n", PLANE_EXTN);
+    return e_failure;
+}
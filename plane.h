@@ -0,0 +1,78 @@
+#ifndef PLANE_H
+#define PLANE_H
+
+#include <stdio.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * This header file defines the packed LSB bit plane. Exporting a carrier
+ * keeps only the bit the decoder reads from every sample, eight samples to
+ * a byte, MSB first (the order payload bits are embedded in), so the plane
+ * is one eighth of the samples it was taken from. Skipped bytes (alpha,
+ * high audio bytes) are not part of the plane. The file is a 32-byte
+ * little-endian header followed by the packed bits:
+ *
+ *   0   "LSBP"
+ *   4   version (1), channels per group, row padding in samples, one reserved byte
+ *   8   channel letters, NUL padded
+ *   16  width, height of the source carrier
+ *   24  number of samples (bits)
+ *
+ * Decoding opens a plane with plane_fopen, which serves the header followed
+ * by one byte per bit, so the carrier layer sees it as a carrier whose
+ * every byte is a sample and all decode options work on it unchanged.
+ * Importing writes a plane back into the LSBs of a cover of the same layout.
+ */
+
+#define PLANE_EXTN ".lsbp"          // File extension of a packed plane
+#define PLANE_MAGIC "LSBP"          // First bytes of a packed plane
+#define PLANE_STREAM_MAGIC "LSBU"   // First bytes of a plane opened with plane_fopen
+#define PLANE_VERSION 1             // Header version written by this build
+#define PLANE_HEADER_SIZE 32        // Bytes before the packed bits
+#define PLANE_MAX_NAMES 8           // Channel letters in the header
+#define PLANE_BLOCK_GROUPS 8192     // Groups per block, a multiple of 8 so blocks end on whole bytes
+
+/*
+ * Function: plane_export
+ * Purpose: Writes the packed LSB plane of a carrier.
+ * Inputs:
+ *  - carrier_fname: Carrier to read.
+ *  - plane_fname: Plane file to create.
+ * Outputs:
+ *  - Returns e_success if the plane was written, otherwise e_failure.
+ */
+Status plane_export(const char *carrier_fname, const char *plane_fname);
+
+/*
+ * Function: plane_import
+ * Purpose: Replaces the LSBs of a cover with a packed plane.
+ * Inputs:
+ *  - cover_fname: Cover with the layout the plane was exported from.
+ *  - plane_fname: Plane to write into the cover.
+ *  - output_fname: Output carrier, same format as the cover.
+ * Outputs:
+ *  - Returns e_success if the output was written, otherwise e_failure.
+ */
+Status plane_import(const char *cover_fname, const char *plane_fname, const char *output_fname);
+
+/*
+ * Function: plane_fopen
+ * Purpose: Opens a carrier for reading; packed planes are unpacked as they are read.
+ * Inputs:
+ *  - fname: Carrier or plane file.
+ * Outputs:
+ *  - Returns a seekable read-only stream, or NULL on failure. Close it with fclose.
+ */
+FILE *plane_fopen(const char *fname);
+
+/*
+ * Function: do_bitplane
+ * Purpose: Handles "-p export <carrier> <plane>" and "-p import <cover> <plane> <output>".
+ * Inputs:
+ *  - argc, argv: Command-line arguments.
+ * Outputs:
+ *  - Returns e_success if the plane or output was written, otherwise e_failure.
+ */
+Status do_bitplane(int argc, char *argv[]);
+
+#endif
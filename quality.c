@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "types.h"
+#include "quality.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define QUALITY_BLOCK_GROUPS 16384  // Groups compared per block
+#define QUALITY_FLUSH_ROUNDS 255    // Vector rounds before the 8-bit counters could wrap
+
+// Function to accumulate the statistics of one channel over a block
+static void compare_channel(const unsigned char *cover, const unsigned char *stego, uint count, uint stride, ChannelQuality *q)
+{
+    unsigned long long squared = 0, flipped = 0, cover_ones = 0, stego_ones = 0;
+
+    // Branch free, so the compiler can keep it in vector registers
+    for (uint i = 0; i < count; i++)
+    {
+        int a = cover[i * stride];
+        int b = stego[i * stride];
+        int d = a - b;
+        squared += d * d;
+        flipped += (a ^ b) & 1;
+        cover_ones += a & 1;
+        stego_ones += b & 1;
+    }
+
+    q->samples += count;
+    q->squared_error += squared;
+    q->flipped_lsbs += flipped;
+    q->cover_ones += cover_ones;
+    q->stego_ones += stego_ones;
+}
+
+// Function to accumulate every channel of an interleaved block, one channel at a time
+static void compare_block_scalar(const unsigned char *cover, const unsigned char *stego, uint count, uint lanes, ChannelQuality *q)
+{
+    for (uint ch = 0; ch < lanes; ch++)
+    {
+        compare_channel(cover + ch, stego + ch, count, lanes, &q[ch]);
+    }
+}
+
+#ifdef __SSE2__
+// Function to accumulate every channel of an interleaved block with SSE2
+static void compare_block_sse2(const unsigned char *cover, const unsigned char *stego, uint count, uint lanes, ChannelQuality *q)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i even = _mm_set1_epi32(0xFFFF);
+    __m128i squared[MAX_CARRIER_GROUP][4], flipped[MAX_CARRIER_GROUP];
+    __m128i cover_ones[MAX_CARRIER_GROUP], stego_ones[MAX_CARRIER_GROUP];
+
+    // Sixteen groups fill lanes vectors, so byte b of vector v always belongs to channel (16 * v + b) % lanes
+    uint rounds = count / 16;
+    uint done = 0;
+    while (done < rounds)
+    {
+        uint chunk = (rounds - done < QUALITY_FLUSH_ROUNDS) ? rounds - done : QUALITY_FLUSH_ROUNDS;
+        for (uint v = 0; v < lanes; v++)
+        {
+            squared[v][0] = squared[v][1] = squared[v][2] = squared[v][3] = zero;
+            flipped[v] = cover_ones[v] = stego_ones[v] = zero;
+        }
+
+        for (uint r = 0; r < chunk; r++)
+        {
+            const unsigned char *c = cover + (size_t)(done + r) * 16 * lanes;
+            const unsigned char *s = stego + (size_t)(done + r) * 16 * lanes;
+            for (uint v = 0; v < lanes; v++)
+            {
+                __m128i a = _mm_loadu_si128((const __m128i *)(c + 16 * v));
+                __m128i b = _mm_loadu_si128((const __m128i *)(s + 16 * v));
+
+                // 16-bit differences; madd against a copy with every other value cleared squares each one on its own
+                __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+                __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+                squared[v][0] = _mm_add_epi32(squared[v][0], _mm_madd_epi16(lo, _mm_and_si128(lo, even)));
+                squared[v][1] = _mm_add_epi32(squared[v][1], _mm_madd_epi16(lo, _mm_andnot_si128(even, lo)));
+                squared[v][2] = _mm_add_epi32(squared[v][2], _mm_madd_epi16(hi, _mm_and_si128(hi, even)));
+                squared[v][3] = _mm_add_epi32(squared[v][3], _mm_madd_epi16(hi, _mm_andnot_si128(even, hi)));
+
+                flipped[v] = _mm_add_epi8(flipped[v], _mm_and_si128(_mm_xor_si128(a, b), one));
+                cover_ones[v] = _mm_add_epi8(cover_ones[v], _mm_and_si128(a, one));
+                stego_ones[v] = _mm_add_epi8(stego_ones[v], _mm_and_si128(b, one));
+            }
+        }
+
+        // Fold every byte position into its channel
+        for (uint v = 0; v < lanes; v++)
+        {
+            uint32_t sq[4][4];
+            unsigned char f[16], ca[16], sb[16];
+            for (int k = 0; k < 4; k++)
+            {
+                _mm_storeu_si128((__m128i *)sq[k], squared[v][k]);
+            }
+            _mm_storeu_si128((__m128i *)f, flipped[v]);
+            _mm_storeu_si128((__m128i *)ca, cover_ones[v]);
+            _mm_storeu_si128((__m128i *)sb, stego_ones[v]);
+            for (uint b = 0; b < 16; b++)
+            {
+                // sq[0] holds bytes 0, 2, 4, 6, sq[1] bytes 1, 3, 5, 7, sq[2] and sq[3] the same from byte 8
+                ChannelQuality *p = &q[(16 * v + b) % lanes];
+                p->squared_error += sq[((b >> 3) << 1) | (b & 1)][(b & 7) >> 1];
+                p->flipped_lsbs += f[b];
+                p->cover_ones += ca[b];
+                p->stego_ones += sb[b];
+            }
+        }
+        done += chunk;
+    }
+    for (uint ch = 0; ch < lanes; ch++)
+    {
+        q[ch].samples += rounds * 16;
+    }
+
+    // Groups left over after the last whole round
+    size_t offset = (size_t)rounds * 16 * lanes;
+    compare_block_scalar(cover + offset, stego + offset, count - rounds * 16, lanes, q);
+}
+#endif
+
+/* Registered variants; the first is the reference */
+const QualityKernel quality_kernels[] =
+{
+    { "scalar", compare_block_scalar },
+#ifdef __SSE2__
+    { "sse2", compare_block_sse2 },
+#endif
+};
+
+const uint quality_kernel_count = sizeof(quality_kernels) / sizeof(quality_kernels[0]);
+
+// Function to accumulate a block with the fastest variant of this build
+static void compare_block(const unsigned char *cover, const unsigned char *stego, uint count, uint lanes, ChannelQuality *q)
+{
+#ifdef __SSE2__
+    compare_block_sse2(cover, stego, count, lanes, q);
+#else
+    compare_block_scalar(cover, stego, count, lanes, q);
+#endif
+}
+
+// Function to derive MSE and PSNR from the accumulated sums
+static void finish_channel(ChannelQuality *q, uint sample_bits)
+{
+    double peak = (double)((1u << sample_bits) - 1);
+
+    q->mse = q->samples ? (double)q->squared_error / q->samples : 0.0;
+    q->psnr = (q->mse > 0.0) ? 10.0 * log10(peak * peak / q->mse) : 0.0;
+}
+
+// Function to compare cover and stego
+Status compare_carriers(const char *cover_fname, const char *stego_fname, QualityReport *report)
+{
+    static unsigned char cover[QUALITY_BLOCK_GROUPS * MAX_CARRIER_GROUP];
+    static unsigned char stego[QUALITY_BLOCK_GROUPS * MAX_CARRIER_GROUP];
+    CarrierInfo stego_carrier;
+    Status status = e_failure;
+
+    memset(report, 0, sizeof(QualityReport));
+
+    FILE *fptr_cover = fopen(cover_fname, "r");
+    FILE *fptr_stego = fopen(stego_fname, "r");
+    if (fptr_cover == NULL || fptr_stego == NULL)
+    {
+        perror("fopen");
+        fprintf(stderr, "ERROR: can't open file %s\n", fptr_cover == NULL ? cover_fname : stego_fname);
+        goto out;
+    }
+
+    // Both files must share one layout
+    if (carrier_open(fptr_cover, &report->carrier) == e_failure || carrier_open(fptr_stego, &stego_carrier) == e_failure)
+    {
+        goto out;
+    }
+    CarrierInfo *carrier = &report->carrier;
+
+    // Row padding belongs to no channel
+    carrier_skip_padding(carrier);
+    carrier_skip_padding(&stego_carrier);
+    if (carrier->backend != stego_carrier.backend || carrier->capacity != stego_carrier.capacity ||
+        carrier->group_size != stego_carrier.group_size || carrier->lane_mask != stego_carrier.lane_mask)
+    {
+        fprintf(stderr, "ERROR: %s and %s have different layouts\n", cover_fname, stego_fname);
+        goto out;
+    }
+
+    // Stream both sample arrays block by block
+    uint groups_left = carrier->capacity / carrier->lanes;
+    while (groups_left > 0)
+    {
+        uint want = (groups_left < QUALITY_BLOCK_GROUPS) ? groups_left : QUALITY_BLOCK_GROUPS;
+        uint got = carrier_read_block(carrier, fptr_cover, cover, want);
+        if (carrier_read_block(&stego_carrier, fptr_stego, stego, want) != got || got == 0)
+        {
+            fprintf(stderr, "ERROR: sample data is truncated\n");
+            goto out;
+        }
+
+        compare_block(cover, stego, got, carrier->lanes, report->channel);
+        groups_left -= got;
+    }
+
+    // Totals and derived values
+    for (uint ch = 0; ch < carrier->lanes; ch++)
+    {
+        ChannelQuality *q = &report->channel[ch];
+        finish_channel(q, carrier->sample_bits);
+        report->total.samples += q->samples;
+        report->total.squared_error += q->squared_error;
+        report->total.flipped_lsbs += q->flipped_lsbs;
+        report->total.cover_ones += q->cover_ones;
+        report->total.stego_ones += q->stego_ones;
+    }
+    finish_channel(&report->total, carrier->sample_bits);
+    status = e_success;
+
+out:
+    if (fptr_cover != NULL)
+    {
+        fclose(fptr_cover);
+    }
+    if (fptr_stego != NULL)
+    {
+        fclose(fptr_stego);
+    }
+    return status;
+}
+
+// Function to print one line of the report
+static void print_channel(const char *name, const ChannelQuality *q)
+{
+    char cover_hist[48], stego_hist[48];
+
+    sprintf(cover_hist, "%llu/%llu", q->samples - q->cover_ones, q->cover_ones);
+    sprintf(stego_hist, "%llu/%llu", q->samples - q->stego_ones, q->stego_ones);
+    printf("%-8s %12llu %12.6f ", name, q->samples, q->mse);
+    if (q->mse > 0.0)
+    {
+        printf("%10.2f ", q->psnr);
+    }
+    else
+    {
+        printf("%10s ", "inf");
+    }
+    printf("%12llu %25s %25s\n", q->flipped_lsbs, cover_hist, stego_hist);
+}
+
+// Function to print a quality report
+void print_quality_report(const QualityReport *report)
+{
+    char name[16];
+
+    printf("INFO: %s carrier, %u channels, %u-bit samples\n", report->carrier.backend->name,
+           report->carrier.lanes, report->carrier.sample_bits);
+    printf("%-8s %12s %12s %10s %12s %25s %25s\n", "channel", "samples", "MSE", "PSNR(dB)",
+           "flipped", "cover LSB 0/1", "stego LSB 0/1");
+    for (uint ch = 0; ch < report->carrier.lanes; ch++)
+    {
+        sprintf(name, "%c", report->carrier.channel_names[ch]);
+        print_channel(name, &report->channel[ch]);
+    }
+    print_channel("total", &report->total);
+}
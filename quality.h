@@ -0,0 +1,75 @@
+#ifndef QUALITY_H
+#define QUALITY_H
+
+#include "types.h" // Contains user defined types
+#include "carrier.h"
+
+/*
+ * This header file defines the cover-vs-stego quality report. Cover and
+ * stego are streamed side by side in one pass and every payload carrying
+ * byte contributes to the statistics of its channel. Blocks are summed with
+ * SSE2 when the build has it; every variant is listed in quality_kernels[]
+ * so the benchmark (-b) can check it against the scalar reference.
+ */
+
+/*
+ * Structure: ChannelQuality
+ * Purpose: Distortion statistics of one channel.
+ */
+typedef struct _ChannelQuality
+{
+    unsigned long long samples;         // Number of samples compared
+    unsigned long long squared_error;   // Sum of squared differences
+    unsigned long long flipped_lsbs;    // Samples whose LSB differs
+    unsigned long long cover_ones;      // Cover samples with LSB set
+    unsigned long long stego_ones;      // Stego samples with LSB set
+    double mse;                         // Mean squared error
+    double psnr;                        // Peak signal to noise ratio in dB (0 when identical)
+} ChannelQuality;
+
+/*
+ * Structure: QualityReport
+ * Purpose: Per-channel and overall distortion between cover and stego.
+ */
+typedef struct _QualityReport
+{
+    CarrierInfo carrier;                        // Layout shared by both files
+    ChannelQuality channel[MAX_CARRIER_GROUP];  // One entry per channel
+    ChannelQuality total;                       // All channels together
+} QualityReport;
+
+/*
+ * Structure: QualityKernel
+ * Purpose: One implementation of the per-block statistics.
+ */
+typedef struct _QualityKernel
+{
+    const char *name;   // Variant name for reports
+    void (*compare)(const unsigned char *cover, const unsigned char *stego, uint count, uint lanes,
+                    ChannelQuality *q);     // count groups of lanes interleaved samples, added to q[0 .. lanes - 1]
+} QualityKernel;
+
+/* Every compiled variant; the first one is the reference */
+extern const QualityKernel quality_kernels[];
+extern const uint quality_kernel_count;
+
+/*
+ * Function: compare_carriers
+ * Purpose: Streams cover and stego side by side and fills the quality report.
+ * Inputs:
+ *  - cover_fname, stego_fname: Files to compare, of the same format and size.
+ *  - report: Pointer to the report to fill.
+ * Outputs:
+ *  - Returns e_success if both files were compared, otherwise e_failure.
+ */
+Status compare_carriers(const char *cover_fname, const char *stego_fname, QualityReport *report);
+
+/*
+ * Function: print_quality_report
+ * Purpose: Prints a quality report.
+ * Inputs:
+ *  - report: Report filled by compare_carriers.
+ */
+void print_quality_report(const QualityReport *report);
+
+#endif
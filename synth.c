@@ -0,0 +1,183 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include "types.h"
+#include "synth.h"
+
+#define SYNTH_HEADER 54     // BITMAPFILEHEADER + BITMAPINFOHEADER
+
+/* State of one open synthetic cover stream */
+typedef struct _SyntheticCover
+{
+    SyntheticSpec spec;                 // Parameters of the image
+    uint row_bytes;                     // Bytes per pixel row including padding
+    unsigned char header[SYNTH_HEADER]; // File header, built once
+    long pos;                           // Current stream offset
+    long cached_row;                    // Row held in row, -1 when none
+    unsigned char *row;                 // One generated pixel row
+} SyntheticCover;
+
+// Function to store a little-endian value of n bytes
+static void write_le(unsigned char *p, uint value, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        p[i] = value >> (8 * i);
+    }
+}
+
+// Function to parse "WxH[:seed]"
+Status parse_synthetic_spec(const char *arg, SyntheticSpec *spec)
+{
+    char tail;
+
+    memset(spec, 0, sizeof(SyntheticSpec));
+    int fields = sscanf(arg, "%ux%u:%u%c", &spec->width, &spec->height, &spec->seed, &tail);
+    if (fields < 2 || fields == 4 || (fields == 2 && strchr(arg, ':') != NULL))
+    {
+        return e_failure;
+    }
+    if (spec->width == 0 || spec->height == 0 || spec->width > SYNTH_MAX_DIM || spec->height > SYNTH_MAX_DIM)
+    {
+        return e_failure;
+    }
+
+    // Rows are padded to 4 bytes; the BMP size field is 32 bits
+    long row_bytes = (spec->width * 3L + 3) & ~3L;
+    spec->size = SYNTH_HEADER + row_bytes * spec->height;
+    if (spec->size > 0xFFFFFFFFL)
+    {
+        return e_failure;
+    }
+    return e_success;
+}
+
+// Function to generate one pixel row (BMP rows run bottom-up)
+static void generate_row(SyntheticCover *cover, long row)
+{
+    const uint width = cover->spec.width;
+    const uint height = cover->spec.height;
+    const uint y = height - 1 - row;
+    const uint seed = cover->spec.seed * 0xC2B2AE3Du;
+    unsigned char *p = cover->row;
+
+    // Smooth gradients per channel plus three bytes of one hash as noise
+    for (uint x = 0; x < width; x++)
+    {
+        uint h = (x * 0x9E3779B1u) ^ (y * 0x85EBCA77u) ^ seed;
+        h ^= h >> 15;
+        h *= 0x2C1B3C6Du;
+        h ^= h >> 12;
+        int r = 48 + (int)(160u * x / width) + (int)(h & 0xFF) % SYNTH_NOISE;
+        int g = 40 + (int)(150u * y / height) + (int)((h >> 8) & 0xFF) % SYNTH_NOISE;
+        int b = 200 - (int)(150u * (x + y) / (width + height)) + (int)((h >> 16) & 0xFF) % SYNTH_NOISE;
+        p[3 * x] = b;
+        p[3 * x + 1] = g;
+        p[3 * x + 2] = r;
+    }
+    memset(p + 3 * width, 0, cover->row_bytes - 3 * width);
+    cover->cached_row = row;
+}
+
+// Function to read from the generated file
+static ssize_t synthetic_read(void *cookie, char *buf, size_t size)
+{
+    SyntheticCover *cover = cookie;
+    size_t done = 0;
+
+    while (done < size && cover->pos < cover->spec.size)
+    {
+        size_t n;
+        if (cover->pos < SYNTH_HEADER)
+        {
+            n = SYNTH_HEADER - cover->pos;
+            n = (n < size - done) ? n : size - done;
+            memcpy(buf + done, cover->header + cover->pos, n);
+        }
+        else
+        {
+            // Rows are produced on demand, so sequential reads generate each once
+            long offset = cover->pos - SYNTH_HEADER;
+            long row = offset / cover->row_bytes;
+            uint column = offset % cover->row_bytes;
+            if (row != cover->cached_row)
+            {
+                generate_row(cover, row);
+            }
+            n = cover->row_bytes - column;
+            n = (n < size - done) ? n : size - done;
+            memcpy(buf + done, cover->row + column, n);
+        }
+        done += n;
+        cover->pos += n;
+    }
+    return done;
+}
+
+// Function to seek in the generated file
+static int synthetic_seek(void *cookie, off64_t *offset, int whence)
+{
+    SyntheticCover *cover = cookie;
+    long base = (whence == SEEK_SET) ? 0 : (whence == SEEK_CUR) ? cover->pos : cover->spec.size;
+
+    if (base + *offset < 0)
+    {
+        return -1;
+    }
+    cover->pos = base + *offset;
+    *offset = cover->pos;
+    return 0;
+}
+
+// Function to release the generator
+static int synthetic_close(void *cookie)
+{
+    SyntheticCover *cover = cookie;
+    free(cover->row);
+    free(cover);
+    return 0;
+}
+
+// Function to open a generated cover as a stream
+FILE *synthetic_cover_open(const SyntheticSpec *spec)
+{
+    SyntheticCover *cover = calloc(1, sizeof(SyntheticCover));
+    if (cover == NULL)
+    {
+        return NULL;
+    }
+    cover->spec = *spec;
+    cover->row_bytes = (spec->width * 3 + 3) & ~3u;
+    cover->cached_row = -1;
+    cover->row = malloc(cover->row_bytes);
+    if (cover->row == NULL)
+    {
+        free(cover);
+        return NULL;
+    }
+
+    // 24-bit uncompressed BMP, 72 dpi
+    unsigned char *h = cover->header;
+    h[0] = 'B';
+    h[1] = 'M';
+    write_le(h + 2, spec->size, 4);
+    write_le(h + 10, SYNTH_HEADER, 4);
+    write_le(h + 14, 40, 4);
+    write_le(h + 18, spec->width, 4);
+    write_le(h + 22, spec->height, 4);
+    write_le(h + 26, 1, 2);
+    write_le(h + 28, 24, 2);
+    write_le(h + 34, spec->size - SYNTH_HEADER, 4);
+    write_le(h + 38, 2835, 4);
+    write_le(h + 42, 2835, 4);
+
+    cookie_io_functions_t io = { synthetic_read, NULL, synthetic_seek, synthetic_close };
+    FILE *fptr = fopencookie(cover, "r", io);
+    if (fptr == NULL)
+    {
+        synthetic_close(cover);
+    }
+    return fptr;
+}
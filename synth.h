@@ -0,0 +1,51 @@
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include <stdio.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * This header file defines the synthetic cover. It is a 24-bit BMP that is
+ * generated on the fly (a smooth colour gradient with per-pixel hash noise)
+ * and read through an ordinary FILE pointer, so the encoder and the carrier
+ * layer use it exactly like a cover on disk. The same spec always yields
+ * the same bytes, and the stream is seekable, so --resume works with it.
+ */
+
+#define SYNTH_MAX_DIM 65535     // Largest width or height
+#define SYNTH_NOISE 24          // Peak-to-peak amplitude of the pixel noise
+
+/*
+ * Structure: SyntheticSpec
+ * Purpose: Parameters of a synthetic cover, parsed from "WxH[:seed]".
+ */
+typedef struct _SyntheticSpec
+{
+    uint width;     // Image width in pixels
+    uint height;    // Image height in pixels
+    uint seed;      // Noise seed, 0 when not given
+    long size;      // Size of the generated BMP file in bytes
+} SyntheticSpec;
+
+/*
+ * Function: parse_synthetic_spec
+ * Purpose: Parses and validates "WxH[:seed]".
+ * Inputs:
+ *  - arg: Spec string.
+ *  - spec: Pointer to the spec to fill.
+ * Outputs:
+ *  - Returns e_success if the spec is valid, otherwise e_failure.
+ */
+Status parse_synthetic_spec(const char *arg, SyntheticSpec *spec);
+
+/*
+ * Function: synthetic_cover_open
+ * Purpose: Opens a read-only, seekable stream of the generated BMP.
+ * Inputs:
+ *  - spec: Parsed spec.
+ * Outputs:
+ *  - Returns the stream, or NULL on failure. Close it with fclose.
+ */
+FILE *synthetic_cover_open(const SyntheticSpec *spec);
+
+#endif
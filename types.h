@@ -32,12 +32,28 @@ typedef enum
  * Values:
  * - `e_encode`: Indicates that the program will perform encoding.
  * - `e_decode`: Indicates that the program will perform decoding.
+ * - `e_archive`: Indicates that the program will embed a multi-file archive.
+ * - `e_compare`: Indicates that the program will compare a cover and a stego file.
+ * - `e_analyse`: Indicates that the program will run steganalysis on files.
+ * - `e_bench`: Indicates that the program will verify and benchmark the LSB kernels.
+ * - `e_worker`: Indicates that the program will run jobs from a spool directory.
+ * - `e_fanout`: Indicates that the program will embed several secrets into one cover in one pass.
+ * - `e_plane`: Indicates that the program will export or import a packed LSB bit plane.
+ * - `e_watch`: Indicates that the program will encode or decode files as they arrive in a directory.
  * - `e_unsupported`: Indicates an invalid or unsupported operation type.
  */
 typedef enum
 {
     e_encode,       // Operation type for encoding
     e_decode,       // Operation type for decoding
+    e_archive,      // Operation type for archive embedding
+    e_compare,      // Operation type for cover-vs-stego comparison
+    e_analyse,      // Operation type for steganalysis
+    e_bench,        // Operation type for kernel benchmarks
+    e_worker,       // Operation type for the spool worker
+    e_fanout,       // Operation type for fan-out encoding
+    e_plane,        // Operation type for bit plane export / import
+    e_watch,        // Operation type for the watch folder
     e_unsupported   // Unsupported or invalid operation
 } OperationType;
 
@@ -0,0 +1,435 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <signal.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "types.h"
+#include "carrier.h"
+#include "encode.h"
+#include "decode.h"
+#include "y4m.h"
+#include "watch.h"
+
+/* One file waiting to be processed */
+typedef struct _WatchJob
+{
+    struct _WatchJob *next;     // Next job in arrival order
+    char name[NAME_MAX + 1];    // File name inside the watch directory
+    double arrived;             // Time of the inotify event
+} WatchJob;
+
+/* Queue and counters shared by the watcher and the pool */
+typedef struct _WatchPool
+{
+    const char *watch_dir;      // Directory being watched
+    const char *target_dir;     // Directory receiving the outputs
+    OperationType op;           // e_encode or e_decode
+    char **op_argv;             // "-e <secret> [options]" or "-d [options]"
+    int op_argc;                // Number of op_argv entries
+    WatchJob *head, *tail;      // Files waiting, oldest first
+    uint depth;                 // Number of files waiting
+    unsigned long next_seq;     // Number of the next staged output
+    uint done;                  // Files finished successfully
+    uint failed;                // Files that returned an error
+    double total_latency;       // Sum of event-to-output times of finished files
+    double max_latency;         // Longest event-to-output time
+    int closing;                // Set when no more files will be queued
+    pthread_mutex_t lock;       // Protects the fields above
+    pthread_cond_t ready;       // Signalled when a file is queued or closing is set
+} WatchPool;
+
+static volatile sig_atomic_t watch_stop;   // Set by SIGINT / SIGTERM
+
+// Function to stop after the running files on a signal
+static void watch_signal(int sig)
+{
+    (void)sig;
+    watch_stop = 1;
+}
+
+// Function to read a monotonic clock in seconds
+static double watch_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Function to pick out the files worth queueing: visible carriers
+static int watch_wanted(const char *name)
+{
+    const char *extn = strrchr(name, '.');
+    if (name[0] == '.' || extn == NULL)
+    {
+        return 0;
+    }
+    return carrier_known_extn(extn) == e_success || strcmp(extn, Y4M_EXTN) == 0;
+}
+
+// Function to run the command on one file and publish its output; final receives the output name
+static Status run_watch_job(WatchPool *pool, const WatchJob *job, unsigned long seq, char *final, size_t size)
+{
+    char src[PATH_MAX], staged[PATH_MAX], output[PATH_MAX];
+    char *args[MAX_WATCH_ARGS + 1];
+    const char *extn = strrchr(job->name, '.');
+    int argc = 0;
+    Status status = e_failure;
+
+    // Same command line as the -e / -d operation, the output under a numbered staging name
+    snprintf(src, sizeof(src), "%s/%s", pool->watch_dir, job->name);
+    args[argc++] = "stego";
+    args[argc++] = pool->op_argv[0];
+    args[argc++] = src;
+    if (pool->op == e_encode)
+    {
+        snprintf(staged, sizeof(staged), "%s/%s/%lu%s", pool->target_dir, WATCH_STAGING, seq, extn);
+        args[argc++] = pool->op_argv[1];
+        args[argc++] = staged;
+        for (int i = 2; i < pool->op_argc; i++)
+        {
+            args[argc++] = pool->op_argv[i];
+        }
+    }
+    else
+    {
+        snprintf(staged, sizeof(staged), "%s/%s/%lu", pool->target_dir, WATCH_STAGING, seq);
+        args[argc++] = staged;
+        for (int i = 1; i < pool->op_argc; i++)
+        {
+            args[argc++] = pool->op_argv[i];
+        }
+    }
+    args[argc] = NULL;
+    output[0] = '\0';
+
+    if (pool->op == e_encode)
+    {
+        EncodeInfo *encInfo = malloc(sizeof(EncodeInfo));
+        if (encInfo != NULL && read_and_validate_encode_args(args, encInfo) == e_success)
+        {
+            status = do_encoding(encInfo);
+            close_encode_files(encInfo);
+        }
+        free(encInfo);
+
+        // The stego file keeps the name of its cover
+        snprintf(output, sizeof(output), "%s", staged);
+        snprintf(final, size, "%s/%s", pool->target_dir, job->name);
+    }
+    else
+    {
+        DecodeInfo *decInfo = malloc(sizeof(DecodeInfo));
+        if (decInfo != NULL && read_and_validate_decode_args(args, decInfo) == e_success)
+        {
+            status = do_decoding(decInfo);
+            close_decode_files(decInfo);
+            snprintf(output, sizeof(output), "%s", decInfo->out_fname);
+        }
+        free(decInfo);
+
+        // The secret takes the name of its carrier with the extension the decoder appended
+        const char *suffix = (strncmp(output, staged, strlen(staged)) == 0) ? output + strlen(staged) : "";
+        snprintf(final, size, "%s/%.*s%s", pool->target_dir, (int)(extn - job->name), job->name, suffix);
+    }
+
+    // Readers of the target directory only ever see complete outputs
+    if (status == e_success && rename(output, final))
+    {
+        perror("rename");
+        status = e_failure;
+    }
+    if (status == e_failure && output[0] != '\0')
+    {
+        unlink(output);
+    }
+    return status;
+}
+
+// Function run by every pool thread
+static void *watch_worker(void *arg)
+{
+    WatchPool *pool = arg;
+    char final[PATH_MAX];
+
+    for (;;)
+    {
+        // Wait for a file; a signal ends the wait within one poll period
+        pthread_mutex_lock(&pool->lock);
+        while (pool->head == NULL && !pool->closing && !watch_stop)
+        {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += WATCH_POLL_MS * 1000000L;
+            deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+            pthread_cond_timedwait(&pool->ready, &pool->lock, &deadline);
+        }
+        if (pool->head == NULL || watch_stop)
+        {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        WatchJob *job = pool->head;
+        pool->head = job->next;
+        if (pool->head == NULL)
+        {
+            pool->tail = NULL;
+        }
+        pool->depth--;
+        unsigned long seq = pool->next_seq++;
+        pthread_mutex_unlock(&pool->lock);
+
+        double start = watch_clock();
+        Status status = run_watch_job(pool, job, seq, final, sizeof(final));
+        double end = watch_clock();
+
+        pthread_mutex_lock(&pool->lock);
+        if (status == e_success)
+        {
+            pool->done++;
+            pool->total_latency += end - job->arrived;
+            pool->max_latency = (end - job->arrived > pool->max_latency) ? end - job->arrived : pool->max_latency;
+        }
+        else
+        {
+            pool->failed++;
+        }
+        uint depth = pool->depth;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (status == e_success)
+        {
+            printf("INFO: watch: %s -> %s in %.3f s (waited %.3f s), queue depth %u\n", job->name, final,
+                   end - start, start - job->arrived, depth);
+        }
+        else
+        {
+            printf("INFO: watch: %s failed in %.3f s (waited %.3f s), queue depth %u\n", job->name,
+                   end - start, start - job->arrived, depth);
+        }
+        free(job);
+    }
+}
+
+// Function to queue a file for the pool
+static Status watch_enqueue(WatchPool *pool, const char *name)
+{
+    WatchJob *job = calloc(1, sizeof(WatchJob));
+    if (job == NULL)
+    {
+        return e_failure;
+    }
+    snprintf(job->name, sizeof(job->name), "%s", name);
+    job->arrived = watch_clock();
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->tail != NULL)
+    {
+        pool->tail->next = job;
+    }
+    else
+    {
+        pool->head = job;
+    }
+    pool->tail = job;
+    uint depth = ++pool->depth;
+    pthread_cond_signal(&pool->ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    printf("INFO: watch: queued %s, queue depth %u\n", name, depth);
+    return e_success;
+}
+
+// Function to check the directories and create the staging directory
+static Status watch_prepare_dirs(const char *watch_dir, const char *target_dir)
+{
+    struct stat watch_st, target_st;
+    char staging[PATH_MAX];
+
+    if (stat(watch_dir, &watch_st) || !S_ISDIR(watch_st.st_mode) || stat(target_dir, &target_st) || !S_ISDIR(target_st.st_mode))
+    {
+        printf("INFO: Validation Error. The watch and target directories must exist.\n");
+        return e_failure;
+    }
+
+    // Outputs landing in the watched directory would be picked up again
+    if (watch_st.st_dev == target_st.st_dev && watch_st.st_ino == target_st.st_ino)
+    {
+        printf("INFO: Validation Error. The target directory must differ from the watch directory.\n");
+        return e_failure;
+    }
+    snprintf(staging, sizeof(staging), "%s/%s", target_dir, WATCH_STAGING);
+    if (mkdir(staging, 0777) && errno != EEXIST)
+    {
+        perror("mkdir");
+        return e_failure;
+    }
+    return e_success;
+}
+
+// Function to run the watch folder
+Status do_watch(int argc, char *argv[])
+{
+    WatchPool pool;
+    pthread_t tids[MAX_WATCH_WORKERS];
+    uint workers = 0, exit_after = 0;
+    int i;
+
+    if (argc < 5)
+    {
+        printf("INFO: Validation Error. Missing directories or command.\n");
+        return e_failure;
+    }
+    memset(&pool, 0, sizeof(pool));
+    pool.watch_dir = argv[2];
+    pool.target_dir = argv[3];
+
+    // Watcher options, then the command run on every file
+    for (i = 4; i < argc && argv[i][0] == '-' && argv[i][1] == '-'; i++)
+    {
+        if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+        {
+            workers = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--exit-after") == 0 && i + 1 < argc)
+        {
+            exit_after = atoi(argv[++i]);
+        }
+        else
+        {
+            printf("INFO: Unexpected argument %s\n", argv[i]);
+            return e_failure;
+        }
+    }
+    pool.op = (i < argc) ? check_operation_type(argv[i]) : e_unsupported;
+    pool.op_argv = argv + i;
+    pool.op_argc = argc - i;
+    if ((pool.op != e_encode && pool.op != e_decode) || (pool.op == e_encode && pool.op_argc < 2) ||
+        pool.op_argc + 3 > MAX_WATCH_ARGS)
+    {
+        printf("INFO: Validation Error. The command must be -e <secret> [options] or -d [options].\n");
+        return e_failure;
+    }
+    if (pool.op == e_decode)
+    {
+        // Nobody can answer the magic string prompt
+        int magic = 0;
+        for (int k = 1; k < pool.op_argc; k++)
+        {
+            magic |= (strcmp(pool.op_argv[k], "--magic") == 0 || strcmp(pool.op_argv[k], "--auto") == 0);
+        }
+        if (!magic)
+        {
+            printf("INFO: Validation Error. Watched decodes need --magic <string> or --auto.\n");
+            return e_failure;
+        }
+    }
+    if (watch_prepare_dirs(pool.watch_dir, pool.target_dir) == e_failure)
+    {
+        return e_failure;
+    }
+
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0 || inotify_add_watch(fd, pool.watch_dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR) < 0)
+    {
+        perror("inotify");
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return e_failure;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = watch_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    // One thread per online CPU unless told otherwise
+    if (workers == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = (cpus > 0) ? cpus : 1;
+    }
+    if (workers > MAX_WATCH_WORKERS)
+    {
+        workers = MAX_WATCH_WORKERS;
+    }
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.ready, NULL);
+    uint started = 0;
+    for (; started < workers; started++)
+    {
+        if (pthread_create(&tids[started], NULL, watch_worker, &pool))
+        {
+            break;
+        }
+    }
+    if (started == 0)
+    {
+        close(fd);
+        return e_failure;
+    }
+    printf("INFO: Watching %s, outputs to %s, %u workers\n", pool.watch_dir, pool.target_dir, started);
+    fflush(stdout);
+
+    // Queue every carrier that is closed after writing or moved in
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    uint queued = 0;
+    while (!watch_stop && (exit_after == 0 || queued < exit_after))
+    {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, WATCH_POLL_MS) <= 0)
+        {
+            continue;
+        }
+        ssize_t len = read(fd, events, sizeof(events));
+        for (char *p = events; len > 0 && p < events + len; p += sizeof(struct inotify_event) + ((struct inotify_event *)p)->len)
+        {
+            const struct inotify_event *event = (const struct inotify_event *)p;
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                printf("INFO: watch: inotify queue overflowed, some files were missed\n");
+            }
+            if (event->len == 0 || !watch_wanted(event->name) || (exit_after != 0 && queued >= exit_after))
+            {
+                continue;
+            }
+            if (watch_enqueue(&pool, event->name) == e_success)
+            {
+                queued++;
+            }
+        }
+    }
+    close(fd);
+
+    // Let the pool finish the queue, or only the running files after a signal
+    pthread_mutex_lock(&pool.lock);
+    pool.closing = 1;
+    pthread_cond_broadcast(&pool.ready);
+    pthread_mutex_unlock(&pool.lock);
+    for (uint k = 0; k < started; k++)
+    {
+        pthread_join(tids[k], NULL);
+    }
+    uint dropped = 0;
+    while (pool.head != NULL)
+    {
+        WatchJob *job = pool.head;
+        pool.head = job->next;
+        free(job);
+        dropped++;
+    }
+
+    printf("INFO: Watch stopped: %u done, %u failed, %u dropped, latency %.3f s average, %.3f s max\n", pool.done,
+           pool.failed, dropped, pool.done ? pool.total_latency / pool.done : 0.0, pool.max_latency);
+    return (pool.failed == 0 && dropped == 0) ? e_success : e_failure;
+}
@@ -0,0 +1,39 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "types.h" // Contains user defined types
+
+/*
+ * This header file defines the watch folder. The watcher waits on inotify
+ * for carriers that are closed after writing or moved into a directory,
+ * and queues them for a pool of threads in the same process that run the
+ * given -e or -d command on each one:
+ *
+ *   -m in out -e secret.txt --fec   encodes in/NAME.bmp to out/NAME.bmp
+ *   -m in out -d --auto             decodes in/NAME.bmp to out/NAME.txt
+ *
+ * Every output is written under a numbered name in out/.watch/ and renamed
+ * to its real name once complete, so readers of out/ never see a partial
+ * file. Carriers already in the directory when the watcher starts, and
+ * hidden files, are left alone. A decode must name its magic string with
+ * --magic or --auto, since no one is there to answer the prompt.
+ */
+
+#define WATCH_STAGING ".watch"      // Directory inside the target holding outputs being written
+#define MAX_WATCH_WORKERS 64        // Upper bound for --workers
+#define MAX_WATCH_ARGS 32           // Most arguments of the per-file command
+#define WATCH_POLL_MS 250           // Longest wait for inotify before checking for a stop
+
+/*
+ * Function: do_watch
+ * Purpose: Handles "-m <watch dir> <target dir> [--workers N] [--exit-after N]
+ *          -e <secret> [options] | -d [options]". Runs until stopped by a
+ *          signal, or until N files are finished when --exit-after is given.
+ * Inputs:
+ *  - argc, argv: Command-line arguments.
+ * Outputs:
+ *  - Returns e_success when the watcher stops and every file succeeded, otherwise e_failure.
+ */
+Status do_watch(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,491 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <signal.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "types.h"
+#include "encode.h"
+#include "decode.h"
+#include "worker.h"
+
+#define JOB_SUFFIX ".job"   // Suffix of job files in every directory
+
+/* Lease refresher shared with the heartbeat thread */
+typedef struct _Heartbeat
+{
+    pthread_mutex_t lock;           // Protects the fields below
+    pthread_cond_t wake;            // Signalled to stop the thread
+    char claim[NAME_MAX + 1];       // Claim being run, empty when idle
+    uint lease;                     // Lease time in seconds
+    int lost;                       // Set when the claim disappeared while running
+    int stop;                       // Set to end the thread
+} Heartbeat;
+
+static volatile sig_atomic_t worker_stop;  // Set by SIGINT / SIGTERM
+
+// Function to stop after the current job on a signal
+static void worker_signal(int sig)
+{
+    (void)sig;
+    worker_stop = 1;
+}
+
+// Function to read a monotonic clock in seconds
+static double worker_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Function to write a small file atomically
+static Status write_spool_file(const char *path, const char *text)
+{
+    char tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid());
+    FILE *fptr = fopen(tmp, "w");
+    if (fptr == NULL)
+    {
+        return e_failure;
+    }
+    fputs(text, fptr);
+    if (fclose(fptr) || rename(tmp, path))
+    {
+        unlink(tmp);
+        return e_failure;
+    }
+    return e_success;
+}
+
+// Function to publish the throughput counters of this worker
+static void publish_stats(const WorkerStats *stats)
+{
+    char path[PATH_MAX], text[1024];
+    double uptime = time(NULL) - stats->started;
+    uint jobs = stats->jobs_done + stats->jobs_failed;
+
+    snprintf(path, sizeof(path), "stats/%s.stats", stats->id);
+    snprintf(text, sizeof(text),
+             "worker=%s\nstarted=%ld\njobs_done=%u\njobs_failed=%u\njobs_lost=%u\njobs_requeued=%u\n"
+             "busy_seconds=%.3f\ncarrier_bytes=%.0f\njobs_per_second=%.3f\ncarrier_mb_per_second=%.3f\n",
+             stats->id, stats->started, stats->jobs_done, stats->jobs_failed, stats->jobs_lost, stats->jobs_requeued,
+             stats->busy_seconds, stats->carrier_bytes, uptime > 0 ? jobs / uptime : 0.0,
+             stats->busy_seconds > 0 ? stats->carrier_bytes / 1e6 / stats->busy_seconds : 0.0);
+    write_spool_file(path, text);
+}
+
+// Function to keep only job files
+static int job_filter(const struct dirent *entry)
+{
+    size_t len = strlen(entry->d_name);
+    size_t suffix = strlen(JOB_SUFFIX);
+    return entry->d_name[0] != '.' && len > suffix && strcmp(entry->d_name + len - suffix, JOB_SUFFIX) == 0;
+}
+
+// Function to refresh the lease of the running claim
+static void *heartbeat_main(void *arg)
+{
+    Heartbeat *beat = arg;
+    char path[PATH_MAX];
+
+    pthread_mutex_lock(&beat->lock);
+    while (!beat->stop)
+    {
+        // Three refreshes per lease period leave room for a slow filesystem
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += (beat->lease + 2) / 3;
+        pthread_cond_timedwait(&beat->wake, &beat->lock, &deadline);
+
+        if (beat->claim[0] != '\0' && !beat->stop)
+        {
+            snprintf(path, sizeof(path), "claimed/%s.lease", beat->claim);
+            utimensat(AT_FDCWD, path, NULL, 0);
+
+            // Another worker requeued the claim; the result will be discarded
+            snprintf(path, sizeof(path), "claimed/%s%s", beat->claim, JOB_SUFFIX);
+            if (access(path, F_OK))
+            {
+                beat->lost = 1;
+            }
+        }
+    }
+    pthread_mutex_unlock(&beat->lock);
+    return NULL;
+}
+
+// Function to put expired claims of crashed workers back into the queue; returns the claims left
+static uint reap_expired_claims(uint lease, WorkerStats *stats)
+{
+    struct dirent **entries;
+    char job[PATH_MAX], path[PATH_MAX], target[PATH_MAX];
+    int count = scandir("claimed", &entries, job_filter, alphasort);
+    uint left = 0;
+
+    // An unreadable directory has no claims to reap
+    if (count < 0)
+    {
+        return 0;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        // Claims are named NAME@WORKER.job
+        char claim[NAME_MAX + 1];
+        snprintf(claim, sizeof(claim), "%.*s", (int)(strlen(entries[i]->d_name) - strlen(JOB_SUFFIX)), entries[i]->d_name);
+        char *owner = strrchr(claim, '@');
+        snprintf(job, sizeof(job), "claimed/%s", entries[i]->d_name);
+        snprintf(path, sizeof(path), "claimed/%s.lease", claim);
+        free(entries[i]);
+
+        // The lease is refreshed by the owner; right after the claim the rename time stands in
+        struct stat st;
+        time_t last;
+        if (stat(path, &st) == 0)
+        {
+            last = st.st_mtime;
+        }
+        else if (stat(job, &st) == 0)
+        {
+            last = st.st_ctime;
+        }
+        else
+        {
+            continue;
+        }
+        if (owner == NULL || time(NULL) - last <= (time_t)lease)
+        {
+            left++;
+            continue;
+        }
+
+        // Only one reaper wins the rename
+        *owner = '\0';
+        snprintf(target, sizeof(target), "queue/%s%s", claim, JOB_SUFFIX);
+        if (rename(job, target) == 0)
+        {
+            unlink(path);
+            *owner = '@';
+            snprintf(path, sizeof(path), "claimed/%s.log", claim);
+            snprintf(target, sizeof(target), "failed/%s.log", claim);
+            rename(path, target);
+            stats->jobs_requeued++;
+            printf("INFO: Lease of %s expired, job requeued.\n", claim);
+        }
+    }
+    free(entries);
+    return left;
+}
+
+// Function to split a job file into arguments
+static int parse_job(char *text, char **args)
+{
+    int argc = 0;
+    args[argc++] = "stego";
+    for (char *token = strtok(text, " \t\r\n"); token != NULL && argc < MAX_JOB_ARGS; token = strtok(NULL, " \t\r\n"))
+    {
+        args[argc++] = token;
+    }
+    args[argc] = NULL;
+    return argc;
+}
+
+// Function to run the command of a job file
+static Status run_job_command(int argc, char **args)
+{
+    EncodeInfo encInfo;
+    DecodeInfo decInfo;
+    Status status = e_failure;
+
+    OperationType op_type = (argc > 1) ? check_operation_type(args[1]) : e_unsupported;
+    if (op_type == e_encode && argc >= 4)
+    {
+        if (read_and_validate_encode_args(args, &encInfo) == e_success)
+        {
+            status = do_encoding(&encInfo);
+            close_encode_files(&encInfo);
+        }
+    }
+    else if (op_type == e_decode && argc >= 3)
+    {
+        if (read_and_validate_decode_args(args, &decInfo) == e_success)
+        {
+            status = do_decoding(&decInfo);
+            close_decode_files(&decInfo);
+        }
+    }
+    else
+    {
+        printf("INFO: Jobs must be -e or -d commands.\n");
+    }
+    return status;
+}
+
+// Function to run one claimed job with its output going to the claim log
+static Status run_job(const char *claim, double *carrier_bytes)
+{
+    char path[PATH_MAX], text[MAX_JOB_FILE + 1];
+    char *args[MAX_JOB_ARGS + 1];
+
+    snprintf(path, sizeof(path), "claimed/%s%s", claim, JOB_SUFFIX);
+    FILE *fptr = fopen(path, "r");
+    if (fptr == NULL)
+    {
+        return e_failure;
+    }
+    size_t len = fread(text, 1, MAX_JOB_FILE, fptr);
+    fclose(fptr);
+    text[len] = '\0';
+    int argc = parse_job(text, args);
+
+    // Carrier size for the throughput counters
+    struct stat st;
+    *carrier_bytes = (argc > 2 && stat(args[2], &st) == 0) ? st.st_size : 0;
+
+    // The job prints to its log and can never wait for input
+    snprintf(path, sizeof(path), "claimed/%s.log", claim);
+    int log_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int null_fd = open("/dev/null", O_RDONLY);
+    if (log_fd < 0 || null_fd < 0)
+    {
+        return e_failure;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    int saved[3] = { dup(0), dup(1), dup(2) };
+    dup2(null_fd, 0);
+    dup2(log_fd, 1);
+    dup2(log_fd, 2);
+
+    Status status = run_job_command(argc, args);
+
+    fflush(stdout);
+    fflush(stderr);
+    clearerr(stdin);
+    for (int fd = 0; fd < 3; fd++)
+    {
+        dup2(saved[fd], fd);
+        close(saved[fd]);
+    }
+    close(log_fd);
+    close(null_fd);
+    return status;
+}
+
+// Function to move a finished claim and its log into done/ or failed/
+static Status finish_job(const char *claim, const char *name, Status status, const char *id, double seconds)
+{
+    const char *dir = (status == e_success) ? "done" : "failed";
+    char path[PATH_MAX], target[PATH_MAX], text[256];
+
+    // The rename fails if the lease expired and the job went back to the queue
+    snprintf(path, sizeof(path), "claimed/%s%s", claim, JOB_SUFFIX);
+    snprintf(target, sizeof(target), "%s/%s%s", dir, name, JOB_SUFFIX);
+    if (rename(path, target))
+    {
+        return e_failure;
+    }
+
+    snprintf(path, sizeof(path), "claimed/%s.log", claim);
+    snprintf(target, sizeof(target), "%s/%s.log", dir, name);
+    rename(path, target);
+
+    snprintf(target, sizeof(target), "%s/%s.result", dir, name);
+    snprintf(text, sizeof(text), "status=%s\nworker=%s\nseconds=%.3f\n", status == e_success ? "ok" : "failed", id, seconds);
+    write_spool_file(target, text);
+
+    snprintf(path, sizeof(path), "claimed/%s.lease", claim);
+    unlink(path);
+    return e_success;
+}
+
+// Function to claim and run the first job in the queue; returns 1 if a job was run
+static int worker_take_job(Heartbeat *beat, WorkerStats *stats)
+{
+    struct dirent **entries;
+    char name[NAME_MAX + 1], claim[NAME_MAX + MAX_WORKER_ID + 2], path[PATH_MAX], target[PATH_MAX];
+    int count = scandir("queue", &entries, job_filter, alphasort);
+    int claimed = 0;
+
+    // An unreadable queue has no jobs to claim
+    if (count < 0)
+    {
+        return 0;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (!claimed && strlen(entries[i]->d_name) + strlen(stats->id) + 8 < NAME_MAX)
+        {
+            // Claim by renaming under our own name; losing the race is not an error
+            snprintf(name, sizeof(name), "%.*s", (int)(strlen(entries[i]->d_name) - strlen(JOB_SUFFIX)), entries[i]->d_name);
+            snprintf(claim, sizeof(claim), "%s@%s", name, stats->id);
+            snprintf(path, sizeof(path), "queue/%s", entries[i]->d_name);
+            snprintf(target, sizeof(target), "claimed/%s%s", claim, JOB_SUFFIX);
+            claimed = (rename(path, target) == 0);
+        }
+        free(entries[i]);
+    }
+    free(entries);
+    if (!claimed)
+    {
+        return 0;
+    }
+
+    // Lease file, refreshed by the heartbeat thread from now on
+    char text[256];
+    snprintf(path, sizeof(path), "claimed/%s.lease", claim);
+    snprintf(text, sizeof(text), "worker=%s\npid=%d\nclaimed=%ld\n", stats->id, (int)getpid(), (long)time(NULL));
+    write_spool_file(path, text);
+    pthread_mutex_lock(&beat->lock);
+    strcpy(beat->claim, claim);
+    beat->lost = 0;
+    pthread_mutex_unlock(&beat->lock);
+
+    printf("INFO: %s: running %s\n", stats->id, name);
+    double bytes = 0.0;
+    double start = worker_clock();
+    Status status = run_job(claim, &bytes);
+    double seconds = worker_clock() - start;
+
+    pthread_mutex_lock(&beat->lock);
+    beat->claim[0] = '\0';
+    int lost = beat->lost;
+    pthread_mutex_unlock(&beat->lock);
+
+    if (lost || finish_job(claim, name, status, stats->id, seconds) == e_failure)
+    {
+        // Someone else owns the job now, drop our log
+        snprintf(path, sizeof(path), "claimed/%s.log", claim);
+        unlink(path);
+        stats->jobs_lost++;
+        printf("INFO: %s: lease of %s was lost, result discarded\n", stats->id, name);
+    }
+    else
+    {
+        if (status == e_success)
+        {
+            stats->jobs_done++;
+        }
+        else
+        {
+            stats->jobs_failed++;
+        }
+        stats->busy_seconds += seconds;
+        stats->carrier_bytes += bytes;
+        printf("INFO: %s: %s %s in %.3f s\n", stats->id, name, status == e_success ? "done" : "failed", seconds);
+    }
+    publish_stats(stats);
+    return 1;
+}
+
+// Function to run the worker loop
+Status do_worker(int argc, char *argv[])
+{
+    static const char *spool_dirs[] = { "queue", "claimed", "done", "failed", "stats" };
+    WorkerStats stats;
+    Heartbeat beat;
+    int exit_when_idle = 0;
+    char host[64] = "localhost";
+
+    memset(&stats, 0, sizeof(stats));
+    memset(&beat, 0, sizeof(beat));
+    beat.lease = WORKER_DEFAULT_LEASE;
+    gethostname(host, sizeof(host) - 1);
+    snprintf(stats.id, sizeof(stats.id), "%s-%d", host, (int)getpid());
+
+    // Options after the spool directory
+    for (int i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--id") == 0 && i + 1 < argc)
+        {
+            snprintf(stats.id, sizeof(stats.id), "%s", argv[++i]);
+        }
+        else if (strcmp(argv[i], "--lease") == 0 && i + 1 < argc)
+        {
+            beat.lease = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--exit-when-idle") == 0)
+        {
+            exit_when_idle = 1;
+        }
+        else
+        {
+            printf("INFO: Unexpected argument %s\n", argv[i]);
+            return e_failure;
+        }
+    }
+    if (beat.lease == 0 || strpbrk(stats.id, "/@") != NULL || stats.id[0] == '.')
+    {
+        printf("INFO: Validation Error. Invalid lease time or worker id.\n");
+        return e_failure;
+    }
+
+    // Job paths are relative to the spool, whichever host runs them
+    if (chdir(argv[2]))
+    {
+        perror("chdir");
+        return e_failure;
+    }
+    for (uint i = 0; i < sizeof(spool_dirs) / sizeof(spool_dirs[0]); i++)
+    {
+        if (mkdir(spool_dirs[i], 0777) && errno != EEXIST)
+        {
+            perror("mkdir");
+            return e_failure;
+        }
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = worker_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    pthread_t thread;
+    pthread_mutex_init(&beat.lock, NULL);
+    pthread_cond_init(&beat.wake, NULL);
+    if (pthread_create(&thread, NULL, heartbeat_main, &beat))
+    {
+        return e_failure;
+    }
+
+    stats.started = time(NULL);
+    publish_stats(&stats);
+    printf("INFO: Worker %s serving %s, lease %u s\n", stats.id, argv[2], beat.lease);
+
+    while (!worker_stop)
+    {
+        // Recover abandoned claims, then take the next job
+        uint claims = reap_expired_claims(beat.lease, &stats);
+        if (worker_take_job(&beat, &stats))
+        {
+            continue;
+        }
+
+        // Nothing queued and nothing running anywhere
+        if (exit_when_idle && claims == 0)
+        {
+            break;
+        }
+        usleep(WORKER_POLL_MS * 1000);
+    }
+
+    pthread_mutex_lock(&beat.lock);
+    beat.stop = 1;
+    pthread_cond_signal(&beat.wake);
+    pthread_mutex_unlock(&beat.lock);
+    pthread_join(thread, NULL);
+
+    publish_stats(&stats);
+    printf("INFO: Worker %s stopped: %u done, %u failed, %u lost, %u requeued, %.3f s busy\n", stats.id,
+           stats.jobs_done, stats.jobs_failed, stats.jobs_lost, stats.jobs_requeued, stats.busy_seconds);
+    return e_success;
+}
@@ -0,0 +1,60 @@
+#ifndef WORKER_H
+#define WORKER_H
+
+#include "types.h" // Contains user defined types
+
+/*
+ * This header file defines the spool worker. Any number of workers, on any
+ * number of hosts, share one spool directory:
+ *
+ *   queue/    NAME.job files waiting to run (write elsewhere, then rename in)
+ *   claimed/  NAME.job being run, NAME.lease heartbeat, NAME.log output
+ *   done/     NAME.job, NAME.log and NAME.result of finished jobs
+ *   failed/   the same for jobs that returned an error
+ *   stats/    WORKER.stats throughput counters of every worker
+ *
+ * A job file holds the arguments of one -e or -d command, separated by
+ * white space, e.g. "-e cover.bmp secret.txt out.bmp --fec" or
+ * "-d out.bmp msg --magic #*". Relative paths are relative to the spool.
+ *
+ * A job is claimed by renaming it from queue/ to claimed/; rename is atomic
+ * so exactly one worker wins. The owner refreshes the lease file while the
+ * job runs. Any worker that finds a claim whose lease is older than the
+ * lease time moves it back to queue/, so jobs of crashed workers run again.
+ */
+
+#define WORKER_DEFAULT_LEASE 60     // Seconds before a silent claim expires
+#define WORKER_POLL_MS 250          // Wait between scans of an empty queue
+#define MAX_WORKER_ID 64            // Longest worker name
+#define MAX_JOB_ARGS 32             // Most arguments in one job file
+#define MAX_JOB_FILE 4096           // Largest job file in bytes
+
+/*
+ * Structure: WorkerStats
+ * Purpose: Throughput counters of one worker, published in stats/.
+ */
+typedef struct _WorkerStats
+{
+    char id[MAX_WORKER_ID];     // Worker name, host-pid by default
+    long started;               // Start time (seconds since the epoch)
+    uint jobs_done;             // Jobs finished successfully
+    uint jobs_failed;           // Jobs that returned an error
+    uint jobs_lost;             // Jobs whose lease expired while they ran
+    uint jobs_requeued;         // Expired claims of other workers put back
+    double busy_seconds;        // Time spent running jobs
+    double carrier_bytes;       // Carrier bytes processed
+} WorkerStats;
+
+/*
+ * Function: do_worker
+ * Purpose: Handles "-w <spool> [--id name] [--lease seconds] [--exit-when-idle]".
+ *          Claims and runs jobs until stopped, or until the spool is empty
+ *          when --exit-when-idle is given.
+ * Inputs:
+ *  - argc, argv: Command-line arguments.
+ * Outputs:
+ *  - Returns e_success when the worker stops normally, otherwise e_failure.
+ */
+Status do_worker(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,631 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "types.h"
+#include "common.h"
+#include "kernel.h"
+#include "y4m.h"
+
+/* Life of a frame slot */
+typedef enum
+{
+    slot_free,      // Waiting for the reader
+    slot_filled,    // Read, waiting for a worker
+    slot_busy,      // A worker is embedding or extracting
+    slot_done       // Waiting for the writer
+} Y4mSlotState;
+
+/* One frame in flight */
+typedef struct _Y4mSlot
+{
+    long frame;                 // Frame number, in stream order
+    Y4mSlotState state;         // Stage of the frame
+    char line[MAX_Y4M_LINE];    // Frame line as read
+    uint line_len;              // Bytes in line
+    unsigned char *planes;      // frame_size plane bytes
+    unsigned char *payload;     // frame_payload payload bytes
+    uint payload_len;           // Payload bytes embedded into this frame
+} Y4mSlot;
+
+/* Payload being reassembled while decoding */
+typedef struct _Y4mSink
+{
+    DecodeInfo *decInfo;                        // Output and header fields
+    const char *magic_string;                   // Magic string expected
+    unsigned char header[MAX_PAYLOAD_HEADER];   // Payload bytes until the header parses
+    uint header_have;                           // Bytes in header
+    int parsed;                                 // Header parsed and output open
+    long left;                                  // Secret bytes still to write
+    unsigned char coded[FEC_GROUP_BLOCK];       // Encoded group being collected (FEC)
+    uint coded_have;                            // Bytes in coded
+    long corrected;                             // Bytes repaired by the error correction
+} Y4mSink;
+
+/* Shared state of the reader, the workers and the writer */
+typedef struct _Y4mPipeline
+{
+    Y4mInfo info;               // Frame layout
+    FILE *fptr_src;             // Y4M file being read
+    Y4mSlot *slots;             // Frames in flight
+    uint nslots;                // Number of slots
+    int embed;                  // 1 = embed payload into frames, 0 = extract it
+    EncodeInfo *encInfo;        // Encode: secret and output
+    PayloadStream *stream;      // Encode: payload still to embed
+    Y4mSink *sink;              // Decode: payload being reassembled
+    long frames_read;           // Frames handed to the workers
+    int reading_done;           // The reader will not fill more slots
+    int read_failed;            // The reader found a truncated frame
+    int stop;                   // The writer needs no more frames
+    int finished;               // Decode: the whole secret was written
+    pthread_mutex_t lock;       // Protects everything above that changes
+    pthread_cond_t changed;     // Signalled on every state change
+} Y4mPipeline;
+
+// Function to parse the header line of a Y4M file
+Status y4m_parse_header(FILE *fptr, Y4mInfo *info)
+{
+    char line[MAX_Y4M_LINE];
+
+    memset(info, 0, sizeof(Y4mInfo));
+    if (fgets(info->header, sizeof(info->header), fptr) == NULL ||
+        strncmp(info->header, Y4M_SIGNATURE, strlen(Y4M_SIGNATURE)) || strchr(info->header, '\n') == NULL)
+    {
+        return e_failure;
+    }
+    info->header_len = strlen(info->header);
+
+    // Parameters are single letters followed by their value
+    strcpy(info->colorspace, "420jpeg");
+    strcpy(line, info->header);
+    char *save;
+    for (char *tok = strtok_r(line + strlen(Y4M_SIGNATURE), " \n", &save); tok != NULL; tok = strtok_r(NULL, " \n", &save))
+    {
+        if (tok[0] == 'W')
+        {
+            info->width = atoi(tok + 1);
+        }
+        else if (tok[0] == 'H')
+        {
+            info->height = atoi(tok + 1);
+        }
+        else if (tok[0] == 'C')
+        {
+            snprintf(info->colorspace, sizeof(info->colorspace), "%s", tok + 1);
+        }
+    }
+    if (info->width == 0 || info->height == 0)
+    {
+        return e_failure;
+    }
+
+    // Plane sizes of the 8-bit colour spaces, chroma rounded up
+    long luma = (long)info->width * info->height;
+    long half_width = (info->width + 1) / 2;
+    long half_height = (info->height + 1) / 2;
+    if (strcmp(info->colorspace, "420jpeg") == 0 || strcmp(info->colorspace, "420paldv") == 0 ||
+        strcmp(info->colorspace, "420mpeg2") == 0 || strcmp(info->colorspace, "420") == 0)
+    {
+        info->frame_size = luma + 2 * half_width * half_height;
+    }
+    else if (strcmp(info->colorspace, "422") == 0)
+    {
+        info->frame_size = luma + 2 * half_width * info->height;
+    }
+    else if (strcmp(info->colorspace, "444") == 0)
+    {
+        info->frame_size = 3 * luma;
+    }
+    else if (strcmp(info->colorspace, "444alpha") == 0)
+    {
+        info->frame_size = 4 * luma;
+    }
+    else if (strcmp(info->colorspace, "mono") == 0)
+    {
+        info->frame_size = luma;
+    }
+    else
+    {
+        return e_failure;
+    }
+    info->frame_payload = info->frame_size / 8;
+
+    // Frame lines are usually plain, which gives the frame count from the size
+    struct stat st;
+    if (fstat(fileno(fptr), &st) == 0)
+    {
+        info->frames = (st.st_size - info->header_len) / (info->frame_size + strlen(Y4M_FRAME) + 1);
+    }
+    return e_success;
+}
+
+// Function to read the next frame into a slot; returns 1 for a frame, 0 at the end, -1 if truncated
+static int read_frame(Y4mPipeline *pipe, Y4mSlot *slot)
+{
+    if (fgets(slot->line, sizeof(slot->line), pipe->fptr_src) == NULL)
+    {
+        return 0;
+    }
+    slot->line_len = strlen(slot->line);
+    if (strncmp(slot->line, Y4M_FRAME, strlen(Y4M_FRAME)) || slot->line[slot->line_len - 1] != '\n')
+    {
+        printf("INFO: Frame %ld does not start with a frame line.\n", pipe->frames_read);
+        return -1;
+    }
+    if (fread(slot->planes, 1, pipe->info.frame_size, pipe->fptr_src) != (size_t)pipe->info.frame_size)
+    {
+        printf("INFO: Frame %ld is truncated.\n", pipe->frames_read);
+        return -1;
+    }
+    return 1;
+}
+
+// Function run by the reader thread: fills slots in frame order
+static void *y4m_reader(void *arg)
+{
+    Y4mPipeline *pipe = arg;
+
+    for (long frame = 0;; frame++)
+    {
+        // The slot of a frame is free once the writer is done with the frame nslots before it
+        Y4mSlot *slot = &pipe->slots[frame % pipe->nslots];
+        pthread_mutex_lock(&pipe->lock);
+        while (slot->state != slot_free && !pipe->stop)
+        {
+            pthread_cond_wait(&pipe->changed, &pipe->lock);
+        }
+        int stop = pipe->stop;
+        pthread_mutex_unlock(&pipe->lock);
+        if (stop)
+        {
+            break;
+        }
+
+        int got = read_frame(pipe, slot);
+        int last = 0;
+        if (got > 0 && pipe->embed)
+        {
+            // The payload is produced in order, so it is cut here rather than in the workers
+            slot->payload_len = payload_stream_read(pipe->encInfo, pipe->stream, slot->payload, pipe->info.frame_payload);
+            last = (pipe->stream->payload_done == pipe->stream->payload_len);
+        }
+
+        pthread_mutex_lock(&pipe->lock);
+        if (got > 0)
+        {
+            slot->frame = frame;
+            slot->state = slot_filled;
+            pipe->frames_read = frame + 1;
+        }
+        pipe->read_failed = (got < 0);
+        pthread_cond_broadcast(&pipe->changed);
+        pthread_mutex_unlock(&pipe->lock);
+        if (got <= 0 || last)
+        {
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&pipe->lock);
+    pipe->reading_done = 1;
+    pthread_cond_broadcast(&pipe->changed);
+    pthread_mutex_unlock(&pipe->lock);
+    return NULL;
+}
+
+// Function run by every worker thread: embeds into or extracts from whole frames
+static void *y4m_worker(void *arg)
+{
+    Y4mPipeline *pipe = arg;
+
+    pthread_mutex_lock(&pipe->lock);
+    for (;;)
+    {
+        // Take any filled frame; order is restored by the writer
+        Y4mSlot *slot = NULL;
+        for (uint i = 0; i < pipe->nslots && slot == NULL; i++)
+        {
+            if (pipe->slots[i].state == slot_filled)
+            {
+                slot = &pipe->slots[i];
+            }
+        }
+        if (slot == NULL)
+        {
+            if (pipe->reading_done || pipe->stop)
+            {
+                break;
+            }
+            pthread_cond_wait(&pipe->changed, &pipe->lock);
+            continue;
+        }
+        slot->state = slot_busy;
+        pthread_mutex_unlock(&pipe->lock);
+
+        if (pipe->embed)
+        {
+            lsb_embed_block(slot->payload, slot->payload_len, slot->planes);
+        }
+        else
+        {
+            lsb_extract_block(slot->planes, pipe->info.frame_payload, slot->payload);
+        }
+
+        pthread_mutex_lock(&pipe->lock);
+        slot->state = slot_done;
+        pthread_cond_broadcast(&pipe->changed);
+    }
+    pthread_mutex_unlock(&pipe->lock);
+    return NULL;
+}
+
+// Function to write one embedded frame to the output
+static Status write_frame(Y4mPipeline *pipe, Y4mSlot *slot)
+{
+    FILE *fptr = pipe->encInfo->fptr_stego_image;
+    if (fwrite(slot->line, 1, slot->line_len, fptr) != slot->line_len ||
+        fwrite(slot->planes, 1, pipe->info.frame_size, fptr) != (size_t)pipe->info.frame_size)
+    {
+        return e_failure;
+    }
+    return e_success;
+}
+
+// Function to write secret bytes, decoding FEC groups as they complete
+static Status consume_data(Y4mSink *sink, const unsigned char *p, uint n)
+{
+    static __thread unsigned char data[FEC_GROUP_DATA];
+    DecodeInfo *decInfo = sink->decInfo;
+
+    while (n > 0 && sink->left > 0)
+    {
+        if (!(decInfo->flags & FLAG_FEC))
+        {
+            uint k = (n < sink->left) ? n : sink->left;
+            if (fwrite(p, 1, k, decInfo->fptr_output) != k)
+            {
+                return e_failure;
+            }
+            sink->left -= k;
+            return e_success;
+        }
+
+        // Collect one interleaved group, like decode_secret_file_data_fec
+        uint len = (sink->left < FEC_GROUP_DATA) ? sink->left : FEC_GROUP_DATA;
+        uint coded_len = fec_encoded_size(len);
+        uint k = coded_len - sink->coded_have;
+        k = (k < n) ? k : n;
+        memcpy(sink->coded + sink->coded_have, p, k);
+        sink->coded_have += k;
+        p += k;
+        n -= k;
+        if (sink->coded_have == coded_len)
+        {
+            int fixed = fec_decode_group(sink->coded, len, data);
+            if (fixed < 0)
+            {
+                printf("INFO: Too many damaged bytes near offset %ld.\n", (long)decInfo->secret_size - sink->left);
+                return e_failure;
+            }
+            sink->corrected += fixed;
+            fwrite(data, 1, len, decInfo->fptr_output);
+            sink->left -= len;
+            sink->coded_have = 0;
+        }
+    }
+    return e_success;
+}
+
+// Function to consume the payload of one extracted frame
+static Status consume_frame(Y4mPipeline *pipe, Y4mSlot *slot)
+{
+    Y4mSink *sink = pipe->sink;
+    DecodeInfo *decInfo = sink->decInfo;
+    const unsigned char *p = slot->payload;
+    uint n = pipe->info.frame_payload;
+
+    // Collect bytes until the header parses
+    while (!sink->parsed && n > 0)
+    {
+        uint k = sizeof(sink->header) - sink->header_have;
+        k = (k < n) ? k : n;
+        memcpy(sink->header + sink->header_have, p, k);
+        sink->header_have += k;
+        p += k;
+        n -= k;
+        int len = parse_payload_header(sink->magic_string, sink->header, sink->header_have, decInfo);
+        if (len < 0 || (len == 0 && sink->header_have == sizeof(sink->header)))
+        {
+            return e_failure;
+        }
+        if (len == 0)
+        {
+            continue;
+        }
+        if (FLAG_CHANNELS(decInfo->flags))
+        {
+            printf("INFO: Channel masks are not used with Y4M carriers, the header is damaged.\n");
+            return e_failure;
+        }
+        printf("INFO: Magic String matched.\n");
+        size_t base = strlen(decInfo->out_fname);
+        if (snprintf(decInfo->out_fname + base, sizeof(decInfo->out_fname) - base, "%s", decInfo->secret_extn) >=
+            (int)(sizeof(decInfo->out_fname) - base))
+        {
+            printf("INFO: Output file name is too long.\n");
+            return e_failure;
+        }
+        if (open_output_file(decInfo) == e_failure)
+        {
+            printf("Error opening output file.\n");
+            return e_failure;
+        }
+        printf("INFO: Decoding %u bytes of %s File Data%s.\n", decInfo->secret_size, decInfo->out_fname,
+               (decInfo->flags & FLAG_FEC) ? " with error correction" : "");
+        sink->parsed = 1;
+        sink->left = decInfo->secret_size;
+
+        // Bytes collected after the header are already data
+        if (consume_data(sink, sink->header + len, sink->header_have - len) == e_failure)
+        {
+            return e_failure;
+        }
+    }
+    if (consume_data(sink, p, n) == e_failure)
+    {
+        return e_failure;
+    }
+    pipe->finished = sink->parsed && sink->left == 0;
+    return e_success;
+}
+
+// Function to run a file through the pipeline; the caller's thread writes frames in order
+static Status run_pipeline(Y4mPipeline *pipe, uint threads)
+{
+    pthread_t reader, workers[MAX_Y4M_THREADS];
+    Status status = e_success;
+    uint started = 0;
+
+    if (threads == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (cpus > 0) ? cpus : 1;
+    }
+    if (threads > MAX_Y4M_THREADS)
+    {
+        threads = MAX_Y4M_THREADS;
+    }
+
+    // Memory is bounded by the slots: one per worker plus the frames being read and written
+    pipe->nslots = threads + Y4M_EXTRA_SLOTS;
+    pipe->slots = calloc(pipe->nslots, sizeof(Y4mSlot));
+    if (pipe->slots == NULL)
+    {
+        return e_failure;
+    }
+    for (uint i = 0; i < pipe->nslots; i++)
+    {
+        pipe->slots[i].planes = malloc(pipe->info.frame_size);
+        pipe->slots[i].payload = malloc(pipe->info.frame_payload + 1);
+        pipe->slots[i].frame = -1;
+        if (pipe->slots[i].planes == NULL || pipe->slots[i].payload == NULL)
+        {
+            status = e_failure;
+        }
+    }
+    pthread_mutex_init(&pipe->lock, NULL);
+    pthread_cond_init(&pipe->changed, NULL);
+
+    if (status == e_success && pthread_create(&reader, NULL, y4m_reader, pipe) == 0)
+    {
+        for (; started < threads; started++)
+        {
+            if (pthread_create(&workers[started], NULL, y4m_worker, pipe))
+            {
+                break;
+            }
+        }
+        printf("INFO: Pipeline of 1 reader, %u workers and %u frame slots of %ld bytes.\n", started, pipe->nslots, pipe->info.frame_size);
+
+        for (long frame = 0; started > 0; frame++)
+        {
+            // Wait for this frame, or for the reader to run out of frames
+            Y4mSlot *slot = &pipe->slots[frame % pipe->nslots];
+            pthread_mutex_lock(&pipe->lock);
+            while (!(slot->state == slot_done && slot->frame == frame) && !(pipe->reading_done && frame >= pipe->frames_read))
+            {
+                pthread_cond_wait(&pipe->changed, &pipe->lock);
+            }
+            int more = (slot->state == slot_done && slot->frame == frame);
+            pthread_mutex_unlock(&pipe->lock);
+            if (!more)
+            {
+                break;
+            }
+
+            if ((pipe->embed ? write_frame(pipe, slot) : consume_frame(pipe, slot)) == e_failure)
+            {
+                status = e_failure;
+            }
+
+            pthread_mutex_lock(&pipe->lock);
+            slot->state = slot_free;
+            pipe->stop = (status == e_failure || pipe->finished);
+            pthread_cond_broadcast(&pipe->changed);
+            pthread_mutex_unlock(&pipe->lock);
+            if (pipe->stop)
+            {
+                break;
+            }
+        }
+
+        // Wake everyone up so they can see there is nothing left
+        pthread_mutex_lock(&pipe->lock);
+        pipe->stop = 1;
+        pthread_cond_broadcast(&pipe->changed);
+        pthread_mutex_unlock(&pipe->lock);
+        pthread_join(reader, NULL);
+        for (uint i = 0; i < started; i++)
+        {
+            pthread_join(workers[i], NULL);
+        }
+    }
+    if (started == 0 || pipe->read_failed)
+    {
+        status = e_failure;
+    }
+
+    for (uint i = 0; i < pipe->nslots; i++)
+    {
+        free(pipe->slots[i].planes);
+        free(pipe->slots[i].payload);
+    }
+    free(pipe->slots);
+    pthread_mutex_destroy(&pipe->lock);
+    pthread_cond_destroy(&pipe->changed);
+    return status;
+}
+
+// Function to open the cover and the secret of a Y4M encode
+static Status open_y4m_files(EncodeInfo *encInfo, Y4mInfo *info)
+{
+    printf("INFO: Opening required files.\n");
+    encInfo->fptr_src_image = fopen(encInfo->src_image_fname, "r");
+    if (encInfo->fptr_src_image == NULL || y4m_parse_header(encInfo->fptr_src_image, info) == e_failure)
+    {
+        fprintf(stderr, "ERROR: %s is not an 8-bit planar Y4M file\n", encInfo->src_image_fname);
+        return e_failure;
+    }
+    encInfo->fptr_secret = fopen(encInfo->secret_fname, "r");
+    if (encInfo->fptr_secret == NULL)
+    {
+        perror("fopen");
+        fprintf(stderr, "ERROR: can't open file %s\n", encInfo->secret_fname);
+        return e_failure;
+    }
+    encInfo->size_secret_file = get_file_size(encInfo->fptr_secret);
+    rewind(encInfo->fptr_secret);
+    printf("INFO: Opened %s, %ux%u %s, %ld frames of %ld payload bytes\n", encInfo->src_image_fname,
+           info->width, info->height, info->colorspace, info->frames, info->frame_payload);
+    return e_success;
+}
+
+// Function to encode a secret into a Y4M cover
+Status do_y4m_encoding(EncodeInfo *encInfo)
+{
+    Y4mPipeline pipe;
+    PayloadStream stream;
+    char buffer[64 * 1024];
+    size_t n;
+
+    memset(&pipe, 0, sizeof(pipe));
+    if (open_y4m_files(encInfo, &pipe.info) == e_failure)
+    {
+        printf("INFO: Files are not opened.\n");
+        return e_failure;
+    }
+    printf("INFO: ## Encoding Procedure Started. ##\n");
+
+    // Frames with extra parameters are only found out while streaming
+    fec_init();
+    payload_stream_init(encInfo, &stream);
+    if (stream.payload_len > pipe.info.frames * pipe.info.frame_payload)
+    {
+        printf("INFO: There is not enough space, %ld payload bytes for %ld.\n", pipe.info.frames * pipe.info.frame_payload, stream.payload_len);
+        return e_failure;
+    }
+    printf("INFO: Done. Found OK\n");
+
+    // The output is only created once the payload is known to fit
+    encInfo->fptr_stego_image = fopen(encInfo->part_fname, "w");
+    if (encInfo->fptr_stego_image == NULL)
+    {
+        perror("fopen");
+        fprintf(stderr, "ERROR: can't open file %s\n", encInfo->part_fname);
+        return e_failure;
+    }
+    fwrite(pipe.info.header, 1, pipe.info.header_len, encInfo->fptr_stego_image);
+    pipe.fptr_src = encInfo->fptr_src_image;
+    pipe.embed = 1;
+    pipe.encInfo = encInfo;
+    pipe.stream = &stream;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (run_pipeline(&pipe, encInfo->threads) == e_failure || stream.payload_done < stream.payload_len)
+    {
+        printf("INFO: Error embedding the payload, %ld of %ld bytes embedded.\n", stream.payload_done, stream.payload_len);
+        return e_failure;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("INFO: Embedded %ld frames in %.3f s (%.1f MB/s).\n", pipe.frames_read, seconds,
+           seconds > 0 ? pipe.frames_read * pipe.info.frame_size / 1e6 / seconds : 0.0);
+
+    // The frames after the payload are the cover itself
+    printf("INFO: Copying the remaining frames.\n");
+    while ((n = fread(buffer, 1, sizeof(buffer), encInfo->fptr_src_image)) > 0)
+    {
+        if (fwrite(buffer, 1, n, encInfo->fptr_stego_image) != n)
+        {
+            return e_failure;
+        }
+    }
+
+    // Make the output durable, then publish it under its real name
+    if (fflush(encInfo->fptr_stego_image) || fsync(fileno(encInfo->fptr_stego_image)))
+    {
+        perror("fsync");
+        return e_failure;
+    }
+    close_encode_files(encInfo);
+    if (rename(encInfo->part_fname, encInfo->stego_image_fname))
+    {
+        perror("rename");
+        return e_failure;
+    }
+    printf("INFO: Wrote %s\n", encInfo->stego_image_fname);
+    return e_success;
+}
+
+// Function to decode the secret of a Y4M stego file
+Status do_y4m_decoding(DecodeInfo *decInfo, const char *magic_string)
+{
+    Y4mPipeline pipe;
+    Y4mSink sink;
+
+    memset(&pipe, 0, sizeof(pipe));
+    memset(&sink, 0, sizeof(sink));
+    printf("INFO: Opening required files.\n");
+    decInfo->fptr_stego = fopen(decInfo->stego_fname, "r");
+    if (decInfo->fptr_stego == NULL || y4m_parse_header(decInfo->fptr_stego, &pipe.info) == e_failure)
+    {
+        printf("INFO: %s is not an 8-bit planar Y4M file.\n", decInfo->stego_fname);
+        return e_failure;
+    }
+    printf("INFO: Opened %s, %ux%u %s.\n", decInfo->stego_fname, pipe.info.width, pipe.info.height, pipe.info.colorspace);
+
+    fec_init();
+    sink.decInfo = decInfo;
+    sink.magic_string = magic_string;
+    pipe.fptr_src = decInfo->fptr_stego;
+    pipe.sink = &sink;
+    if (run_pipeline(&pipe, decInfo->threads) == e_failure || !pipe.finished)
+    {
+        printf("INFO: Error decoding the payload after %ld frames.\n", pipe.frames_read);
+        return e_failure;
+    }
+    if (decInfo->flags & FLAG_FEC)
+    {
+        printf("INFO: Done decoding secret data, %ld damaged bytes repaired.\n", sink.corrected);
+    }
+    if (finish_output_file(decInfo) == e_failure)
+    {
+        printf("Error writing output file.\n");
+        return e_failure;
+    }
+    close_decode_files(decInfo);
+    return e_success;
+}
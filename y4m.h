@@ -0,0 +1,80 @@
+#ifndef Y4M_H
+#define Y4M_H
+
+#include <stdio.h>
+#include "types.h" // Contains user defined types
+#include "encode.h"
+#include "decode.h"
+
+/*
+ * This header file defines the Y4M (YUV4MPEG2) video carrier. A Y4M file
+ * is one header line followed by frames, each a "FRAME" line and the raw
+ * 8-bit planes (Y, then Cb and Cr at the subsampling of the C parameter).
+ * Every plane byte is a sample, luma and chroma alike. Frame f carries
+ * payload bytes [f * frame_payload, (f + 1) * frame_payload) of the same
+ * payload an image carries (magic string, field, extension, size, data).
+ *
+ * Frames are independent, so they run through a pipeline: a reader thread
+ * fills frame slots in order, worker threads embed or extract the LSBs of
+ * whole frames with the block kernels, and the calling thread writes the
+ * frames (or consumes the payload) in order. Only threads +
+ * Y4M_EXTRA_SLOTS frames are held in memory. Frames after the payload are
+ * copied through without entering the pipeline.
+ */
+
+#define Y4M_EXTN ".y4m"             // File extension of the carrier
+#define Y4M_SIGNATURE "YUV4MPEG2 "  // Start of the header line
+#define Y4M_FRAME "FRAME"           // Start of every frame line
+#define MAX_Y4M_LINE 1024           // Longest header or frame line
+#define MAX_Y4M_THREADS 64          // Upper bound for --threads
+#define Y4M_EXTRA_SLOTS 2           // Frames being read and written besides one per worker
+
+/*
+ * Structure: Y4mInfo
+ * Purpose: Layout of the frames of one Y4M file.
+ */
+typedef struct _Y4mInfo
+{
+    char header[MAX_Y4M_LINE];  // Header line as read, with its newline
+    uint header_len;            // Bytes in header
+    uint width;                 // Frame width in pixels
+    uint height;                // Frame height in pixels
+    char colorspace[16];        // C parameter, 420jpeg when absent
+    long frame_size;            // Plane bytes per frame
+    long frame_payload;         // Payload bytes per frame
+    long frames;                // Frames in the file when every frame line is plain
+} Y4mInfo;
+
+/*
+ * Function: y4m_parse_header
+ * Purpose: Reads the header line and works out the frame layout.
+ * Inputs:
+ *  - fptr: Y4M file at its start; left at the first frame line.
+ *  - info: Receives the layout.
+ * Outputs:
+ *  - Returns e_success for 8-bit planar files, otherwise e_failure.
+ */
+Status y4m_parse_header(FILE *fptr, Y4mInfo *info);
+
+/*
+ * Function: do_y4m_encoding
+ * Purpose: Encodes the secret of encInfo into a Y4M cover.
+ * Inputs:
+ *  - encInfo: Validated encode arguments with a .y4m cover.
+ * Outputs:
+ *  - Returns e_success once the output is written, otherwise e_failure.
+ */
+Status do_y4m_encoding(EncodeInfo *encInfo);
+
+/*
+ * Function: do_y4m_decoding
+ * Purpose: Decodes the secret of a Y4M stego file.
+ * Inputs:
+ *  - decInfo: Validated decode arguments with a .y4m stego file.
+ *  - magic_string: Magic string expected at the start of the payload.
+ * Outputs:
+ *  - Returns e_success once the output is written, otherwise e_failure.
+ */
+Status do_y4m_decoding(DecodeInfo *decInfo, const char *magic_string);
+
+#endif